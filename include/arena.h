@@ -0,0 +1,45 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/* Bump allocator for short-lived scratch. Memory comes from a chain of large
+   chunks; every allocation is ARENA_ALIGN-byte aligned and is only released as
+   part of a scope (arena_restore back to a saved mark, or arena_reset). Chunks
+   are kept across scopes, so a workload sized by its first pass runs on a fixed
+   number of system allocations. */
+#define ARENA_ALIGN 64
+
+typedef struct arena_chunk {
+    struct arena_chunk *next;
+    size_t size;
+    size_t used;
+    unsigned char *data;
+} arena_chunk;
+
+typedef struct {
+    arena_chunk *first;
+    arena_chunk *current;
+    size_t chunk_size;      /* minimum size of a new chunk */
+    size_t reserved;        /* bytes obtained from the system */
+    size_t in_use;          /* bytes handed out in the live scopes */
+    size_t peak;
+} arena_struct;
+
+typedef arena_struct arena_t[1];
+
+typedef struct {
+    arena_chunk *chunk;
+    size_t used;
+    size_t in_use;
+} arena_mark;
+
+void arena_init(arena_t a, size_t chunk_size);
+void arena_clear(arena_t a);
+void *arena_alloc(arena_t a, size_t size);
+void *arena_calloc(arena_t a, size_t count, size_t size);
+arena_mark arena_save(const arena_t a);
+void arena_restore(arena_t a, arena_mark mark);
+void arena_reset(arena_t a);
+
+#endif
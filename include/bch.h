@@ -1,9 +1,16 @@
 #ifndef BCH_H
 #define BCH_H
 
+#include <stdio.h>
+#include "gf2x.h"
+#include "bch_tables.h"
+#include "gf2mat.h"
+
+const bch_table_entry *bch_table_lookup(int m, int t);
+int bch_compute_k_from_mt(int m, int t, uint32_t *k_out, uint32_t *r_out);
+int bch_print_table(FILE *out, int m);
+int bch_genpoly_gf2x(int m, int t, gf2x_t gpoly);
 int bch_genpoly(int m, int t, uint8_t **gpoly_out, uint32_t *deg_out);
-uint8_t **bch_generator_matrix_bytes(const uint8_t *gpoly, uint32_t gdeg, uint32_t n, uint32_t *k_out);
-void copy_matrix_to_nmod_mat(nmod_mat_t M, uint8_t **bytes, uint32_t k, uint32_t n);
-void free_matrix_bytes(uint8_t **M, uint32_t k);
+int bch_generator_matrix(gf2_mat_t G, const gf2x_t gpoly, uint32_t n);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,30 @@
+#ifndef BCH_TABLES_H
+#define BCH_TABLES_H
+
+#include <stdint.h>
+
+/* Precomputed narrow-sense primitive BCH codes, generated at build time by
+   tools/bch_tablegen into src/bch_tables.c.
+
+   For a given m the code only changes at the t where 2t - 1 is a new cyclotomic
+   coset leader, so each table holds one entry per such t_start; every
+   t_start <= t < next t_start gives the same code. k is tabulated for
+   m <= BCH_K_TABLE_MAX_M, g(x) for m <= BCH_G_TABLE_MAX_M. */
+#define BCH_K_TABLE_MAX_M 16
+#define BCH_G_TABLE_MAX_M 12
+
+typedef struct {
+    uint32_t t_start;
+    uint32_t k;
+    uint32_t goffset;   /* first word of g(x) in bch_gpoly_words, deg g = n - k */
+} bch_table_entry;
+
+typedef struct {
+    const bch_table_entry *entries;
+    uint32_t count;
+} bch_table;
+
+extern const bch_table bch_tables[BCH_K_TABLE_MAX_M + 1];
+extern const uint64_t bch_gpoly_words[];
+
+#endif
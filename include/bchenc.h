@@ -0,0 +1,42 @@
+#ifndef BCHENC_H
+#define BCHENC_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "gf2x.h"
+#include "gf2mat.h"
+
+/* Systematic encoder for the narrow-sense BCH code of length n = 2^m - 1 and
+   designed distance 2t + 1, using the column convention of
+   bch_generator_matrix: column j holds the coefficient of x^(n-1-j).
+
+   A codeword is [u | p]: the k message bits in columns 0..k-1 followed by the
+   r = n - k parity bits p(x) = u(x) x^r mod g(x), computed by an LFSR that
+   divides by g(x) one message byte at a time through a 256-entry table.
+   Vectors are packed like gf2_mat rows (bit j in bit j % 64 of word j / 64).
+
+   Standalone: the signer's G1 and G2 are seed-expanded, not BCH generators, so
+   only bch-table --self-test and tools/bench use this encoder. */
+typedef struct {
+    uint32_t n, k, r;
+    slong rwords;       /* words in the r-bit remainder register */
+    uint64_t *glow;     /* x^r mod g(x) = g(x) - x^r, register layout */
+    uint64_t *table;    /* 256 * rwords: (v(x) x^r) mod g(x) for each feedback byte v */
+} bch_encoder_struct;
+
+typedef bch_encoder_struct bch_encoder_t[1];
+
+int bch_encoder_init(bch_encoder_t enc, int m, int t);
+void bch_encoder_clear(bch_encoder_t enc);
+
+// codeword (GF2_WORDS(n) words) = systematic encoding of msg (k bits)
+void bch_encode(const bch_encoder_t enc, const uint64_t *msg, uint64_t *codeword);
+bool bch_is_codeword(const bch_encoder_t enc, const uint64_t *codeword);
+
+// G (k x n, initialised by the caller) = [I_k | P], row i = x^(n-1-i) + (x^(n-1-i) mod g(x))
+void bch_systematic_generator_matrix(const bch_encoder_t enc, gf2_mat_t G);
+
+int bch_encoder_self_test(int m, int t, int trials, FILE *out);
+
+#endif
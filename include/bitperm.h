@@ -0,0 +1,28 @@
+#ifndef BITPERM_H
+#define BITPERM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <flint/flint.h>
+
+/* Bit scatter/gather on packed bit arrays (bit j in bit j % 64 of word j / 64).
+   The word kernels are PDEP/PEXT when the CPU has BMI2, selected at runtime,
+   and a loop over the set mask bits otherwise. */
+
+/* dst (nbits) takes the bits of in, in order, at the positions set in mask and
+   the bits of out, in order, at the positions clear in mask */
+void bits_merge(uint64_t *dst, const uint64_t *mask, const uint64_t *in, const uint64_t *out, slong nbits);
+
+/* Inverse of bits_merge: in and out receive the bits of src (nbits) at the set
+   and clear positions of mask. Only the words they fill are written. */
+void bits_split(uint64_t *in, uint64_t *out, const uint64_t *src, const uint64_t *mask, slong nbits);
+
+// dst bit i = src bit (nbits - 1 - i); dst and src must not overlap
+void bits_reverse(uint64_t *dst, const uint64_t *src, slong nbits);
+
+// dst (GF2_WORDS(nbits) words) = bits start .. start + nbits - 1 of src
+void bits_extract(uint64_t *dst, const uint64_t *src, slong start, slong nbits);
+
+bool bitperm_has_hw(void);
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef CLMUL_H
+#define CLMUL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Carry-less (GF(2)[x]) multiplication of two 64-bit words.
+   Uses PCLMULQDQ when the CPU has it, selected at runtime, and a portable
+   windowed shift-and-xor otherwise. Returns the low 64 bits of the product and
+   stores the high 64 bits in *hi when hi is not NULL. */
+uint64_t clmul64(uint64_t a, uint64_t b, uint64_t *hi);
+bool clmul_has_hw(void);
+
+#endif
@@ -3,12 +3,19 @@
 
 #define MOD 2
 #define SALT_LEN 4
+// Default dump level: matrices when true, nothing when false (see dump.h)
+#ifndef PRINT
 #define PRINT true
+#endif
 #define SEED_SIZE 32
 #define PARAM_PATH "params.txt"
 #define OUTPUT_DIR "output"
 #define OUTPUT_PATH OUTPUT_DIR "/output.txt"
+#define SIGNATURE_PATH OUTPUT_DIR "/signature.sig"
+#define KEY_DIR OUTPUT_DIR "/pk"
+#define PKSTORE_CAPACITY (256UL << 20)
 #define CACHE_DIR "./matrix_cache/"
+#define KEYSTORE_DIR "keystore"
 #define MAX_FILENAME_LENGTH 256
 
 #endif
\ No newline at end of file
@@ -0,0 +1,36 @@
+#ifndef DUMP_H
+#define DUMP_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <flint/nmod_mat.h>
+#include "gf2mat.h"
+
+/* Diagnostic dumps to output/output.txt. Rows are formatted a byte of packed
+   bits at a time through lookup tables into a large buffer that is written out
+   in big blocks, instead of one fprintf per entry.
+
+   What gets dumped is chosen per run with SIG_DUMP=<level>[,<format>]:
+     0  nothing
+     1  seeds, the position set J, hashes and key store statistics
+     2  also H_A, G1, G2 and G*
+   The default is 2 when built with PRINT true and 0 otherwise. The format is
+   text (the original "[ 0 1 ... ]" rows, the default), hex or base64; hex and
+   base64 encode each row's packed bytes, column 0 in the low bit of byte 0. */
+
+typedef enum { DUMP_NONE, DUMP_SUMMARY, DUMP_MATRICES } dump_level;
+typedef enum { DUMP_TEXT, DUMP_HEX, DUMP_BASE64 } dump_format;
+
+extern dump_level dump_verbosity;
+
+void dump_init(void);
+
+static inline bool dump_enabled(dump_level level)
+{
+    return dump_verbosity >= level;
+}
+
+void dump_gf2_mat(FILE *fp, const gf2_mat_t M);
+void dump_nmod_mat(FILE *fp, const nmod_mat_t M, bool transpose);
+
+#endif
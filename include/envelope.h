@@ -0,0 +1,50 @@
+#ifndef ENVELOPE_H
+#define ENVELOPE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "gf2mat.h"
+#include "pubkey.h"
+
+#define ENVELOPE_MAGIC "SGE1"
+#define ENVELOPE_VERSION 1
+
+/* Single-file binary signature:
+     header | packed signature bits (GF2_WORDS(sig_bits) words) | salt
+   Header fields and signature words are written in host byte order so the
+   words can be used in place; an envelope from a host of the other byte
+   order fails the version check instead of being misread.
+   The public key F is not embedded, only its digest (see pubkey.h).
+   The header size is a multiple of 8, so the signature words are aligned
+   whenever the envelope itself is, e.g. when it is mmapped. */
+typedef struct {
+    char magic[4];
+    uint16_t version;
+    uint16_t flags;
+    uint32_t sig_bits;
+    uint32_t msg_len;
+    uint32_t salt_len;
+    uint32_t reserved;
+    unsigned char key_id[PUBKEY_DIGEST_SIZE];
+} envelope_header;
+
+// Parsed envelope; every pointer refers into the underlying buffer
+typedef struct {
+    const envelope_header *header;
+    gf2_mat_struct signature;
+    const unsigned char *salt;
+    const unsigned char *key_id;
+    void *map;
+    size_t map_len;
+} sig_envelope;
+
+size_t envelope_size(uint32_t sig_bits, uint32_t salt_len);
+bool envelope_write(const char *path, const gf2_mat_t signature, uint32_t msg_len,
+                    const unsigned char *salt, uint32_t salt_len,
+                    const unsigned char key_id[PUBKEY_DIGEST_SIZE]);
+bool envelope_parse(const void *buf, size_t len, sig_envelope *env);
+bool envelope_open(const char *path, sig_envelope *env);
+void envelope_close(sig_envelope *env);
+
+#endif
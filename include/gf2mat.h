@@ -0,0 +1,51 @@
+#ifndef GF2MAT_H
+#define GF2MAT_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <flint/flint.h>
+#include <flint/nmod_mat.h>
+
+/* Bit-packed matrix over GF(2), row-major.
+   Bit j of row i lives in bit (j % 64) of word (j / 64) of that row; bits past
+   the last column are always zero, so row operations can work on whole words. */
+typedef struct {
+    slong r, c;
+    slong words;        /* 64-bit words per row */
+    uint64_t *bits;     /* r * words words */
+} gf2_mat_struct;
+
+typedef gf2_mat_struct gf2_mat_t[1];
+
+#define GF2_WORDS(bits) (((bits) + 63) / 64)
+
+void gf2_mat_init(gf2_mat_t M, slong r, slong c);
+void gf2_mat_clear(gf2_mat_t M);
+void gf2_mat_zero(gf2_mat_t M);
+void gf2_mat_set_nmod(gf2_mat_t M, const nmod_mat_t A);
+void gf2_mat_get_nmod(nmod_mat_t A, const gf2_mat_t M);
+int gf2_mat_equal(const gf2_mat_t A, const gf2_mat_t B);
+void gf2_mat_print(FILE *fp, const gf2_mat_t M);
+
+static inline uint64_t *gf2_mat_row(const gf2_mat_t M, slong i) {
+    return M->bits + i * M->words;
+}
+
+static inline int gf2_mat_get(const gf2_mat_t M, slong i, slong j) {
+    return (gf2_mat_row(M, i)[j / 64] >> (j % 64)) & 1;
+}
+
+static inline void gf2_mat_set(gf2_mat_t M, slong i, slong j, int v) {
+    uint64_t *w = &gf2_mat_row(M, i)[j / 64];
+    uint64_t bit = UINT64_C(1) << (j % 64);
+    *w = v ? (*w | bit) : (*w & ~bit);
+}
+
+// Inner product <a, b> over GF(2) of two packed vectors
+static inline int gf2_dot(const uint64_t *a, const uint64_t *b, slong words) {
+    uint64_t acc = 0;
+    for (slong w = 0; w < words; ++w) acc ^= a[w] & b[w];
+    return __builtin_parityll(acc);
+}
+
+#endif
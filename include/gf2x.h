@@ -0,0 +1,50 @@
+#ifndef GF2X_H
+#define GF2X_H
+
+#include <stdint.h>
+#include <flint/flint.h>
+
+/* Polynomials over GF(2), packed 64 coefficients per word:
+   bit (i % 64) of coeffs[i / 64] is the coefficient of x^i.
+   length is the number of words in use and is kept normalised
+   (the top word is nonzero; the zero polynomial has length 0). */
+typedef struct {
+    uint64_t *coeffs;
+    slong alloc;
+    slong length;
+} gf2x_struct;
+
+typedef gf2x_struct gf2x_t[1];
+
+/* Operand size in words from which multiplication switches from schoolbook
+   (PCLMULQDQ word products) to Karatsuba */
+#define GF2X_KARATSUBA_THRESHOLD 24
+
+void gf2x_init(gf2x_t f);
+void gf2x_clear(gf2x_t f);
+void gf2x_fit_length(gf2x_t f, slong words);
+void gf2x_normalise(gf2x_t f);
+void gf2x_zero(gf2x_t f);
+void gf2x_one(gf2x_t f);
+void gf2x_set(gf2x_t f, const gf2x_t g);
+void gf2x_swap(gf2x_t f, gf2x_t g);
+int gf2x_equal(const gf2x_t f, const gf2x_t g);
+slong gf2x_degree(const gf2x_t f);
+int gf2x_get_coeff(const gf2x_t f, slong i);
+void gf2x_set_coeff(gf2x_t f, slong i, int c);
+void gf2x_set_bytes(gf2x_t f, const uint8_t *coeffs, slong len);
+void gf2x_get_bytes(uint8_t *coeffs, const gf2x_t f, slong len);
+
+void gf2x_add(gf2x_t r, const gf2x_t a, const gf2x_t b);
+void gf2x_mul(gf2x_t r, const gf2x_t a, const gf2x_t b);
+void gf2x_divrem(gf2x_t q, gf2x_t r, const gf2x_t a, const gf2x_t b);
+void gf2x_rem(gf2x_t r, const gf2x_t a, const gf2x_t b);
+void gf2x_gcd(gf2x_t g, const gf2x_t a, const gf2x_t b);
+
+/* Word-level product: r (an + bn words, not overlapping a or b) = a * b */
+void gf2x_mul_words(uint64_t *r, const uint64_t *a, slong an, const uint64_t *b, slong bn);
+slong gf2x_mul_scratch_words(slong an, slong bn);
+void gf2x_mul_words_tmp(uint64_t *r, const uint64_t *a, slong an, const uint64_t *b, slong bn,
+                        uint64_t *tmp);
+
+#endif
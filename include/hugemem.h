@@ -0,0 +1,49 @@
+#ifndef HUGEMEM_H
+#define HUGEMEM_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/* Allocator for large packed matrices. Every block is 64-byte aligned; blocks
+   of HUGEMEM_THRESHOLD bytes or more are mapped on their own, 2 MiB aligned,
+   and backed by huge pages where the system allows, so a multiply streaming
+   through H_A, G* or F takes a TLB miss per 2 MiB instead of per 4 KiB:
+
+     auto     MAP_HUGETLB from the reserved pool, else transparent huge pages
+              through madvise(MADV_HUGEPAGE)
+     thp      transparent huge pages only
+     off      4 KiB pages, with MADV_NOHUGEPAGE so THP=always cannot interfere
+
+   The mode comes from SIG_HUGEPAGES (default auto) unless set explicitly.
+   Smaller blocks come from aligned_alloc. Bytes by backing are accounted. */
+
+#define HUGEMEM_ALIGN 64
+#define HUGEMEM_PAGE (2UL << 20)
+#define HUGEMEM_THRESHOLD HUGEMEM_PAGE
+
+typedef enum { HUGEMEM_AUTO, HUGEMEM_THP, HUGEMEM_OFF } hugemem_mode;
+
+typedef enum { HUGEMEM_HEAP, HUGEMEM_SMALL_PAGES, HUGEMEM_THP_PAGES, HUGEMEM_HUGETLB_PAGES,
+               HUGEMEM_BACKINGS } hugemem_backing;
+
+typedef struct {
+    size_t bytes[HUGEMEM_BACKINGS];         /* live, as requested */
+    size_t mapped[HUGEMEM_BACKINGS];        /* live, after rounding to pages */
+    size_t peak;                            /* highest total of bytes */
+    unsigned long allocs[HUGEMEM_BACKINGS]; /* since start */
+} hugemem_stats;
+
+void hugemem_set_mode(hugemem_mode mode);
+
+/* Zeroed, 64-byte aligned; NULL on failure. Free with hugemem_free. */
+void *hugemem_alloc(size_t size);
+void hugemem_free(void *p);
+
+// Asks for huge pages on an existing mapping (the shared H_A cache); best effort
+void hugemem_advise(void *p, size_t len);
+
+void hugemem_get_stats(hugemem_stats *stats);
+void hugemem_print_stats(FILE *fp);
+
+#endif
@@ -4,15 +4,33 @@
 #include <flint/nmod_mat.h>
 #include <stdbool.h>
 #include "matrix.h"
+#include "gf2mat.h"
+#include "shmcache.h"
+#include "qcmat.h"
 
+void create_generator_matrix(slong n, slong k, slong d, nmod_mat_t gen_matrix, FILE *output_file);
 void create_generator_matrix_from_seed(slong n, slong k, slong d,
                                        nmod_mat_t gen_matrix,
                                        const unsigned char *seed,
                                        FILE *output_file);
 
+void create_generator_matrix_packed_from_seed(slong n, slong k, gf2_mat_t G,
+                                              const unsigned char *seed);
+
 void generate_parity_check_matrix_from_seed(slong n, slong k, slong d, nmod_mat_t H, 
                                            const unsigned char *seed, FILE *output_file);
 
+void generate_parity_check_matrix_packed_from_seed(slong n, slong k, gf2_mat_t H,
+                                                   const unsigned char *seed);
+
+void generate_parity_check_qc_from_seed(slong n, slong k, qc_mat_t H, const unsigned char *seed);
+
+bool load_parity_check_qc(const struct code *C_A, bool create, qc_mat_t H, unsigned char *seed);
+
+bool get_or_generate_seed(const char* prefix, int n, int k, int d, bool regenerate, unsigned char *seed);
+
+void acquire_parity_check_matrix(const struct code *C_A, const unsigned char *seed, shmcache_handle *handle);
+
 void get_or_generate_matrix_with_seed(const char* prefix, int n, int k, int d, nmod_mat_t matrix,
                                      void (*generate_func)(slong, slong, slong, nmod_mat_t, FILE*),
                                      void (*generate_from_seed_func)(slong, slong, slong, nmod_mat_t, const unsigned char*, FILE*),
@@ -0,0 +1,65 @@
+#ifndef KEYSTORE_H
+#define KEYSTORE_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <flint/nmod_mat.h>
+#include "matrix.h"
+#include "constants.h"
+
+#define KEYSTORE_ID_SIZE 32
+#define KEYSTORE_NAME_SIZE 64
+
+/* Key sets for many tenants in one directory, addressed by key id (the SHA-256
+   of the tenant's name). A key set is only its parameters and seeds; H_A, G1
+   and G2 are expanded from the seeds when a key is first used, so opening the
+   store costs nothing per key.
+
+     index   header, then an open-addressing table of (id, record) slots,
+             mapped shared and probed linearly from the id's first 8 bytes
+     keys    fixed-size records, appended and never rewritten
+     lock    flock'd by writers
+
+   Writers append the record, then fill a slot's id and publish its record
+   number with a release store, so readers never take a lock and never see a
+   half-written key. An index that gets 3/4 full is rebuilt at twice the size
+   and renamed over the old one; readers keep the old mapping until a lookup
+   misses and then remap. All functions are thread-safe. */
+
+typedef struct {
+    struct code C_A, C1, C2;
+    unsigned char h_a_seed[SEED_SIZE], g1_seed[SEED_SIZE], g2_seed[SEED_SIZE];
+    char name[KEYSTORE_NAME_SIZE];
+} keystore_keyset;
+
+typedef struct keystore keystore;
+
+typedef struct {
+    size_t count;
+    size_t capacity;
+    size_t index_bytes, keys_bytes;
+    unsigned long remaps;       /* index or record file mapped again after growing */
+} keystore_stats;
+
+/* A writable store creates the directory and files if missing */
+keystore *keystore_open(const char *dir, bool writable);
+void keystore_close(keystore *ks);
+
+void keystore_key_id(const char *name, unsigned char id[KEYSTORE_ID_SIZE]);
+
+/* Fresh random seeds for the given parameters; false if the name does not fit */
+bool keystore_keyset_init(keystore_keyset *keys, const char *name, const struct code *C_A,
+                          const struct code *C1, const struct code *C2);
+
+/* False if the name is taken or the store cannot be written */
+bool keystore_add(keystore *ks, const keystore_keyset *keys);
+
+bool keystore_lookup(keystore *ks, const unsigned char id[KEYSTORE_ID_SIZE], keystore_keyset *keys);
+bool keystore_find(keystore *ks, const char *name, keystore_keyset *keys);
+
+void keystore_get_stats(keystore *ks, keystore_stats *stats);
+void keystore_print_stats(FILE *fp, keystore *ks);
+
+#endif
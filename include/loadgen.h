@@ -0,0 +1,58 @@
+#ifndef LOADGEN_H
+#define LOADGEN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* In-process load generator for the keys in params.txt and matrix_cache/.
+   Worker threads, each with its own sign or verify workspace, drive one
+   operation for a fixed time at every thread count in [threads_min,
+   threads_max]:
+
+   - closed loop (rate == 0): each worker issues its next request as soon as
+     the previous one completes
+   - open loop (rate > 0): requests are scheduled at rate per second across
+     the workers, whether or not earlier ones have finished
+
+   Verify requests fetch their public key through the process-wide key store
+   (pkstore_shared), as sig verify does, so its LRU hit rate is reported too.
+
+   With tenants set, keys come from the tenant key store (keystore.h) instead:
+   the store is opened once, and every request looks up its tenant's key set
+   by id, attaches that tenant's H_A segment and expands its generators, as
+   sign --key and verify --key do. grow keys are added through a second,
+   writable handle during each run, so the workers' lookups also take the
+   store's remap-on-miss path when the index is rebuilt under them.
+
+   Latencies go into log-linear (HDR-style) histograms. The corrected
+   percentiles account for coordinated omission: in open loop a request's
+   latency runs from its scheduled start, so time spent queued behind a slow
+   request counts; in closed loop every sample longer than the expected
+   interval (the run's median service time) is back-filled with the requests
+   that would have been issued meanwhile, as HdrHistogram's
+   recordValueWithExpectedInterval does. Each run's throughput and percentiles are appended to loadgen.csv in
+   out_dir, and its full distributions written as .hgrm files. */
+
+#define LOADGEN_MAX_SIZES 8
+
+typedef enum { LOADGEN_SIGN, LOADGEN_VERIFY, LOADGEN_BOTH } loadgen_op;
+
+typedef struct {
+    loadgen_op op;
+    int threads_min, threads_max, threads_step;
+    double rate;                    /* requests per second in total, 0 for closed loop */
+    double duration;                /* seconds measured per run */
+    double warmup;                  /* seconds discarded before each run */
+    size_t sizes[LOADGEN_MAX_SIZES];/* raw message sizes in bytes, cycled through */
+    int num_sizes;
+    int pool;                       /* pre-signed messages the verify runs draw from */
+    const char *tenant_prefix;      /* tenants are <prefix>-0 .. <prefix>-<tenants - 1> */
+    int tenants;                    /* 0 for the keys in params.txt */
+    int grow;                       /* keys added to the store during each run */
+    const char *out_dir;
+} loadgen_options;
+
+void loadgen_default_options(loadgen_options *opts);
+int loadgen_run(const loadgen_options *opts);
+
+#endif
@@ -1,8 +1,11 @@
 #ifndef MATRIX_H
 #define MATRIX_H
 
+#include <stdbool.h>
+
 struct code {
     unsigned long n, k, d;
+    bool quasi_cyclic;  /* H_A of this code is built from circulant blocks */
 };
 
 void print_matrix(FILE *fp, nmod_mat_t matrix);
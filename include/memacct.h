@@ -0,0 +1,50 @@
+#ifndef MEMACCT_H
+#define MEMACCT_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/* Live and peak bytes by subsystem, with an optional budget on the live total.
+   The large allocations (packed and nmod matrices, arena chunks, seed stream
+   buffers, BCH encoder tables, message buffers) are charged before they are
+   made, so a run that would exceed the budget stops with a message naming
+   what it was allocating instead of being killed by the kernel. The budget
+   comes from SIG_MEM_BUDGET or --mem-budget; 0 means no limit. */
+
+typedef enum {
+    MEM_MATRICES,
+    MEM_SEEDS,
+    MEM_BCH,
+    MEM_MESSAGES,
+    MEM_SCRATCH,
+    MEM_SUBSYSTEMS
+} mem_subsystem;
+
+typedef struct {
+    size_t live[MEM_SUBSYSTEMS];
+    size_t peak[MEM_SUBSYSTEMS];
+    size_t total, total_peak;
+    size_t budget;
+    size_t peak_rss;                /* from getrusage, 0 if unknown */
+} memacct_stats;
+
+void memacct_init(void);
+
+/* Bytes with an optional K, M or G suffix (powers of 1024) */
+bool memacct_parse_size(const char *arg, size_t *bytes);
+void memacct_set_budget(size_t bytes);
+size_t memacct_budget(void);
+
+/* True if bytes more would stay within the budget */
+bool memacct_fits(size_t bytes);
+
+/* Records bytes against s, or prints why not and returns false if they would
+   exceed the budget; what names the allocation in that message */
+bool memacct_charge(mem_subsystem s, size_t bytes, const char *what);
+void memacct_release(mem_subsystem s, size_t bytes);
+
+void memacct_get_stats(memacct_stats *stats);
+void memacct_print_stats(FILE *fp);
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <stddef.h>
+
+/* Body of a parallel loop, called with a half-open range [begin, end) */
+typedef void (*parallel_body)(void *ctx, size_t begin, size_t end);
+
+int parallel_num_threads(void);
+
+/* Chunks, and so threads including the caller's, that parallel_for splits
+   [0, count) into; callers size per-chunk buffers by it */
+size_t parallel_num_chunks(size_t count, size_t min_chunk);
+void parallel_for(size_t count, size_t min_chunk, parallel_body body, void *ctx);
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef PERFCTR_H
+#define PERFCTR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Per-thread hardware counters through perf_event_open, user space only.
+   Each thread opens its own event group the first time it reads, and the
+   group is closed when the thread exits. The one exception to per-thread
+   counts is parallel_for: after joining its workers it credits what they
+   counted to the calling thread, so a span around a parallel loop covers
+   the whole loop. Counts are scaled by time enabled / time running when
+   the kernel multiplexes the PMU. Where perf events are unavailable
+   (containers, seccomp, perf_event_paranoid, no PMU in the VM) perf_open
+   fails once with a note on stderr and everything reads as unavailable. */
+
+enum {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_L1D_MISSES,
+    PERF_LLC_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_DTLB_MISSES,
+    PERF_NUM_COUNTERS
+};
+
+#define PERF_UNAVAILABLE UINT64_MAX
+
+extern const char *const perf_counter_names[PERF_NUM_COUNTERS];
+
+/* Probes the counters on the calling thread; false if none can be opened */
+bool perf_open(void);
+bool perf_available(void);
+
+/* Running totals for the calling thread, PERF_UNAVAILABLE for counters the
+   PMU does not provide. False if the thread has no counters. */
+bool perf_read(uint64_t counts[PERF_NUM_COUNTERS]);
+
+/* Counts on the calling thread since start (a perf_read result), for a worker
+   to hand to perf_credit; all PERF_UNAVAILABLE if counters are off */
+void perf_since(const uint64_t start[PERF_NUM_COUNTERS], uint64_t counts[PERF_NUM_COUNTERS]);
+
+/* Adds a worker's counts (end minus start of its perf_read totals) to the
+   calling thread's, for every later perf_read on this thread */
+void perf_credit(const uint64_t counts[PERF_NUM_COUNTERS]);
+
+#endif
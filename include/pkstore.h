@@ -0,0 +1,40 @@
+#ifndef PKSTORE_H
+#define PKSTORE_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "gf2mat.h"
+#include "pubkey.h"
+
+/* Content-addressed store of public keys F, keyed by their digest.
+   The on-disk tier is the set of key files in KEY_DIR; the in-memory tier is a
+   size-bounded LRU of mapped, digest-checked matrices, so a key seen again is
+   served without touching the file system or rehashing it.
+   All functions are thread-safe. */
+typedef struct pkstore pkstore;
+
+typedef struct {
+    unsigned long hits;        /* served from the in-memory tier */
+    unsigned long disk_hits;   /* mapped from the on-disk tier */
+    unsigned long misses;      /* not found or failed the digest check */
+    unsigned long evictions;
+    size_t entries;
+    size_t bytes;
+    size_t capacity;
+} pkstore_stats;
+
+pkstore *pkstore_create(size_t capacity_bytes);
+void pkstore_destroy(pkstore *store);
+
+/* The process-wide store of PKSTORE_CAPACITY bytes, created on first use and
+   kept until exit, so every verification in a long-running process shares it */
+pkstore *pkstore_shared(void);
+
+const gf2_mat_struct *pkstore_acquire(pkstore *store, const unsigned char digest[PUBKEY_DIGEST_SIZE]);
+void pkstore_release(pkstore *store, const gf2_mat_struct *F);
+bool pkstore_publish(const gf2_mat_t F, unsigned char digest_out[PUBKEY_DIGEST_SIZE]);
+void pkstore_get_stats(pkstore *store, pkstore_stats *stats);
+void pkstore_print_stats(FILE *fp, pkstore *store);
+
+#endif
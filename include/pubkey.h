@@ -0,0 +1,31 @@
+#ifndef PUBKEY_H
+#define PUBKEY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "gf2mat.h"
+
+#define PUBKEY_DIGEST_SIZE 32
+#define PUBKEY_MAGIC "SGK1"
+
+/* Public key file: header followed by the packed rows of F, in host byte order.
+   Files are named after the SHA-256 digest of (rows, cols, packed rows), which is
+   also the key identifier signatures carry. */
+typedef struct {
+    char magic[4];
+    uint32_t rows;
+    uint32_t cols;
+    uint32_t reserved;
+} pubkey_header;
+
+void pubkey_digest(const gf2_mat_t F, unsigned char digest[PUBKEY_DIGEST_SIZE]);
+char *pubkey_filename(const unsigned char digest[PUBKEY_DIGEST_SIZE]);
+/* Writes F as a key file at filename; pubkey_save writes it under its digest in KEY_DIR */
+bool pubkey_write(const char *filename, const gf2_mat_t F);
+bool pubkey_save(const gf2_mat_t F, const unsigned char digest[PUBKEY_DIGEST_SIZE]);
+bool pubkey_map(const unsigned char digest[PUBKEY_DIGEST_SIZE], gf2_mat_struct *F,
+                void **map_out, size_t *map_len_out);
+void pubkey_unmap(void *map, size_t map_len);
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef QCMAT_H
+#define QCMAT_H
+
+#include <stdint.h>
+#include "gf2mat.h"
+#include "arena.h"
+
+/* Quasi-cyclic r x c matrix over GF(2): a row of ceil(c / r) circulant r x r
+   blocks, the last one cut off after c columns. Block j is stored as its first
+   column h_j(x) (row j of h, bit i = coefficient of x^i), and column t of the
+   block is x^t h_j(x) mod x^r - 1, so entry (i, j r + t) = h_j[(i - t) mod r].
+   Storage is O(c) bits instead of O(r c). */
+typedef struct {
+    slong r, c;
+    slong blocks;
+    gf2_mat_struct h;
+} qc_mat_struct;
+
+typedef qc_mat_struct qc_mat_t[1];
+
+void qc_mat_init(qc_mat_t H, slong r, slong c);
+void qc_mat_clear(qc_mat_t H);
+
+/* out (GF2_WORDS(r) words) = H v^T for a packed length-c vector v, computed as
+   sum_j h_j(x) v_j(x) mod x^r - 1 with carry-less polynomial products */
+void qc_mat_syndrome(uint64_t *out, const qc_mat_t H, const uint64_t *v);
+
+// F (r x G->r, initialised by the caller) = H G^T, one syndrome per row of G
+void qc_mat_mul_transpose(gf2_mat_t F, const qc_mat_t H, const gf2_mat_t G);
+
+// Same, with scratch taken from (and returned to) a caller-owned arena
+void qc_mat_syndrome_arena(uint64_t *out, const qc_mat_t H, const uint64_t *v, arena_t arena);
+void qc_mat_mul_transpose_arena(gf2_mat_t F, const qc_mat_t H, const gf2_mat_t G, arena_t arena);
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef REGISTRY_H
+#define REGISTRY_H
+
+#include <stdbool.h>
+#include <flint/nmod_mat.h>
+#include "constants.h"
+
+/* In-process registry of cached matrices, keyed by (prefix, n, k, d) and, in seed
+   mode, the seed itself. Identical matrices are loaded or expanded once and shared
+   read-only between all holders, and freed when the last holder releases them.
+   Holders only read; there is no writable copy. */
+
+typedef void (*registry_seed_func)(slong, slong, slong, nmod_mat_t, const unsigned char*, FILE*);
+
+const nmod_mat_struct *registry_acquire(const char *prefix, int n, int k, int d,
+                                        bool use_seed_mode, registry_seed_func generate_from_seed_func);
+void registry_release(const nmod_mat_struct *M);
+
+#endif
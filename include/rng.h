@@ -0,0 +1,27 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Per-thread buffered CSPRNG.
+   Each thread keeps a pool of ChaCha20 keystream that is refilled in large blocks,
+   so small draws (a bounded integer, a salt byte, a few bits) cost a memcpy
+   instead of a libsodium call. The ChaCha20 key is seeded from randombytes_buf
+   and rekeyed from its own output on every refill. */
+
+#define RNG_POOL_SIZE 4096
+#define RNG_SEED_SIZE 32
+
+/* Reseeds the calling thread's generator from a fixed key, making its output
+   reproducible (benchmarks); normal use seeds itself from randombytes_buf */
+void rng_set_seed(const unsigned char seed[RNG_SEED_SIZE]);
+
+void rng_bytes(void *buf, size_t len);
+uint32_t rng_u32(void);
+uint64_t rng_u64(void);
+uint32_t rng_uniform(uint32_t upper_bound);
+uint64_t rng_uniform64(uint64_t upper_bound);
+void rng_bits(uint64_t *words, size_t nbits);
+
+#endif
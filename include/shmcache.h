@@ -0,0 +1,40 @@
+#ifndef SHMCACHE_H
+#define SHMCACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "gf2mat.h"
+#include "constants.h"
+
+/* Cross-process cache of seed-expanded matrices in POSIX shared memory.
+   Segments are named after (prefix, n, k, d, seed digest). The first process to
+   need a matrix expands and publishes it; later processes map the packed rows
+   read-only instead of expanding the seed again, waiting while a publisher is
+   still filling it. Regenerating a seed marks the old segment invalid and unlinks
+   it, so no process attaches to it afterwards; unlinking never disturbs processes
+   that already mapped it, which keep a consistent copy until they detach. A
+   publisher holds an flock on the segment until it is ready, so one abandoned by
+   a crashed publisher is detected and published again, while a slow one is
+   waited for. Without usable shared memory the matrix is expanded privately.
+   A mapping is charged to MEM_MATRICES while it is attached, as the private
+   copy would be. Each segment records when it was last published or attached,
+   and publishing a new one unlinks the least recently used ready segments
+   beyond SIG_SHM_SEGMENTS (default 64), so per-tenant segments stay bounded. */
+
+typedef void (*shmcache_expand_fn)(void *ctx, gf2_mat_t M);
+
+typedef struct {
+    gf2_mat_struct M;      /* packed matrix, read-only when shared */
+    void *header_map;
+    void *data_map;
+    size_t data_len;
+    bool shared;
+} shmcache_handle;
+
+bool shmcache_acquire(const char *prefix, int n, int k, int d, const unsigned char seed[SEED_SIZE],
+                      slong rows, slong cols, shmcache_expand_fn expand, void *ctx,
+                      shmcache_handle *handle);
+void shmcache_release(shmcache_handle *handle);
+void shmcache_invalidate(const char *prefix, int n, int k, int d, const unsigned char seed[SEED_SIZE]);
+
+#endif
@@ -3,12 +3,66 @@
 
 #include <flint/nmod_mat.h>
 #include <stdio.h>
+#include <stdbool.h>
 #include "matrix.h"
+#include "gf2mat.h"
+#include "qcmat.h"
+#include "arena.h"
 
-void generate_signature(nmod_mat_t bin_hash, const unsigned char* message, size_t message_len,
-                  struct code C_A, struct code C1, struct code C2,
-                  nmod_mat_t H_A, nmod_mat_t G1, nmod_mat_t G2,
-                  nmod_mat_t F, nmod_mat_t signature, const unsigned int salt_len,
-                  unsigned char* salt, FILE* output_file);
+/* Everything generate_signature needs, sized once from the code parameters, so
+   that signing in steady state does no heap allocation and reuses warm buffers.
+   The generator matrices are packed into the workspace once, by
+   sign_workspace_set_generators or sign_workspace_expand_generators, and used
+   by every signature until they are set again. Results are left in F and
+   signature.
+
+   G* is never formed on the dense path: its columns are G1's at J and G2's
+   elsewhere, so hash G* is hash G1 and hash G2 scattered under the J mask, and
+   F = H_A[:,J] G1^T + H_A[:,~J] G2^T. */
+typedef struct {
+    struct code C_A, C1, C2;
+    size_t message_len;             /* C1.k */
+    unsigned long *perm;            /* permutation of 0..n_A-1; J is drawn from its prefix */
+    unsigned long *J;               /* sorted positions of G1's columns in G* */
+    gf2_mat_t J_mask;               /* 1 x n_A, bit j set iff j is in J */
+    gf2_mat_t gen[2];               /* packed G1 (k1 x n1) and G2 (k2 x n2) */
+    slong span[2];                  /* bits each code fills in G*: n1 and n_A - n1 */
+    slong rows[2];                  /* hash bits each code encodes: min(k1, k) */
+    uint64_t *codeword[2];          /* hash G1, hash G2 */
+    uint64_t *hpart[2];             /* a row of H_A split by J */
+    gf2_mat_t G_star;               /* k x n_A, only allocated for a quasi-cyclic H_A or a matrix dump */
+    gf2_mat_t hash;                 /* 1 x k */
+    gf2_mat_t F;                    /* (n_A - k_A) x k, the public key */
+    gf2_mat_t signature;            /* 1 x n_A */
+    unsigned char *salted_message;  /* message_len + SALT_LEN bytes */
+    unsigned long attempts;         /* salts drawn by the last signature */
+    unsigned long max_attempts;     /* give up after this many salts, 0 for no limit */
+    arena_t scratch;                /* the buffers above and quasi-cyclic product scratch */
+} sign_workspace;
+
+void sign_workspace_init(sign_workspace *ws, const struct code *C_A,
+                         const struct code *C1, const struct code *C2);
+void sign_workspace_clear(sign_workspace *ws);
+
+/* Packs G1 and G2 into the workspace. The nmod matrices are not referenced
+   afterwards, so they may be released as soon as this returns. */
+void sign_workspace_set_generators(sign_workspace *ws, const nmod_mat_t G1, const nmod_mat_t G2);
+
+/* Expands G1 and G2 from their seeds straight into the packed generators. This
+   skips the nmod_mat copies, a limb per bit, that the registry would otherwise hold. */
+void sign_workspace_expand_generators(sign_workspace *ws, const unsigned char *g1_seed,
+                                      const unsigned char *g2_seed);
+
+/* Approximate peak bytes signing allocates: the workspace, plus H_A or, unless
+   the generators are expanded packed, the nmod G1 and G2 if they are larger.
+   sign releases the nmod copies before it attaches H_A. */
+size_t sign_memory_estimate(const struct code *C_A, const struct code *C1, const struct code *C2,
+                            bool packed_generators);
+
+/* Signs with the generators set on ws. H_A_qc, when not NULL, replaces the
+   dense H_A (which may then be NULL). */
+bool generate_signature(sign_workspace *ws, const unsigned char *message, size_t message_len,
+                        const gf2_mat_struct *H_A, const qc_mat_struct *H_A_qc,
+                        unsigned char *salt, FILE *output_file);
 
 #endif
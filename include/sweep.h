@@ -0,0 +1,28 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Non-interactive scan over a grid of BCH (m, t). Each grid point runs in its
+   own child process, so peak RSS is per point and a point that runs past the
+   timeout or crashes only loses its own row. Per point it measures keygen, sign
+   and verify wall time, salts drawn by the signer's rejection loop, peak RSS
+   after each phase and the size of every artefact on disk. A power law
+   T = a n_A^b is then fitted to each phase, and the fastest point (median sign
+   plus verify time) meeting the n_A / d_A floors is recommended. */
+typedef struct {
+    int m_min, m_max;
+    int t_min, t_max, t_step;
+    int reps;                   /* sign/verify repetitions per point */
+    unsigned timeout;           /* seconds per point, 0 for none */
+    unsigned long max_attempts; /* per signature */
+    uint32_t min_n, min_d;      /* floors on n_A and d_A for the recommendation */
+    bool quasi_cyclic;
+    const char *out_dir;
+} sweep_options;
+
+void sweep_default_options(sweep_options *opts);
+int sweep_run(const sweep_options *opts);
+
+#endif
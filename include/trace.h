@@ -0,0 +1,67 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "perfctr.h"
+
+/* Phase tracing on the monotonic clock. Setting SIG_TRACE=<file> records every
+   span and counter of the run: a file ending in .csv gets one line per name
+   (count, total, min and max, aggregated as spans close), anything else Chrome
+   trace-event JSON for chrome://tracing or Perfetto, holding the last 2^18
+   events. Unset, a span costs one predictable branch;
+   building with -DSIG_NO_TRACE removes them altogether.
+   Span and counter names are stored by pointer, so they must be literals.
+   SIG_PERF=1 adds the calling thread's hardware counters (perfctr.h), plus
+   those of the parallel_for workers it joined, to every span, and spans
+   closed with trace_end_bits report misses per bit processed.
+
+       trace_mark t = trace_begin();
+       ...
+       trace_end("sign.F", t);
+*/
+
+#ifdef SIG_NO_TRACE
+#define trace_enabled false
+#define trace_on() false
+#else
+extern _Atomic bool trace_enabled;
+#define trace_on() atomic_load_explicit(&trace_enabled, memory_order_relaxed)
+#endif
+
+typedef struct {
+    uint64_t ns;
+    uint64_t perf[PERF_NUM_COUNTERS];
+} trace_mark;
+
+void trace_init(void);
+uint64_t trace_now(void);
+trace_mark trace_start(void);
+void trace_stop(const char *name, const trace_mark *start, uint64_t bits);
+void trace_count(const char *name, int64_t delta);
+
+static inline trace_mark trace_begin(void)
+{
+    if (!trace_on()) return (trace_mark) {0};
+    return trace_start();
+}
+
+static inline void trace_end(const char *name, trace_mark start)
+{
+    if (trace_on()) trace_stop(name, &start, 0);
+}
+
+// As trace_end, crediting the span with the bits of operand it streamed through
+static inline void trace_end_bits(const char *name, trace_mark start, uint64_t bits)
+{
+    if (trace_on()) trace_stop(name, &start, bits);
+}
+
+// Adds delta to a running counter (salts drawn, bytes read, ...)
+static inline void trace_add(const char *name, int64_t delta)
+{
+    if (trace_on()) trace_count(name, delta);
+}
+
+#endif
@@ -8,11 +8,17 @@
 #include <flint/flint.h>
 #include <flint/nmod_mat.h>
 #include "matrix.h"
+#include "constants.h"
 
 long weight(nmod_mat_t array);
 double binary_entropy(double p);
 void generate_random_set(unsigned long upper_bound, unsigned long size, unsigned long set[size]);
 char* generate_matrix_filename(const char* prefix, int n, int k, int d);
+FILE *open_atomic_file(const char *filename, const char *mode, char tmp_path[MAX_FILENAME_LENGTH]);
+bool commit_atomic_file(FILE *file, const char *tmp_path, const char *filename);
+void discard_atomic_file(FILE *file, const char *tmp_path);
+int lock_cache_entry(const char *filename);
+void unlock_cache_entry(int fd);
 void save_matrix(const char* filename, const nmod_mat_t matrix);
 int load_matrix(const char* filename, nmod_mat_t matrix);
 int file_exists(const char* filename);
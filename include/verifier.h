@@ -2,14 +2,35 @@
 #ifndef VERIFIER_H
 #define VERIFIER_H
 
-#include <flint/nmod_mat.h>
 #include <stdio.h>
+#include <stdbool.h>
+#include "gf2mat.h"
 #include "matrix.h"
+#include "qcmat.h"
+#include "arena.h"
 
-void verify_signature(const unsigned char *message, size_t message_len,
+/* Buffers reused across verifications with the same parameters, so checking a
+   signature does no heap allocation */
+typedef struct {
+    size_t message_len;             /* C1.k */
+    unsigned char *salted_message;  /* message_len + SALT_LEN bytes */
+    gf2_mat_t hash;                 /* 1 x message_len */
+    gf2_mat_t left, right;          /* both sides of F hash^T = H_A sig^T, for --full-check */
+    uint64_t *syndrome;             /* H_A sig^T for a quasi-cyclic H_A */
+    arena_t scratch;                /* quasi-cyclic product scratch */
+} verify_workspace;
+
+void verify_workspace_init(verify_workspace *ws, const struct code *C_A, const struct code *C1);
+void verify_workspace_clear(verify_workspace *ws);
+
+bool verify_signature(verify_workspace *ws, const unsigned char *message, size_t message_len,
                       const unsigned char *salt, size_t salt_len,
-                      unsigned long sig_len, nmod_mat_t signature,
-                      nmod_mat_t F, struct code C_A,
-                      nmod_mat_t H_A, FILE *output_file);
+                      const gf2_mat_t signature, const gf2_mat_t F,
+                      const gf2_mat_t H_A, bool full_check, FILE *output_file);
+
+bool verify_signature_qc(verify_workspace *ws, const unsigned char *message, size_t message_len,
+                         const unsigned char *salt, size_t salt_len,
+                         const gf2_mat_t signature, const gf2_mat_t F,
+                         const qc_mat_t H_A, bool full_check, FILE *output_file);
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,99 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+#include "hugemem.h"
+#include "memacct.h"
+
+static size_t round_up(size_t size) {
+    return (size + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1);
+}
+
+void arena_init(arena_t a, size_t chunk_size) {
+    a->first = a->current = NULL;
+    a->chunk_size = round_up(chunk_size ? chunk_size : ARENA_ALIGN);
+    a->reserved = a->in_use = a->peak = 0;
+}
+
+void arena_clear(arena_t a) {
+    arena_chunk *chunk = a->first;
+    while (chunk) {
+        arena_chunk *next = chunk->next;
+        memacct_release(MEM_SCRATCH, chunk->size);
+        hugemem_free(chunk->data);
+        free(chunk);
+        chunk = next;
+    }
+    arena_init(a, a->chunk_size);
+}
+
+static arena_chunk *new_chunk(arena_t a, size_t size) {
+    arena_chunk *chunk = (arena_chunk *) malloc(sizeof(arena_chunk));
+    unsigned char *data = chunk && memacct_charge(MEM_SCRATCH, size, "arena chunk") ? hugemem_alloc(size) : NULL;
+    if (!data) {
+        fprintf(stderr, "Arena allocation of %zu bytes failed\n", size);
+        exit(EXIT_FAILURE);
+    }
+    chunk->next = NULL;
+    chunk->size = size;
+    chunk->used = 0;
+    chunk->data = data;
+    a->reserved += size;
+    return chunk;
+}
+
+/* Chunks after the current one are always empty (arena_restore empties them), so
+   the first one that fits is used; a new chunk goes right after the current one */
+void *arena_alloc(arena_t a, size_t size) {
+    size = round_up(size ? size : 1);
+
+    arena_chunk *chunk = a->current ? a->current : a->first;
+    arena_chunk *prev = NULL;
+    while (chunk && chunk->used + size > chunk->size) {
+        prev = chunk;
+        chunk = chunk->next;
+    }
+
+    if (!chunk) {
+        chunk = new_chunk(a, size > a->chunk_size ? size : a->chunk_size);
+        arena_chunk *after = a->current ? a->current : prev;
+        if (after) {
+            chunk->next = after->next;
+            after->next = chunk;
+        } else {
+            a->first = chunk;
+        }
+    }
+
+    void *p = chunk->data + chunk->used;
+    chunk->used += size;
+    a->current = chunk;
+    a->in_use += size;
+    if (a->in_use > a->peak) a->peak = a->in_use;
+    return p;
+}
+
+void *arena_calloc(arena_t a, size_t count, size_t size) {
+    void *p = arena_alloc(a, count * size);
+    memset(p, 0, count * size);
+    return p;
+}
+
+arena_mark arena_save(const arena_t a) {
+    arena_mark mark = {a->current, a->current ? a->current->used : 0, a->in_use};
+    return mark;
+}
+
+// Frees everything allocated since mark was taken
+void arena_restore(arena_t a, arena_mark mark) {
+    arena_chunk *chunk = mark.chunk ? mark.chunk->next : a->first;
+    for (; chunk; chunk = chunk->next) chunk->used = 0;
+    if (mark.chunk) mark.chunk->used = mark.used;
+    a->current = mark.chunk;
+    a->in_use = mark.in_use;
+}
+
+void arena_reset(arena_t a) {
+    arena_mark empty = {NULL, 0, 0};
+    arena_restore(a, empty);
+}
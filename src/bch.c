@@ -5,38 +5,58 @@
 #include <inttypes.h>
 #include <flint/nmod_mat.h>
 #include "bch.h"
+#include "clmul.h"
+#include "bch_tables.h"
+#include "arena.h"
+#include "memacct.h"
 
 /* -------------------
    Primitive polynomials table (bitmask includes bit for x^m)
-   Works for m = 1..15, can be extended to higher powers if needed
+   Works for m = 1..24
    ------------------- */
 static const uint32_t prim_poly_table[] = {
-    0u,      /* unused index 0 */
-    0x3u,    /* m=1 */
-    0x7u,    /* m=2 */
-    0xBu,    /* m=3 */
-    0x13u,   /* m=4 */
-    0x25u,   /* m=5 */
-    0x43u,   /* m=6 */
-    0x89u,   /* m=7 */
-    0x11Du,  /* m=8 */
-    0x211u,  /* m=9 */
-    0x409u,  /* m=10 */
-    0x805u,  /* m=11 */
-    0x1053u, /* m=12 */
-    0x201Bu, /* m=13 */
-    0x4443u, /* m=14 */
-    0x8003u, /* m=15 */
-    0x1100Bu /* (unused) */
+    0u,         /* unused index 0 */
+    0x3u,       /* m=1 */
+    0x7u,       /* m=2 */
+    0xBu,       /* m=3 */
+    0x13u,      /* m=4 */
+    0x25u,      /* m=5 */
+    0x43u,      /* m=6 */
+    0x89u,      /* m=7 */
+    0x11Du,     /* m=8 */
+    0x211u,     /* m=9 */
+    0x409u,     /* m=10 */
+    0x805u,     /* m=11 */
+    0x1053u,    /* m=12 */
+    0x201Bu,    /* m=13 */
+    0x4443u,    /* m=14 */
+    0x8003u,    /* m=15 */
+    0x1100Bu,   /* m=16 */
+    0x20009u,   /* m=17 */
+    0x40081u,   /* m=18 */
+    0x80027u,   /* m=19 */
+    0x100009u,  /* m=20 */
+    0x200005u,  /* m=21 */
+    0x400003u,  /* m=22 */
+    0x800021u,  /* m=23 */
+    0x1000087u  /* m=24 */
 };
 
+#define BCH_MAX_M 24
+/* Fields up to 2^GF_TABLE_MAX_M use log/exp tables; larger ones multiply with
+   carry-less multiplication and Barrett reduction instead of 2^m-entry tables */
+#ifndef GF_TABLE_MAX_M
+#define GF_TABLE_MAX_M 16
+#endif
+
 typedef struct {
     int m;
     uint32_t prim; /* primitive polynomial, bit for x^m included */
     uint32_t q;    /* 2^m */
     uint32_t n;    /* q-1 */
-    uint32_t *exp; /* length n*2 for easy wrap */
-    int *log;      /* length q, log[0] = -1 */
+    uint32_t *exp; /* length 2n, so exp[log a + log b] needs no reduction; NULL above GF_TABLE_MAX_M */
+    uint32_t *log; /* length q, log[0] unused */
+    uint64_t mu;   /* floor(x^(2m) / prim), for Barrett reduction */
 } gf_t;
 
 static uint32_t gf_mul_poly_reduce(uint32_t a, uint32_t b, uint32_t prim, int m)
@@ -53,23 +73,37 @@ static uint32_t gf_mul_poly_reduce(uint32_t a, uint32_t b, uint32_t prim, int m)
     return (uint32_t)res;
 }
 
-static int gf_init(gf_t *g, int m, uint32_t prim_with_top)
+// Quotient of x^(2m) by prim, by long division
+static uint64_t barrett_constant(uint32_t prim, int m)
+{
+    uint64_t rem = 1ull << (2 * m);
+    uint64_t quot = 0;
+    for (int bit = 2 * m; bit >= m; --bit) {
+        if (rem & (1ull << bit)) {
+            quot |= 1ull << (bit - m);
+            rem ^= (uint64_t)prim << (bit - m);
+        }
+    }
+    return quot;
+}
+
+// Tables live in the caller's arena and go away with its scope
+static int gf_init(gf_t *g, int m, uint32_t prim_with_top, arena_t arena)
 {
-    if (!g || m <= 0 || m > 31) return -1;
+    if (!g || m <= 0 || m > BCH_MAX_M) return -1;
     g->m = m;
     g->prim = prim_with_top;
     g->q = (1u << m);
     g->n = g->q - 1u;
-    g->exp = (uint32_t *) malloc((g->n * 2 + 2) * sizeof(uint32_t));
-    g->log = (int *) malloc((g->q + 1) * sizeof(int));
-    if (!g->exp || !g->log) {
-        free(g->exp); free(g->log);
-        return -2;
-    }
-    for (uint32_t i = 0; i <= g->q; ++i) g->log[i] = -1;
+    g->mu = barrett_constant(prim_with_top, m);
+    g->exp = NULL;
+    g->log = NULL;
+    if (m > GF_TABLE_MAX_M) return 0;
+
+    g->exp = (uint32_t *) arena_alloc(arena, (g->n * 2 + 2) * sizeof(uint32_t));
+    g->log = (uint32_t *) arena_calloc(arena, g->q + 1, sizeof(uint32_t));
     if (m == 1) {
-        g->exp[0] = 1;
-        g->exp[1] = 1;
+        g->exp[0] = g->exp[1] = g->exp[2] = 1;
         g->log[1] = 0;
         return 0;
     }
@@ -77,116 +111,235 @@ static int gf_init(gf_t *g, int m, uint32_t prim_with_top)
     uint32_t alpha = 2u;
     for (uint32_t i = 0; i < g->n; ++i) {
         g->exp[i] = cur;
-        g->log[cur] = (int)i;
+        g->log[cur] = i;
         cur = gf_mul_poly_reduce(cur, alpha, g->prim, m);
     }
     for (uint32_t i = 0; i < g->n; ++i) g->exp[g->n + i] = g->exp[i];
     return 0;
 }
 
-static void gf_free(gf_t *g)
+static inline uint32_t gf_mul_elem(const gf_t *g, uint32_t a, uint32_t b)
 {
-    if (!g) return;
-    free(g->exp); g->exp = NULL;
-    free(g->log); g->log = NULL;
+    if (a == 0 || b == 0) return 0;
+    if (g->exp) return g->exp[g->log[a] + g->log[b]];
+
+    /* a*b has degree <= 2m-2; Barrett: t = floor(floor(ab / x^m) * mu / x^m),
+       then ab - t*prim is the remainder */
+    uint64_t prod = clmul64(a, b, NULL);
+    uint64_t t = clmul64(prod >> g->m, g->mu, NULL) >> g->m;
+    return (uint32_t)((prod ^ clmul64(t, g->prim, NULL)) & g->n);
 }
 
-static uint32_t gf_mul_elem(const gf_t *g, uint32_t a, uint32_t b)
+// alpha^e, by square-and-multiply
+static uint32_t gf_pow_alpha(const gf_t *g, uint32_t e)
 {
-    if (!g) return 0;
-    if (a == 0 || b == 0) return 0;
-    int la = g->log[a];
-    int lb = g->log[b];
-    if (la < 0 || lb < 0) return 0;
-    uint32_t e = (uint32_t)(la + lb) % g->n;
-    return g->exp[e];
+    if (g->exp) return g->exp[e % g->n];
+    uint32_t result = 1, base = 2u;
+    if (g->m == 1) return 1;
+    for (e %= g->n; e; e >>= 1) {
+        if (e & 1) result = gf_mul_elem(g, result, base);
+        base = gf_mul_elem(g, base, base);
+    }
+    return result;
 }
 
-static uint32_t *cyclotomic_coset(const gf_t *g, uint32_t a, uint32_t *out_sz)
+// Fills coset (room for m entries) with the cyclotomic coset of a: a, 2a, 4a, ... mod n
+static uint32_t cyclotomic_coset(const gf_t *g, uint32_t a, uint32_t *coset)
 {
     uint32_t n = g->n;
-    uint32_t *buf = (uint32_t *) malloc((g->m + 2) * sizeof(uint32_t));
-    uint32_t cur = a % n;
+    uint32_t start = a % n;
+    uint32_t cur = start;
     uint32_t cnt = 0;
     do {
-        buf[cnt++] = cur;
-        cur = (cur * 2u) % n;
-    } while (cur != a);
-    *out_sz = cnt;
-    return buf;
+        coset[cnt++] = cur;
+        cur = (uint32_t)(((uint64_t)cur * 2u) % n);
+    } while (cur != start);
+    return cnt;
 }
 
-static uint32_t *poly_mul_field(const gf_t *g, const uint32_t *A, uint32_t degA, const uint32_t *B, uint32_t degB)
+/* Computes minimal polynomial (over GF(2)) of alpha^leader, whose conjugates are
+   alpha^leader, alpha^(2 leader), ... i.e. repeated squares.
+   Computes product_{r in coset} (x + alpha^{r}) in place in poly (room for m+1 field
+   coefficients), multiplying in one linear factor at a time.
+   Returns the result as a bit vector (LSB const term); deg <= m <= 24 fits one word.
+*/
+static uint64_t minimal_polynomial_from_coset(const gf_t *g, uint32_t leader, uint32_t sz,
+                                              uint32_t *poly)
 {
-    uint32_t degR = degA + degB;
-    uint32_t *R = (uint32_t *) calloc((degR + 1), sizeof(uint32_t));
-    for (uint32_t i = 0; i <= degA; ++i) {
-        if (A[i] == 0) continue;
-        for (uint32_t j = 0; j <= degB; ++j) {
-            if (B[j] == 0) continue;
-            uint32_t p = gf_mul_elem(g, A[i], B[j]);
-            R[i + j] ^= p;
+    poly[0] = 1;
+    uint32_t deg = 0;
+    uint32_t root = gf_pow_alpha(g, leader);
+
+    for (uint32_t i = 0; i < sz; ++i) {
+        // poly *= (x + root)
+        poly[deg + 1] = poly[deg];
+        for (uint32_t j = deg; j > 0; --j) {
+            poly[j] = poly[j - 1] ^ gf_mul_elem(g, poly[j], root);
         }
+        poly[0] = gf_mul_elem(g, poly[0], root);
+        ++deg;
+        root = gf_mul_elem(g, root, root);
     }
-    return R;
+
+    // The product of a full set of conjugates has coefficients in GF(2)
+    uint64_t bits = 0;
+    for (uint32_t i = 0; i <= deg; ++i) bits |= (uint64_t)(poly[i] != 0) << i;
+    return bits;
 }
 
-/* Computes minimal polynomial (over GF(2)) for cyclotomic coset `powers` with size `sz`.
-   Computes product_{r in coset} (x + alpha^{r}) using field arithmetic. 
-   Returns a bit vector (LSB const term).
-   degree_out set to degree.
-*/
-static uint8_t *minimal_polynomial_from_coset(const gf_t *g, const uint32_t *powers, uint32_t sz, uint32_t *degree_out)
+/* Table entry for the code with designed distance 2t + 1: the entry with the
+   largest t_start <= t. NULL when (m, t) is not tabulated or 2t >= n. */
+const bch_table_entry *bch_table_lookup(int m, int t)
 {
-    // poly in field coeffs: start with 1
-    uint32_t *poly = (uint32_t *) calloc(1, sizeof(uint32_t));
-    poly[0] = 1; uint32_t deg = 0;
+#ifdef BCH_NO_TABLES
+    (void) m; (void) t;
+    return NULL;
+#else
+    if (m < 1 || m > BCH_K_TABLE_MAX_M || t < 1) return NULL;
+    const bch_table *tab = &bch_tables[m];
+    if (tab->count == 0 || 2u * (uint32_t)t >= ((uint32_t)1 << m) - 1u) return NULL;
 
-    for (uint32_t i = 0; i < sz; ++i) {
-        uint32_t root = g->exp[powers[i]]; // alpha^{powers[i]} 
-        uint32_t factor[2];
-        factor[0] = root; factor[1] = 1; // (x + root) -> [root, 1]
-        uint32_t *newpoly = poly_mul_field(g, poly, deg, factor, 1);
-        free(poly);
-        poly = newpoly;
-        deg = deg + 1;
+    uint32_t lo = 0, hi = tab->count;
+    while (hi - lo > 1) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (tab->entries[mid].t_start <= (uint32_t)t) lo = mid;
+        else hi = mid;
     }
+    return &tab->entries[lo];
+#endif
+}
 
-    // Convert field coefficients to bits (0 or 1)
-    uint8_t *out = (uint8_t *) calloc(deg + 1, sizeof(uint8_t));
-    for (uint32_t i = 0; i <= deg; ++i) {
-        if (poly[i] == 0u) out[i] = 0;
-        else if (poly[i] == 1u) out[i] = 1;
-        else out[i] = 1; // fallback
+/* Dimension k and redundancy r = n - k of the BCH code with designed distance
+   2t + 1, from the precomputed table when possible, otherwise by summing the
+   sizes of the cyclotomic cosets of 1 .. 2t. */
+int bch_compute_k_from_mt(int m, int t, uint32_t *k_out, uint32_t *r_out)
+{
+    if (m < 1 || m > 31) return -1;
+    if (t < 1) return -2;
+
+    uint32_t n = ((uint32_t)1 << m) - 1u;
+    uint32_t max_req = 2u * (uint32_t)t;
+    if (max_req >= n) return -3;
+
+    uint32_t r = 0;
+    const bch_table_entry *e = bch_table_lookup(m, t);
+    if (e) {
+        r = n - e->k;
+    } else {
+        size_t covered_bytes = (n / 64 + 1) * sizeof(uint64_t);
+        if (!memacct_charge(MEM_BCH, covered_bytes, "cyclotomic coset mask")) return -4;
+        uint64_t *covered = (uint64_t *) calloc(n / 64 + 1, sizeof(uint64_t));
+        if (!covered) {
+            memacct_release(MEM_BCH, covered_bytes);
+            return -4;
+        }
+
+        for (uint32_t a = 1; a <= max_req; ++a) {
+            uint32_t p = a % n;
+            if (covered[p / 64] & (1ull << (p % 64))) continue;
+
+            /* walk coset starting at p: p, 2p mod n, 4p mod n, ... */
+            uint32_t cur = p;
+            do {
+                covered[cur / 64] |= 1ull << (cur % 64);
+                ++r;
+                cur = (uint32_t)(((uint64_t)cur * 2u) % n);
+            } while (cur != p);
+        }
+
+        free(covered);
+        memacct_release(MEM_BCH, covered_bytes);
+    }
+
+    if (k_out) *k_out = n - r;
+    if (r_out) *r_out = r;
+    return 0;
+}
+
+// Prints the tabulated codes for m (or every tabulated m when m == 0)
+int bch_print_table(FILE *out, int m)
+{
+#ifdef BCH_NO_TABLES
+    (void) out; (void) m;
+    fprintf(stderr, "bch_print_table: built without BCH tables\n");
+    return -1;
+#else
+    if (m < 0 || m > BCH_K_TABLE_MAX_M) {
+        fprintf(stderr, "bch_print_table: m=%d is not tabulated (1..%d)\n", m, BCH_K_TABLE_MAX_M);
+        return -1;
+    }
+
+    fprintf(out, "%3s %10s %10s %10s %10s %10s %10s %s\n",
+            "m", "n", "t_start", "t_end", "k", "r", "d", "g(x)");
+    for (int mm = m ? m : 1; mm <= (m ? m : BCH_K_TABLE_MAX_M); ++mm) {
+        const bch_table *tab = &bch_tables[mm];
+        uint32_t n = ((uint32_t)1 << mm) - 1u;
+        for (uint32_t i = 0; i < tab->count; ++i) {
+            const bch_table_entry *e = &tab->entries[i];
+            uint32_t t_end = i + 1 < tab->count ? tab->entries[i + 1].t_start - 1 : (n - 1) / 2;
+            fprintf(out, "%3d %10u %10u %10u %10u %10u %10u %s\n",
+                    mm, n, e->t_start, t_end, e->k, n - e->k, 2 * t_end + 1,
+                    mm <= BCH_G_TABLE_MAX_M ? "table" : "computed");
+        }
     }
-    free(poly);
-    *degree_out = deg;
-    return out;
+    return 0;
+#endif
 }
 
-// Multiply two bit-polynomials (coeffs in {0,1})
-static uint8_t *poly_mul_bits(const uint8_t *A, uint32_t degA, const uint8_t *B, uint32_t degB)
+typedef struct {
+    uint64_t *words;
+    slong len;
+} poly_span;
+
+/* Multiplies factors[0..count) together with a balanced product tree, so the
+   large products near the root are between operands of similar size and hit
+   the Karatsuba path. Products and Karatsuba scratch come from the arena; the
+   product is left in factors[0]. */
+static void poly_product_tree(poly_span *factors, slong count, arena_t arena)
 {
-    uint32_t degR = degA + degB;
-    uint8_t *R = (uint8_t *) calloc(degR + 1, sizeof(uint8_t));
-    for (uint32_t i = 0; i <= degA; ++i) {
-        if (!A[i]) continue;
-        for (uint32_t j = 0; j <= degB; ++j) {
-            if (!B[j]) continue;
-            R[i + j] ^= 1;
+    for (slong step = 1; step < count; step *= 2) {
+        for (slong i = 0; i + step < count; i += 2 * step) {
+            poly_span *a = &factors[i], *b = &factors[i + step];
+            uint64_t *out = (uint64_t *) arena_alloc(arena, (a->len + b->len) * sizeof(uint64_t));
+
+            arena_mark scratch = arena_save(arena);
+            uint64_t *tmp = (uint64_t *) arena_alloc(arena, gf2x_mul_scratch_words(a->len, b->len) * sizeof(uint64_t));
+            gf2x_mul_words_tmp(out, a->words, a->len, b->words, b->len, tmp);
+            arena_restore(arena, scratch);
+
+            a->words = out;
+            a->len += b->len;
+            while (a->len > 1 && out[a->len - 1] == 0) --a->len;
         }
     }
-    return R;
+}
+
+/* Enough arena for one bch_genpoly_gf2x call, so it normally runs on a single
+   chunk: field tables, the coset bitset, one word per factor, about log2(t) + 6
+   copies of a deg g(x) polynomial for the product tree and its scratch, and the
+   alignment padding of the up to t products */
+static size_t genpoly_arena_size(int m, int t)
+{
+    uint64_t n = ((uint64_t)1 << m) - 1u;
+    uint64_t r = (uint64_t)m * (uint32_t)t < n ? (uint64_t)m * (uint32_t)t : n;
+    uint64_t levels = 2;
+    for (uint32_t c = 1; c < (uint32_t)t; c *= 2) ++levels;
+
+    uint64_t bytes = (n / 64 + 1) * 8 + (uint64_t)t * (sizeof(poly_span) + 8);
+    if (m <= GF_TABLE_MAX_M) bytes += (3 * n + 4) * sizeof(uint32_t);
+    bytes += (r / 64 + 2 * levels) * 8 * (levels + 6) + (uint64_t)t * 2 * ARENA_ALIGN;
+    return (size_t) bytes + 4096;
 }
 
 /* Compute generator polynomial for designed distance = 2*t + 1 (roots alpha^1 .. alpha^{2t})
-   Returns bit-vector gpoly (LSB = constant), degree in deg_out.
-   Supported m range: 1..15 (based on primitive polynomial table)
+   as a packed GF(2)[x] polynomial. All temporaries come from one arena, so apart
+   from gpoly itself the whole construction costs O(1) allocations.
+   Supported m range: 1..24 (based on primitive polynomial table)
 */
-int bch_genpoly(int m, int t, uint8_t **gpoly_out, uint32_t *deg_out)
+int bch_genpoly_gf2x(int m, int t, gf2x_t gpoly)
 {
-    if (m > 15) {
-        fprintf(stderr, "bch_genpoly: unsupported m=%d (1..15 in this build)\n", m);
+    if (m < 1 || m > BCH_MAX_M) {
+        fprintf(stderr, "bch_genpoly: unsupported m=%d (1..%d in this build)\n", m, BCH_MAX_M);
         return -1;
     }
     if (t < 1) {
@@ -194,109 +347,120 @@ int bch_genpoly(int m, int t, uint8_t **gpoly_out, uint32_t *deg_out)
         return -2;
     }
 
+    uint32_t n = ((uint32_t)1 << m) - 1u;
+    uint32_t max_req = 2u * (uint32_t)t;
+    if (max_req >= n) {
+        fprintf(stderr, "bch_genpoly: requested 2t >= n (n = %u) - reduce t\n", n);
+        return -4;
+    }
+
+#ifndef BCH_NO_TABLES
+    if (m <= BCH_G_TABLE_MAX_M) {
+        const bch_table_entry *e = bch_table_lookup(m, t);
+        slong words = (n - e->k) / 64 + 1;
+        gf2x_zero(gpoly);
+        gf2x_fit_length(gpoly, words);
+        memcpy(gpoly->coeffs, bch_gpoly_words + e->goffset, words * sizeof(uint64_t));
+        gpoly->length = words;
+        return 0;
+    }
+#endif
+
     uint32_t prim = prim_poly_table[m];
     if ((prim & (1u << m)) == 0) prim |= (1u << m);
 
+    arena_t arena;
+    arena_init(arena, genpoly_arena_size(m, t));
+
     gf_t g;
-    if (gf_init(&g, m, prim) != 0) {
+    if (gf_init(&g, m, prim, arena) != 0) {
         fprintf(stderr, "bch_genpoly: gf_init failed for m=%d\n", m);
+        arena_clear(arena);
         return -3;
     }
-    uint32_t n = g.n;
-
-    uint32_t designed = 2u * (uint32_t)t + 1u;
-    uint32_t max_req = 2u * (uint32_t)t;
-    if (max_req >= n) {
-        fprintf(stderr, "bch_genpoly: requested 2t >= n (n = %u) - reduce t\n", n);
-        gf_free(&g);
-        return -4;
-    }
-
-    //covered exponents 
-    char *covered = (char *) calloc(n, sizeof(char));
 
-    // generator poly start = 1 
-    uint8_t *gpoly = (uint8_t *) calloc(1, sizeof(uint8_t));
-    gpoly[0] = 1; uint32_t gdeg = 0;
+    // covered exponents, one bit each
+    uint64_t *covered = (uint64_t *) arena_calloc(arena, n / 64 + 1, sizeof(uint64_t));
+    // one minimal polynomial per coset, at most t cosets are needed; each fits a word
+    poly_span *factors = (poly_span *) arena_alloc(arena, (size_t)t * sizeof(poly_span));
+    uint64_t *minpolys = (uint64_t *) arena_alloc(arena, (size_t)t * sizeof(uint64_t));
+    uint32_t coset[BCH_MAX_M], field_poly[BCH_MAX_M + 1];
 
+    slong count = 0;
     for (uint32_t a = 1; a <= max_req; ++a) {
         uint32_t power = a % n;
-        if (covered[power]) continue;
-        uint32_t coset_sz;
-        uint32_t *coset = cyclotomic_coset(&g, power, &coset_sz);
-        for (uint32_t j = 0; j < coset_sz; ++j) covered[coset[j]] = 1;
-
-        uint32_t min_deg;
-        uint8_t *minpoly = minimal_polynomial_from_coset(&g, coset, coset_sz, &min_deg);
-        uint8_t *newg = poly_mul_bits(gpoly, gdeg, minpoly, min_deg);
-        free(gpoly);
-        free(minpoly);
-        gpoly = newg;
-        gdeg += min_deg;
-        free(coset);
+        if (covered[power / 64] & (1ull << (power % 64))) continue;
+        uint32_t coset_sz = cyclotomic_coset(&g, power, coset);
+        for (uint32_t j = 0; j < coset_sz; ++j) covered[coset[j] / 64] |= 1ull << (coset[j] % 64);
+
+        minpolys[count] = minimal_polynomial_from_coset(&g, power, coset_sz, field_poly);
+        factors[count].words = &minpolys[count];
+        factors[count].len = 1;
+        ++count;
     }
 
-    free(covered);
-    gf_free(&g);
+    poly_product_tree(factors, count, arena);
 
-    *gpoly_out = gpoly;
-    *deg_out = gdeg;
+    gf2x_zero(gpoly);
+    gf2x_fit_length(gpoly, factors[0].len);
+    memcpy(gpoly->coeffs, factors[0].words, factors[0].len * sizeof(uint64_t));
+    gpoly->length = factors[0].len;
+    gf2x_normalise(gpoly);
+
+    arena_clear(arena);
     return 0;
 }
 
-static uint8_t **alloc_matrix_bytes(uint32_t k, uint32_t n)
+/* Byte-per-coefficient wrapper around bch_genpoly_gf2x.
+   Returns bit-vector gpoly (LSB = constant), degree in deg_out.
+*/
+int bch_genpoly(int m, int t, uint8_t **gpoly_out, uint32_t *deg_out)
 {
-    uint8_t **M = (uint8_t **) malloc(k * sizeof(uint8_t *));
-    if (!M) return NULL;
-    for (uint32_t i = 0; i < k; ++i) {
-        M[i] = (uint8_t *) calloc(n, sizeof(uint8_t));
-        if (!M[i]) {
-            for (uint32_t j = 0; j < i; ++j) free(M[j]);
-            free(M);
-            return NULL;
-        }
+    gf2x_t g;
+    gf2x_init(g);
+    int rc = bch_genpoly_gf2x(m, t, g);
+    if (rc != 0) {
+        gf2x_clear(g);
+        return rc;
     }
-    return M;
-}
-
-void free_matrix_bytes(uint8_t **M, uint32_t k)
-{
-    if (!M) return;
-    for (uint32_t i = 0; i < k; ++i) free(M[i]);
-    free(M);
-}
 
-uint8_t **bch_generator_matrix_bytes(const uint8_t *gpoly, uint32_t gdeg, uint32_t n, uint32_t *k_out)
-{
-    if (!gpoly) return NULL;
-    if (gdeg >= n) return NULL;
-    uint32_t r = gdeg;
-    uint32_t k = n - r;
-    uint8_t **M = alloc_matrix_bytes(k, n);
-    if (!M) return NULL;
-
-    /* For row i (0..k-1) put coefficients of x^i * g(x) at positions for powers x^{i+j}
-       Let column index 0 correspond to x^{n-1}, column n-1 to x^0 (so leftmost top = highest degree).
-    */
-    for (uint32_t i = 0; i < k; ++i) {
-        for (uint32_t j = 0; j <= r; ++j) {
-            if (!gpoly[j]) continue;
-            uint32_t power = i + j; 
-            if (power >= n) continue; 
-            uint32_t col = n - 1 - power;
-            M[i][col] = 1;
-        }
+    uint32_t gdeg = (uint32_t) gf2x_degree(g);
+    uint8_t *gpoly = (uint8_t *) malloc(gdeg + 1);
+    if (!gpoly) {
+        gf2x_clear(g);
+        return -5;
     }
+    gf2x_get_bytes(gpoly, g, gdeg + 1);
+    gf2x_clear(g);
 
-    *k_out = k;
-    return M;
+    *gpoly_out = gpoly;
+    *deg_out = gdeg;
+    return 0;
 }
 
-void copy_matrix_to_nmod_mat(nmod_mat_t M, uint8_t **bytes, uint32_t k, uint32_t n)
+/* Non-systematic generator matrix: row i holds x^i g(x), with column 0 for
+   x^(n-1) and column n-1 for x^0 (so leftmost top = highest degree). G must be
+   initialised as (n - deg g) x n. Every row is row 0 shifted i columns to the
+   left, so the rows are built with word shifts into G's single contiguous block. */
+int bch_generator_matrix(gf2_mat_t G, const gf2x_t gpoly, uint32_t n)
 {
-    for (uint32_t i = 0; i < k; ++i) {
-        for (uint32_t j = 0; j < n; ++j) {
-            nmod_mat_set_entry(M, i, j, bytes[i][j]);
+    slong r = gf2x_degree(gpoly);
+    if (r < 0 || r >= (slong) n || G->r != (slong) n - r || G->c != (slong) n) return -1;
+
+    gf2_mat_zero(G);
+    uint64_t *first = gf2_mat_row(G, 0);
+    for (slong j = 0; j <= r; ++j) {
+        if (gf2x_get_coeff(gpoly, j)) first[(n - 1 - j) / 64] |= 1ull << ((n - 1 - j) % 64);
+    }
+
+    for (slong i = 1; i < G->r; ++i) {
+        uint64_t *row = gf2_mat_row(G, i);
+        slong ws = i / 64, bs = i % 64;
+        for (slong w = 0; w + ws < G->words; ++w) {
+            uint64_t v = first[w + ws] >> bs;
+            if (bs && w + ws + 1 < G->words) v |= first[w + ws + 1] << (64 - bs);
+            row[w] = v;
         }
     }
-}
\ No newline at end of file
+    return 0;
+}
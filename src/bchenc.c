@@ -0,0 +1,236 @@
+#include <stdlib.h>
+#include <string.h>
+#include <flint/nmod_mat.h>
+#include "bchenc.h"
+#include "bch.h"
+#include "rng.h"
+#include "memacct.h"
+
+/* Register layout: bit p of the r-bit register is the coefficient of x^(r-1-p),
+   so the register reads in the same (highest degree first) order as codeword
+   columns and multiplying by x is a right shift. One extra zero word past the
+   end lets the shifts read reg[i + 1] unconditionally. */
+
+static uint64_t *alloc_register(slong rwords)
+{
+    uint64_t *reg = (uint64_t *) calloc(rwords + 1, sizeof(uint64_t));
+    if (!reg) {
+        fprintf(stderr, "bch_encoder: allocation of %ld words failed\n", rwords + 1);
+        exit(EXIT_FAILURE);
+    }
+    return reg;
+}
+
+// reg = reg * x mod g(x), with `in` added at x^r
+static inline void lfsr_step_bit(const bch_encoder_struct *enc, uint64_t *reg, int in)
+{
+    int fb = (int)(reg[0] & 1) ^ in;
+    for (slong i = 0; i < enc->rwords; ++i) reg[i] = (reg[i] >> 1) | (reg[i + 1] << 63);
+    if (fb) {
+        for (slong i = 0; i < enc->rwords; ++i) reg[i] ^= enc->glow[i];
+    }
+}
+
+// reg = reg * x^8 mod g(x), with the byte `in` (bit i = x^(7-i)) added at x^r
+static inline void lfsr_step_byte(const bch_encoder_struct *enc, uint64_t *reg, uint8_t in)
+{
+    const uint64_t *T = enc->table + (size_t)((reg[0] & 0xff) ^ in) * enc->rwords;
+    for (slong i = 0; i < enc->rwords; ++i) reg[i] = ((reg[i] >> 8) | (reg[i + 1] << 56)) ^ T[i];
+}
+
+// Feeds bits 0..nbits-1 of a packed vector (highest degree first) into the LFSR
+static void lfsr_feed(const bch_encoder_struct *enc, uint64_t *reg, const uint64_t *bits, slong nbits)
+{
+    slong j = 0;
+    // the byte step needs the 8 feedback bits to lie inside the register
+    if (enc->r >= 8) {
+        for (; j + 8 <= nbits; j += 8) {
+            lfsr_step_byte(enc, reg, (uint8_t)(bits[j / 64] >> (j % 64)));
+        }
+    }
+    for (; j < nbits; ++j) lfsr_step_bit(enc, reg, (int)(bits[j / 64] >> (j % 64)) & 1);
+}
+
+// dst bits [offset, offset + nbits) ^= src bits [0, nbits); src is zero past nbits
+static void xor_bits_at(uint64_t *dst, slong offset, const uint64_t *src, slong nbits)
+{
+    slong ws = offset / 64, bs = offset % 64;
+    slong words = GF2_WORDS(nbits), end = GF2_WORDS(offset + nbits);
+    for (slong i = 0; i < words; ++i) {
+        dst[ws + i] ^= src[i] << bs;
+        if (bs && ws + i + 1 < end) dst[ws + i + 1] ^= src[i] >> (64 - bs);
+    }
+}
+
+int bch_encoder_init(bch_encoder_t enc, int m, int t)
+{
+    memset(enc, 0, sizeof(*enc));
+
+    gf2x_t g;
+    gf2x_init(g);
+    int rc = bch_genpoly_gf2x(m, t, g);
+    if (rc != 0) {
+        gf2x_clear(g);
+        return rc;
+    }
+
+    enc->n = ((uint32_t)1 << m) - 1u;
+    enc->r = (uint32_t) gf2x_degree(g);
+    enc->k = enc->n - enc->r;
+    enc->rwords = GF2_WORDS(enc->r);
+
+    enc->glow = alloc_register(enc->rwords);
+    for (uint32_t p = 0; p < enc->r; ++p) {
+        if (gf2x_get_coeff(g, enc->r - 1 - p)) enc->glow[p / 64] |= 1ull << (p % 64);
+    }
+    gf2x_clear(g);
+
+    size_t table_bytes = (size_t) 256 * enc->rwords * sizeof(uint64_t);
+    if (!memacct_charge(MEM_BCH, table_bytes, "BCH encoder table")) {
+        bch_encoder_clear(enc);
+        return -5;
+    }
+    enc->table = (uint64_t *) calloc((size_t) 256 * enc->rwords, sizeof(uint64_t));
+    if (!enc->table) {
+        fprintf(stderr, "bch_encoder: allocation of the LFSR table failed\n");
+        memacct_release(MEM_BCH, table_bytes);
+        bch_encoder_clear(enc);
+        return -5;
+    }
+    if (enc->r < 8) return 0;
+
+    // Single-bit entries: x^(r+7-i) mod g(x) for v = 1 << i, starting from x^r mod g(x)
+    uint64_t *reg = alloc_register(enc->rwords);
+    memcpy(reg, enc->glow, enc->rwords * sizeof(uint64_t));
+    for (int i = 7; i >= 0; --i) {
+        memcpy(enc->table + ((size_t)1 << i) * enc->rwords, reg, enc->rwords * sizeof(uint64_t));
+        lfsr_step_bit(enc, reg, 0);
+    }
+    free(reg);
+
+    // Every other entry is the sum of its lowest set bit's entry and the rest
+    for (unsigned v = 3; v < 256; ++v) {
+        if (!(v & (v - 1))) continue;
+        const uint64_t *a = enc->table + (size_t)(v & (v - 1)) * enc->rwords;
+        const uint64_t *b = enc->table + (size_t)(v & -v) * enc->rwords;
+        uint64_t *out = enc->table + (size_t)v * enc->rwords;
+        for (slong i = 0; i < enc->rwords; ++i) out[i] = a[i] ^ b[i];
+    }
+    return 0;
+}
+
+void bch_encoder_clear(bch_encoder_t enc)
+{
+    if (enc->table) memacct_release(MEM_BCH, (size_t) 256 * enc->rwords * sizeof(uint64_t));
+    free(enc->glow);
+    free(enc->table);
+    memset(enc, 0, sizeof(*enc));
+}
+
+void bch_encode(const bch_encoder_t enc, const uint64_t *msg, uint64_t *codeword)
+{
+    slong kwords = GF2_WORDS(enc->k);
+    memset(codeword, 0, GF2_WORDS(enc->n) * sizeof(uint64_t));
+    memcpy(codeword, msg, kwords * sizeof(uint64_t));
+    if (enc->k % 64) codeword[kwords - 1] &= (1ull << (enc->k % 64)) - 1;
+
+    uint64_t *reg = alloc_register(enc->rwords);
+    lfsr_feed(enc, reg, codeword, enc->k);
+    xor_bits_at(codeword, enc->k, reg, enc->r);
+    free(reg);
+}
+
+// g(x) divides c(x) iff feeding all n bits leaves c(x) x^r mod g(x) = 0
+bool bch_is_codeword(const bch_encoder_t enc, const uint64_t *codeword)
+{
+    uint64_t *reg = alloc_register(enc->rwords);
+    lfsr_feed(enc, reg, codeword, enc->n);
+
+    uint64_t acc = 0;
+    for (slong i = 0; i < enc->rwords; ++i) acc |= reg[i];
+    free(reg);
+    return acc == 0;
+}
+
+/* Rows from the bottom up: row k-1 has parity x^r mod g(x), and each row above
+   multiplies the previous parity by x, so the whole matrix costs O(k r / 64). */
+void bch_systematic_generator_matrix(const bch_encoder_t enc, gf2_mat_t G)
+{
+    gf2_mat_zero(G);
+    uint64_t *reg = alloc_register(enc->rwords);
+    memcpy(reg, enc->glow, enc->rwords * sizeof(uint64_t));
+
+    for (uint32_t i = enc->k; i-- > 0;) {
+        uint64_t *row = gf2_mat_row(G, i);
+        row[i / 64] |= 1ull << (i % 64);
+        xor_bits_at(row, enc->k, reg, enc->r);
+        lfsr_step_bit(enc, reg, 0);
+    }
+    free(reg);
+}
+
+/* Encodes random messages and checks each result three ways: against the
+   LFSR syndrome, by dividing the codeword polynomial by g(x) with gf2x, and,
+   when the matrix is small enough, against the rows of [I_k | P]. */
+int bch_encoder_self_test(int m, int t, int trials, FILE *out)
+{
+    bch_encoder_t enc;
+    int rc = bch_encoder_init(enc, m, t);
+    if (rc != 0) return rc;
+
+    gf2x_t g, c, rem;
+    gf2x_init(g); gf2x_init(c); gf2x_init(rem);
+    bch_genpoly_gf2x(m, t, g);
+
+    bool use_matrix = (uint64_t) enc->k * enc->n <= (UINT64_C(1) << 26);
+    gf2_mat_t G;
+    if (use_matrix) {
+        gf2_mat_init(G, enc->k, enc->n);
+        bch_systematic_generator_matrix(enc, G);
+    }
+
+    slong nwords = GF2_WORDS(enc->n);
+    uint64_t *msg = (uint64_t *) calloc(GF2_WORDS(enc->k), sizeof(uint64_t));
+    uint64_t *cw = (uint64_t *) calloc(nwords, sizeof(uint64_t));
+    uint64_t *ref = (uint64_t *) calloc(nwords, sizeof(uint64_t));
+    if (!msg || !cw || !ref) {
+        fprintf(stderr, "bch_encoder_self_test: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    int failures = 0;
+    for (int trial = 0; trial < trials; ++trial) {
+        rng_bits(msg, enc->k);
+        bch_encode(enc, msg, cw);
+
+        bool ok = bch_is_codeword(enc, cw);
+
+        gf2x_zero(c);
+        for (uint32_t j = 0; j < enc->n; ++j) {
+            if ((cw[j / 64] >> (j % 64)) & 1) gf2x_set_coeff(c, enc->n - 1 - j, 1);
+        }
+        gf2x_rem(rem, c, g);
+        ok = ok && rem->length == 0;
+
+        if (use_matrix) {
+            memset(ref, 0, nwords * sizeof(uint64_t));
+            for (uint32_t i = 0; i < enc->k; ++i) {
+                if (!((msg[i / 64] >> (i % 64)) & 1)) continue;
+                const uint64_t *row = gf2_mat_row(G, i);
+                for (slong w = 0; w < nwords; ++w) ref[w] ^= row[w];
+            }
+            ok = ok && memcmp(ref, cw, nwords * sizeof(uint64_t)) == 0;
+        }
+
+        if (!ok) ++failures;
+    }
+
+    fprintf(out, "BCH(%u, %u) m=%d t=%d: %d/%d encodings OK%s\n", enc->n, enc->k, m, t,
+            trials - failures, trials, use_matrix ? " (checked against [I_k | P])" : "");
+
+    free(msg); free(cw); free(ref);
+    if (use_matrix) gf2_mat_clear(G);
+    gf2x_clear(g); gf2x_clear(c); gf2x_clear(rem);
+    bch_encoder_clear(enc);
+    return failures == 0 ? 0 : -6;
+}
@@ -0,0 +1,201 @@
+#include "bitperm.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define BITPERM_X86 1
+#endif
+
+// count (0..64) bits of the stream starting at bit pos
+static inline uint64_t read_bits(const uint64_t *stream, slong pos, int count)
+{
+    if (count == 0) return 0;
+    slong w = pos / 64;
+    int off = pos % 64;
+    uint64_t v = stream[w] >> off;
+    if (off && off + count > 64) v |= stream[w + 1] << (64 - off);
+    return count == 64 ? v : v & ((UINT64_C(1) << count) - 1);
+}
+
+// Appends count bits at bit pos; words are assigned when first reached, so the output need not be zeroed
+static inline void write_bits(uint64_t *stream, slong pos, uint64_t v, int count)
+{
+    if (count == 0) return;
+    slong w = pos / 64;
+    int off = pos % 64;
+    if (off == 0) {
+        stream[w] = v;
+    } else {
+        stream[w] |= v << off;
+        if (off + count > 64) stream[w + 1] = v >> (64 - off);
+    }
+}
+
+static inline uint64_t pdep64_portable(uint64_t src, uint64_t mask)
+{
+    uint64_t r = 0;
+    for (uint64_t bb = 1; mask; mask &= mask - 1, bb <<= 1) {
+        if (src & bb) r |= mask & -mask;
+    }
+    return r;
+}
+
+static inline uint64_t pext64_portable(uint64_t src, uint64_t mask)
+{
+    uint64_t r = 0;
+    for (uint64_t bb = 1; mask; mask &= mask - 1, bb <<= 1) {
+        if (src & mask & -mask) r |= bb;
+    }
+    return r;
+}
+
+static inline uint64_t word_mask(slong nbits, slong w)
+{
+    slong left = nbits - 64 * w;
+    return left >= 64 ? ~UINT64_C(0) : (UINT64_C(1) << left) - 1;
+}
+
+static inline void merge_with(uint64_t *dst, const uint64_t *mask, const uint64_t *in, const uint64_t *out,
+                              slong nbits, uint64_t (*pdep)(uint64_t, uint64_t))
+{
+    slong pin = 0, pout = 0;
+    for (slong w = 0; w < (nbits + 63) / 64; ++w) {
+        uint64_t valid = word_mask(nbits, w);
+        uint64_t m = mask[w] & valid, inv = ~mask[w] & valid;
+        int cin = __builtin_popcountll(m), cout = __builtin_popcountll(inv);
+        dst[w] = pdep(read_bits(in, pin, cin), m) | pdep(read_bits(out, pout, cout), inv);
+        pin += cin;
+        pout += cout;
+    }
+}
+
+static inline void split_with(uint64_t *in, uint64_t *out, const uint64_t *src, const uint64_t *mask,
+                              slong nbits, uint64_t (*pext)(uint64_t, uint64_t))
+{
+    slong pin = 0, pout = 0;
+    for (slong w = 0; w < (nbits + 63) / 64; ++w) {
+        uint64_t valid = word_mask(nbits, w);
+        uint64_t m = mask[w] & valid, inv = ~mask[w] & valid;
+        int cin = __builtin_popcountll(m), cout = __builtin_popcountll(inv);
+        write_bits(in, pin, pext(src[w], m), cin);
+        write_bits(out, pout, pext(src[w], inv), cout);
+        pin += cin;
+        pout += cout;
+    }
+}
+
+static void bits_merge_portable(uint64_t *dst, const uint64_t *mask, const uint64_t *in, const uint64_t *out, slong nbits)
+{
+    merge_with(dst, mask, in, out, nbits, pdep64_portable);
+}
+
+static void bits_split_portable(uint64_t *in, uint64_t *out, const uint64_t *src, const uint64_t *mask, slong nbits)
+{
+    split_with(in, out, src, mask, nbits, pext64_portable);
+}
+
+#ifdef BITPERM_X86
+__attribute__((target("bmi2")))
+static inline uint64_t pdep64_bmi2(uint64_t src, uint64_t mask)
+{
+    return _pdep_u64(src, mask);
+}
+
+__attribute__((target("bmi2")))
+static inline uint64_t pext64_bmi2(uint64_t src, uint64_t mask)
+{
+    return _pext_u64(src, mask);
+}
+
+__attribute__((target("bmi2")))
+static void bits_merge_bmi2(uint64_t *dst, const uint64_t *mask, const uint64_t *in, const uint64_t *out, slong nbits)
+{
+    merge_with(dst, mask, in, out, nbits, pdep64_bmi2);
+}
+
+__attribute__((target("bmi2")))
+static void bits_split_bmi2(uint64_t *in, uint64_t *out, const uint64_t *src, const uint64_t *mask, slong nbits)
+{
+    split_with(in, out, src, mask, nbits, pext64_bmi2);
+}
+#endif
+
+bool bitperm_has_hw(void)
+{
+#ifdef BITPERM_X86
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("bmi2");
+#else
+    return false;
+#endif
+}
+
+static void bits_merge_dispatch(uint64_t *dst, const uint64_t *mask, const uint64_t *in, const uint64_t *out, slong nbits);
+static void bits_split_dispatch(uint64_t *in, uint64_t *out, const uint64_t *src, const uint64_t *mask, slong nbits);
+
+static void (*bits_merge_impl)(uint64_t *, const uint64_t *, const uint64_t *, const uint64_t *, slong) = bits_merge_dispatch;
+static void (*bits_split_impl)(uint64_t *, uint64_t *, const uint64_t *, const uint64_t *, slong) = bits_split_dispatch;
+
+static void select_impl(void)
+{
+#ifdef BITPERM_X86
+    if (bitperm_has_hw()) {
+        bits_merge_impl = bits_merge_bmi2;
+        bits_split_impl = bits_split_bmi2;
+        return;
+    }
+#endif
+    bits_merge_impl = bits_merge_portable;
+    bits_split_impl = bits_split_portable;
+}
+
+static void bits_merge_dispatch(uint64_t *dst, const uint64_t *mask, const uint64_t *in, const uint64_t *out, slong nbits)
+{
+    select_impl();
+    bits_merge_impl(dst, mask, in, out, nbits);
+}
+
+static void bits_split_dispatch(uint64_t *in, uint64_t *out, const uint64_t *src, const uint64_t *mask, slong nbits)
+{
+    select_impl();
+    bits_split_impl(in, out, src, mask, nbits);
+}
+
+void bits_merge(uint64_t *dst, const uint64_t *mask, const uint64_t *in, const uint64_t *out, slong nbits)
+{
+    bits_merge_impl(dst, mask, in, out, nbits);
+}
+
+void bits_split(uint64_t *in, uint64_t *out, const uint64_t *src, const uint64_t *mask, slong nbits)
+{
+    bits_split_impl(in, out, src, mask, nbits);
+}
+
+static inline uint64_t reverse64(uint64_t x)
+{
+    x = ((x >> 1) & 0x5555555555555555ull) | ((x & 0x5555555555555555ull) << 1);
+    x = ((x >> 2) & 0x3333333333333333ull) | ((x & 0x3333333333333333ull) << 2);
+    x = ((x >> 4) & 0x0F0F0F0F0F0F0F0Full) | ((x & 0x0F0F0F0F0F0F0F0Full) << 4);
+    return __builtin_bswap64(x);
+}
+
+void bits_reverse(uint64_t *dst, const uint64_t *src, slong nbits)
+{
+    slong words = (nbits + 63) / 64;
+    int pad = 64 * words - nbits;
+
+    // Reversing whole words leaves the result shifted up by the padding of the last source word
+    for (slong w = 0; w < words; ++w) dst[w] = reverse64(src[words - 1 - w]);
+    if (pad) {
+        for (slong w = 0; w < words; ++w) {
+            dst[w] = (dst[w] >> pad) | (w + 1 < words ? dst[w + 1] << (64 - pad) : 0);
+        }
+    }
+}
+
+void bits_extract(uint64_t *dst, const uint64_t *src, slong start, slong nbits)
+{
+    for (slong w = 0; 64 * w < nbits; ++w) {
+        int count = nbits - 64 * w >= 64 ? 64 : (int) (nbits - 64 * w);
+        dst[w] = read_bits(src, start + 64 * w, count);
+    }
+}
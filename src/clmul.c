@@ -0,0 +1,78 @@
+#include <stddef.h>
+#include "clmul.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CLMUL_X86 1
+#endif
+
+static uint64_t clmul64_portable(uint64_t a, uint64_t b, uint64_t *hi)
+{
+    /* 4-bit window: table[i] = a * i for every 4-bit polynomial i */
+    uint64_t table_lo[16], table_hi[16];
+    table_lo[0] = table_hi[0] = 0;
+    for (int i = 1; i < 16; ++i) {
+        uint64_t lo = 0, h = 0;
+        for (int bit = 0; bit < 4; ++bit) {
+            if (i & (1 << bit)) {
+                lo ^= a << bit;
+                h ^= bit ? a >> (64 - bit) : 0;
+            }
+        }
+        table_lo[i] = lo;
+        table_hi[i] = h;
+    }
+
+    uint64_t lo = 0, h = 0;
+    for (int shift = 60; shift >= 0; shift -= 4) {
+        h = (h << 4) | (lo >> 60);
+        lo <<= 4;
+        unsigned nib = (b >> shift) & 0xF;
+        lo ^= table_lo[nib];
+        h ^= table_hi[nib];
+    }
+
+    if (hi) *hi = h;
+    return lo;
+}
+
+#ifdef CLMUL_X86
+__attribute__((target("pclmul,sse2")))
+static uint64_t clmul64_pclmul(uint64_t a, uint64_t b, uint64_t *hi)
+{
+    __m128i va = _mm_set_epi64x(0, (long long) a);
+    __m128i vb = _mm_set_epi64x(0, (long long) b);
+    __m128i r = _mm_clmulepi64_si128(va, vb, 0x00);
+    if (hi) *hi = (uint64_t) _mm_cvtsi128_si64(_mm_srli_si128(r, 8));
+    return (uint64_t) _mm_cvtsi128_si64(r);
+}
+#endif
+
+static uint64_t clmul64_dispatch(uint64_t a, uint64_t b, uint64_t *hi);
+
+static uint64_t (*clmul64_impl)(uint64_t, uint64_t, uint64_t *) = clmul64_dispatch;
+
+bool clmul_has_hw(void)
+{
+#ifdef CLMUL_X86
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("pclmul");
+#else
+    return false;
+#endif
+}
+
+static uint64_t clmul64_dispatch(uint64_t a, uint64_t b, uint64_t *hi)
+{
+#ifdef CLMUL_X86
+    clmul64_impl = clmul_has_hw() ? clmul64_pclmul : clmul64_portable;
+#else
+    clmul64_impl = clmul64_portable;
+#endif
+    return clmul64_impl(a, b, hi);
+}
+
+uint64_t clmul64(uint64_t a, uint64_t b, uint64_t *hi)
+{
+    return clmul64_impl(a, b, hi);
+}
@@ -0,0 +1,165 @@
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "dump.h"
+#include "constants.h"
+
+#define DUMP_BUFFER_SIZE (1 << 20)
+
+dump_level dump_verbosity = PRINT ? DUMP_MATRICES : DUMP_NONE;
+static dump_format dump_fmt = DUMP_TEXT;
+
+static char bit_text[256][16];      /* "b0 b1 ... b7 ", low bit first */
+static char hex_pair[256][2];
+static const char base64_chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+static pthread_once_t tables_once = PTHREAD_ONCE_INIT;
+
+static void build_tables(void)
+{
+    static const char hex[] = "0123456789abcdef";
+    for (int b = 0; b < 256; ++b) {
+        for (int i = 0; i < 8; ++i) {
+            bit_text[b][2 * i] = '0' + ((b >> i) & 1);
+            bit_text[b][2 * i + 1] = ' ';
+        }
+        hex_pair[b][0] = hex[b >> 4];
+        hex_pair[b][1] = hex[b & 15];
+    }
+}
+
+void dump_init(void)
+{
+    const char *spec = getenv("SIG_DUMP");
+    if (!spec || !*spec) return;
+
+    char *end;
+    long level = strtol(spec, &end, 10);
+    if (end != spec) {
+        dump_verbosity = level <= 0 ? DUMP_NONE : level == 1 ? DUMP_SUMMARY : DUMP_MATRICES;
+        spec = *end == ',' ? end + 1 : end;
+    }
+    if (strcmp(spec, "hex") == 0) dump_fmt = DUMP_HEX;
+    else if (strcmp(spec, "base64") == 0) dump_fmt = DUMP_BASE64;
+    else if (*spec && strcmp(spec, "text") != 0) fprintf(stderr, "Unknown SIG_DUMP format %s, using text\n", spec);
+}
+
+typedef struct {
+    FILE *fp;
+    char *buf;
+    size_t len;
+} dump_writer;
+
+static void writer_flush(dump_writer *w)
+{
+    if (w->len) fwrite(w->buf, 1, w->len, w->fp);
+    w->len = 0;
+}
+
+// Room for n more bytes, n well below DUMP_BUFFER_SIZE
+static char *writer_reserve(dump_writer *w, size_t n)
+{
+    if (w->len + n > DUMP_BUFFER_SIZE) writer_flush(w);
+    return w->buf + w->len;
+}
+
+static void writer_puts(dump_writer *w, const char *s, size_t n)
+{
+    memcpy(writer_reserve(w, n), s, n);
+    w->len += n;
+}
+
+static inline unsigned row_byte(const uint64_t *row, slong b)
+{
+    return (unsigned) (row[b / 8] >> (8 * (b % 8))) & 0xff;
+}
+
+// One packed row of c bits, a word at a time so any row length fits the buffer
+static void write_row(dump_writer *w, const uint64_t *row, slong c)
+{
+    slong bytes = (c + 7) / 8;
+    if (dump_fmt == DUMP_TEXT) {
+        writer_puts(w, "[ ", 2);
+        for (slong b = 0; b < c / 8; b += 8) {
+            slong stop = b + 8 < c / 8 ? b + 8 : c / 8;
+            char *p = writer_reserve(w, 16 * 8);
+            for (slong i = b; i < stop; ++i, p += 16) memcpy(p, bit_text[row_byte(row, i)], 16);
+            w->len += 16 * (stop - b);
+        }
+        if (c % 8) writer_puts(w, bit_text[row_byte(row, c / 8)], 2 * (c % 8));
+        writer_puts(w, "]\n", 2);
+    } else if (dump_fmt == DUMP_HEX) {
+        for (slong b = 0; b < bytes; b += 64) {
+            slong stop = b + 64 < bytes ? b + 64 : bytes;
+            char *p = writer_reserve(w, 2 * 64);
+            for (slong i = b; i < stop; ++i, p += 2) memcpy(p, hex_pair[row_byte(row, i)], 2);
+            w->len += 2 * (stop - b);
+        }
+        writer_puts(w, "\n", 1);
+    } else {
+        for (slong b = 0; b < bytes; b += 3) {
+            uint32_t v = row_byte(row, b) << 16;
+            if (b + 1 < bytes) v |= row_byte(row, b + 1) << 8;
+            if (b + 2 < bytes) v |= row_byte(row, b + 2);
+            char *p = writer_reserve(w, 4);
+            p[0] = base64_chars[(v >> 18) & 63];
+            p[1] = base64_chars[(v >> 12) & 63];
+            p[2] = b + 1 < bytes ? base64_chars[(v >> 6) & 63] : '=';
+            p[3] = b + 2 < bytes ? base64_chars[v & 63] : '=';
+            w->len += 4;
+        }
+        writer_puts(w, "\n", 1);
+    }
+}
+
+static bool writer_open(dump_writer *w, FILE *fp, slong r, slong c, const char *what)
+{
+    pthread_once(&tables_once, build_tables);
+    w->fp = fp;
+    w->len = 0;
+    w->buf = malloc(DUMP_BUFFER_SIZE);
+    if (!w->buf) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return false;
+    }
+    static const char *suffix[] = {"", ", hex rows", ", base64 rows"};
+    w->len = snprintf(w->buf, DUMP_BUFFER_SIZE, "<%ld x %ld %s%s>\n", r, c, what, suffix[dump_fmt]);
+    return true;
+}
+
+static void writer_close(dump_writer *w)
+{
+    writer_flush(w);
+    free(w->buf);
+}
+
+void dump_gf2_mat(FILE *fp, const gf2_mat_t M)
+{
+    dump_writer w;
+    if (!writer_open(&w, fp, M->r, M->c, "matrix")) return;
+    for (slong i = 0; i < M->r; ++i) write_row(&w, gf2_mat_row(M, i), M->c);
+    writer_close(&w);
+}
+
+// Entries are reduced mod 2, so each row is packed first and printed like a gf2_mat row
+void dump_nmod_mat(FILE *fp, const nmod_mat_t M, bool transpose)
+{
+    slong rows = transpose ? M->c : M->r, cols = transpose ? M->r : M->c;
+    dump_writer w;
+    if (!writer_open(&w, fp, M->r, M->c, transpose ? "matrix transpose" : "matrix")) return;
+
+    uint64_t *packed = malloc(GF2_WORDS(cols) * sizeof(uint64_t) + 1);
+    if (!packed) {
+        writer_close(&w);
+        return;
+    }
+    for (slong i = 0; i < rows; ++i) {
+        memset(packed, 0, GF2_WORDS(cols) * sizeof(uint64_t));
+        for (slong j = 0; j < cols; ++j) {
+            mp_limb_t e = transpose ? nmod_mat_entry(M, j, i) : nmod_mat_entry(M, i, j);
+            packed[j / 64] |= (uint64_t) (e & 1) << (j % 64);
+        }
+        write_row(&w, packed, cols);
+    }
+    free(packed);
+    writer_close(&w);
+}
@@ -0,0 +1,111 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "envelope.h"
+#include "utils.h"
+#include "trace.h"
+
+_Static_assert(sizeof(envelope_header) == 56, "envelope_header layout changed");
+_Static_assert(sizeof(envelope_header) % sizeof(uint64_t) == 0, "signature words must stay aligned");
+
+static size_t signature_bytes(uint32_t sig_bits) {
+    return (size_t) GF2_WORDS(sig_bits) * sizeof(uint64_t);
+}
+
+size_t envelope_size(uint32_t sig_bits, uint32_t salt_len) {
+    return sizeof(envelope_header) + signature_bytes(sig_bits) + salt_len;
+}
+
+bool envelope_write(const char *path, const gf2_mat_t signature, uint32_t msg_len,
+                    const unsigned char *salt, uint32_t salt_len,
+                    const unsigned char key_id[PUBKEY_DIGEST_SIZE]) {
+    char tmp_path[MAX_FILENAME_LENGTH];
+    FILE *file = open_atomic_file(path, "wb", tmp_path);
+    if (!file) {
+        fprintf(stderr, "Error opening file for writing: %s\n", path);
+        return false;
+    }
+
+    envelope_header header = {0};
+    memcpy(header.magic, ENVELOPE_MAGIC, sizeof(header.magic));
+    header.version = ENVELOPE_VERSION;
+    header.sig_bits = (uint32_t) signature->c;
+    header.msg_len = msg_len;
+    header.salt_len = salt_len;
+    memcpy(header.key_id, key_id, PUBKEY_DIGEST_SIZE);
+
+    size_t sig_len = signature_bytes(header.sig_bits);
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+              fwrite(gf2_mat_row(signature, 0), 1, sig_len, file) == sig_len &&
+              fwrite(salt, 1, salt_len, file) == salt_len;
+    if (!ok) {
+        discard_atomic_file(file, tmp_path);
+        return false;
+    }
+    trace_add("io.bytes_written", sizeof(header) + sig_len + salt_len);
+    return commit_atomic_file(file, tmp_path, path);
+}
+
+/* Validates an envelope in place without copying; env points into buf afterwards.
+   buf must be 8-byte aligned so the signature can be used as packed words. */
+bool envelope_parse(const void *buf, size_t len, sig_envelope *env) {
+    const unsigned char *bytes = (const unsigned char *) buf;
+    if (!buf || len < sizeof(envelope_header) || ((uintptr_t) buf % sizeof(uint64_t)) != 0) return false;
+
+    const envelope_header *header = (const envelope_header *) bytes;
+    if (memcmp(header->magic, ENVELOPE_MAGIC, sizeof(header->magic)) != 0) return false;
+    if (header->version != ENVELOPE_VERSION) return false;
+    if (len != envelope_size(header->sig_bits, header->salt_len)) return false;
+
+    const uint64_t *sig = (const uint64_t *) (bytes + sizeof(envelope_header));
+    slong words = GF2_WORDS(header->sig_bits);
+
+    // Bits past sig_bits must be zero, as gf2_mat kernels rely on it
+    if (header->sig_bits % 64 && (sig[words - 1] >> (header->sig_bits % 64)) != 0) return false;
+
+    env->header = header;
+    env->signature.r = 1;
+    env->signature.c = header->sig_bits;
+    env->signature.words = words;
+    env->signature.bits = (uint64_t *) sig;
+    env->salt = bytes + sizeof(envelope_header) + signature_bytes(header->sig_bits);
+    env->key_id = header->key_id;
+    return true;
+}
+
+bool envelope_open(const char *path, sig_envelope *env) {
+    memset(env, 0, sizeof(*env));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(envelope_header)) {
+        close(fd);
+        return false;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return false;
+
+    if (!envelope_parse(map, st.st_size, env)) {
+        munmap(map, st.st_size);
+        memset(env, 0, sizeof(*env));
+        return false;
+    }
+
+    env->map = map;
+    env->map_len = st.st_size;
+    trace_add("io.bytes_read", st.st_size);
+    return true;
+}
+
+void envelope_close(sig_envelope *env) {
+    if (env->map) munmap(env->map, env->map_len);
+    memset(env, 0, sizeof(*env));
+}
@@ -0,0 +1,60 @@
+#include <stdlib.h>
+#include <string.h>
+#include "gf2mat.h"
+#include "dump.h"
+#include "hugemem.h"
+#include "memacct.h"
+
+void gf2_mat_init(gf2_mat_t M, slong r, slong c) {
+    M->r = r;
+    M->c = c;
+    M->words = GF2_WORDS(c);
+
+    size_t bytes = (size_t) (r * M->words) * sizeof(uint64_t);
+    // Large matrices land on huge pages; the block comes back zeroed
+    M->bits = memacct_charge(MEM_MATRICES, bytes, "GF(2) matrix") ? hugemem_alloc(bytes) : NULL;
+    if (!M->bits) {
+        fprintf(stderr, "Memory allocation failed for %ld x %ld GF(2) matrix\n", r, c);
+        exit(EXIT_FAILURE);
+    }
+}
+
+void gf2_mat_clear(gf2_mat_t M) {
+    if (M->bits) memacct_release(MEM_MATRICES, (size_t) (M->r * M->words) * sizeof(uint64_t));
+    hugemem_free(M->bits);
+    M->bits = NULL;
+}
+
+void gf2_mat_zero(gf2_mat_t M) {
+    memset(M->bits, 0, (size_t) (M->r * M->words) * sizeof(uint64_t));
+}
+
+// M and A must have the same dimensions
+void gf2_mat_set_nmod(gf2_mat_t M, const nmod_mat_t A) {
+    for (slong i = 0; i < M->r; ++i) {
+        uint64_t *row = gf2_mat_row(M, i);
+        memset(row, 0, M->words * sizeof(uint64_t));
+        for (slong j = 0; j < M->c; ++j) {
+            if (nmod_mat_get_entry(A, i, j) & 1) {
+                row[j / 64] |= UINT64_C(1) << (j % 64);
+            }
+        }
+    }
+}
+
+void gf2_mat_get_nmod(nmod_mat_t A, const gf2_mat_t M) {
+    for (slong i = 0; i < M->r; ++i) {
+        for (slong j = 0; j < M->c; ++j) {
+            nmod_mat_set_entry(A, i, j, gf2_mat_get(M, i, j));
+        }
+    }
+}
+
+int gf2_mat_equal(const gf2_mat_t A, const gf2_mat_t B) {
+    if (A->r != B->r || A->c != B->c) return 0;
+    return memcmp(A->bits, B->bits, (size_t) (A->r * A->words) * sizeof(uint64_t)) == 0;
+}
+
+void gf2_mat_print(FILE *fp, const gf2_mat_t M) {
+    dump_gf2_mat(fp, M);
+}
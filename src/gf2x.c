@@ -0,0 +1,346 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gf2x.h"
+#include "clmul.h"
+
+void gf2x_init(gf2x_t f)
+{
+    f->coeffs = NULL;
+    f->alloc = 0;
+    f->length = 0;
+}
+
+void gf2x_clear(gf2x_t f)
+{
+    free(f->coeffs);
+    gf2x_init(f);
+}
+
+// Makes room for at least `words` words; new words are zeroed
+void gf2x_fit_length(gf2x_t f, slong words)
+{
+    if (words <= f->alloc) return;
+    slong alloc = f->alloc * 2 > words ? f->alloc * 2 : words;
+    uint64_t *coeffs = (uint64_t *) realloc(f->coeffs, alloc * sizeof(uint64_t));
+    if (!coeffs) {
+        fprintf(stderr, "gf2x: allocation of %ld words failed\n", alloc);
+        exit(EXIT_FAILURE);
+    }
+    memset(coeffs + f->alloc, 0, (alloc - f->alloc) * sizeof(uint64_t));
+    f->coeffs = coeffs;
+    f->alloc = alloc;
+}
+
+void gf2x_normalise(gf2x_t f)
+{
+    while (f->length > 0 && f->coeffs[f->length - 1] == 0) --f->length;
+}
+
+void gf2x_zero(gf2x_t f)
+{
+    if (f->coeffs) memset(f->coeffs, 0, f->alloc * sizeof(uint64_t));
+    f->length = 0;
+}
+
+void gf2x_one(gf2x_t f)
+{
+    gf2x_zero(f);
+    gf2x_set_coeff(f, 0, 1);
+}
+
+void gf2x_set(gf2x_t f, const gf2x_t g)
+{
+    if (f == g) return;
+    gf2x_zero(f);
+    gf2x_fit_length(f, g->length);
+    if (g->length) memcpy(f->coeffs, g->coeffs, g->length * sizeof(uint64_t));
+    f->length = g->length;
+}
+
+void gf2x_swap(gf2x_t f, gf2x_t g)
+{
+    gf2x_struct t = *f;
+    *f = *g;
+    *g = t;
+}
+
+int gf2x_equal(const gf2x_t f, const gf2x_t g)
+{
+    return f->length == g->length &&
+           (f->length == 0 || memcmp(f->coeffs, g->coeffs, f->length * sizeof(uint64_t)) == 0);
+}
+
+// Degree of f, or -1 for the zero polynomial
+slong gf2x_degree(const gf2x_t f)
+{
+    if (f->length == 0) return -1;
+    return (f->length - 1) * 64 + 63 - __builtin_clzll(f->coeffs[f->length - 1]);
+}
+
+int gf2x_get_coeff(const gf2x_t f, slong i)
+{
+    if (i / 64 >= f->length) return 0;
+    return (f->coeffs[i / 64] >> (i % 64)) & 1;
+}
+
+void gf2x_set_coeff(gf2x_t f, slong i, int c)
+{
+    slong w = i / 64;
+    if (c) {
+        gf2x_fit_length(f, w + 1);
+        f->coeffs[w] |= 1ull << (i % 64);
+        if (w + 1 > f->length) f->length = w + 1;
+    } else if (w < f->length) {
+        f->coeffs[w] &= ~(1ull << (i % 64));
+        gf2x_normalise(f);
+    }
+}
+
+// Packs len coefficients stored one per byte (nonzero = 1), constant term first
+void gf2x_set_bytes(gf2x_t f, const uint8_t *coeffs, slong len)
+{
+    gf2x_zero(f);
+    gf2x_fit_length(f, (len + 63) / 64);
+    for (slong i = 0; i < len; ++i) {
+        if (coeffs[i]) f->coeffs[i / 64] |= 1ull << (i % 64);
+    }
+    f->length = (len + 63) / 64;
+    gf2x_normalise(f);
+}
+
+void gf2x_get_bytes(uint8_t *coeffs, const gf2x_t f, slong len)
+{
+    for (slong i = 0; i < len; ++i) coeffs[i] = (uint8_t) gf2x_get_coeff(f, i);
+}
+
+void gf2x_add(gf2x_t r, const gf2x_t a, const gf2x_t b)
+{
+    slong len = a->length > b->length ? a->length : b->length;
+    gf2x_fit_length(r, len);
+    for (slong i = 0; i < len; ++i) {
+        uint64_t x = i < a->length ? a->coeffs[i] : 0;
+        uint64_t y = i < b->length ? b->coeffs[i] : 0;
+        r->coeffs[i] = x ^ y;
+    }
+    for (slong i = len; i < r->length; ++i) r->coeffs[i] = 0;
+    r->length = len;
+    gf2x_normalise(r);
+}
+
+/* ---------- multiplication ---------- */
+
+// Schoolbook: one 64x64 carry-less product per pair of words, r zeroed here
+static void mul_basecase(uint64_t *r, const uint64_t *a, slong an, const uint64_t *b, slong bn)
+{
+    memset(r, 0, (an + bn) * sizeof(uint64_t));
+    for (slong i = 0; i < an; ++i) {
+        if (!a[i]) continue;
+        for (slong j = 0; j < bn; ++j) {
+            uint64_t hi;
+            r[i + j] ^= clmul64(a[i], b[j], &hi);
+            r[i + j + 1] ^= hi;
+        }
+    }
+}
+
+/* Karatsuba on two n-word operands: r (2n words) = a * b.
+   tmp needs karatsuba_scratch(n) words. */
+static slong karatsuba_scratch(slong n)
+{
+    slong total = 0;
+    while (n >= GF2X_KARATSUBA_THRESHOLD) {
+        slong hi = n - n / 2;
+        total += 4 * hi;
+        n = hi;
+    }
+    return total + 1;
+}
+
+static void mul_karatsuba(uint64_t *r, const uint64_t *a, const uint64_t *b, slong n, uint64_t *tmp)
+{
+    if (n < GF2X_KARATSUBA_THRESHOLD) {
+        mul_basecase(r, a, n, b, n);
+        return;
+    }
+
+    slong lo = n / 2, hi = n - lo;
+    uint64_t *sa = tmp, *sb = tmp + hi, *mid = tmp + 2 * hi, *next = tmp + 4 * hi;
+
+    // z0 = a0 b0 in r[0, 2lo), z2 = a1 b1 in r[2lo, 2n)
+    mul_karatsuba(r, a, b, lo, next);
+    mul_karatsuba(r + 2 * lo, a + lo, b + lo, hi, next);
+
+    // mid = (a0 + a1)(b0 + b1)
+    for (slong i = 0; i < hi; ++i) {
+        sa[i] = a[lo + i] ^ (i < lo ? a[i] : 0);
+        sb[i] = b[lo + i] ^ (i < lo ? b[i] : 0);
+    }
+    mul_karatsuba(mid, sa, sb, hi, next);
+
+    // z1 = mid - z0 - z2, added in at x^(64 lo)
+    for (slong i = 0; i < 2 * lo; ++i) mid[i] ^= r[i];
+    for (slong i = 0; i < 2 * hi; ++i) mid[i] ^= r[2 * lo + i];
+    for (slong i = 0; i < 2 * hi; ++i) r[lo + i] ^= mid[i];
+}
+
+// Scratch words gf2x_mul_words_tmp needs for an an x bn word product
+slong gf2x_mul_scratch_words(slong an, slong bn)
+{
+    if (an < bn) {
+        slong tn = an; an = bn; bn = tn;
+    }
+    if (bn < GF2X_KARATSUBA_THRESHOLD) return 0;
+    return karatsuba_scratch(bn) + 2 * bn + (an % bn ? gf2x_mul_scratch_words(bn, an % bn) : 0);
+}
+
+// gf2x_mul_words with caller-provided scratch of gf2x_mul_scratch_words(an, bn) words
+void gf2x_mul_words_tmp(uint64_t *r, const uint64_t *a, slong an, const uint64_t *b, slong bn,
+                        uint64_t *tmp)
+{
+    if (an < bn) {
+        const uint64_t *t = a; a = b; b = t;
+        slong tn = an; an = bn; bn = tn;
+    }
+    if (bn == 0) {
+        memset(r, 0, an * sizeof(uint64_t));
+        return;
+    }
+    if (bn < GF2X_KARATSUBA_THRESHOLD) {
+        mul_basecase(r, a, an, b, bn);
+        return;
+    }
+
+    // Unbalanced operands: multiply bn-word chunks of a by b and accumulate
+    uint64_t *prod = tmp + karatsuba_scratch(bn);
+
+    memset(r, 0, (an + bn) * sizeof(uint64_t));
+    slong off = 0;
+    for (; off + bn <= an; off += bn) {
+        mul_karatsuba(prod, a + off, b, bn, tmp);
+        for (slong i = 0; i < 2 * bn; ++i) r[off + i] ^= prod[i];
+    }
+    if (off < an) {
+        slong rest = an - off;
+        gf2x_mul_words_tmp(prod, b, bn, a + off, rest, prod + 2 * bn);
+        for (slong i = 0; i < bn + rest; ++i) r[off + i] ^= prod[i];
+    }
+}
+
+void gf2x_mul_words(uint64_t *r, const uint64_t *a, slong an, const uint64_t *b, slong bn)
+{
+    slong words = gf2x_mul_scratch_words(an, bn);
+    uint64_t *tmp = NULL;
+    if (words) {
+        tmp = (uint64_t *) malloc(words * sizeof(uint64_t));
+        if (!tmp) {
+            fprintf(stderr, "gf2x: allocation of Karatsuba scratch failed\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    gf2x_mul_words_tmp(r, a, an, b, bn, tmp);
+    free(tmp);
+}
+
+void gf2x_mul(gf2x_t r, const gf2x_t a, const gf2x_t b)
+{
+    if (a->length == 0 || b->length == 0) {
+        gf2x_zero(r);
+        return;
+    }
+
+    slong len = a->length + b->length;
+    uint64_t *out = (uint64_t *) malloc(len * sizeof(uint64_t));
+    if (!out) {
+        fprintf(stderr, "gf2x: allocation of %ld words failed\n", len);
+        exit(EXIT_FAILURE);
+    }
+    gf2x_mul_words(out, a->coeffs, a->length, b->coeffs, b->length);
+
+    // out is separate from a and b, so r may alias either
+    free(r->coeffs);
+    r->coeffs = out;
+    r->alloc = len;
+    r->length = len;
+    gf2x_normalise(r);
+}
+
+/* ---------- division ---------- */
+
+// r ^= b * x^shift, r having room for it
+static void add_shifted(uint64_t *r, const uint64_t *b, slong bn, slong shift)
+{
+    slong ws = shift / 64;
+    int bs = shift % 64;
+    if (bs == 0) {
+        for (slong i = 0; i < bn; ++i) r[ws + i] ^= b[i];
+        return;
+    }
+    uint64_t carry = 0;
+    for (slong i = 0; i < bn; ++i) {
+        r[ws + i] ^= (b[i] << bs) | carry;
+        carry = b[i] >> (64 - bs);
+    }
+    if (carry) r[ws + bn] ^= carry;
+}
+
+/* a = q b + r with deg r < deg b; q or r may be NULL. Long division that clears
+   the leading term of the remainder with one shifted word-wise xor of b. */
+void gf2x_divrem(gf2x_t q, gf2x_t r, const gf2x_t a, const gf2x_t b)
+{
+    slong db = gf2x_degree(b);
+    if (db < 0) {
+        fprintf(stderr, "gf2x_divrem: division by zero\n");
+        exit(EXIT_FAILURE);
+    }
+
+    gf2x_t rem, quot;
+    gf2x_init(rem);
+    gf2x_init(quot);
+    gf2x_set(rem, a);
+    gf2x_fit_length(rem, rem->length + 1);
+
+    slong dr = gf2x_degree(rem);
+    if (dr >= db) gf2x_fit_length(quot, (dr - db) / 64 + 1);
+
+    while (dr >= db) {
+        slong shift = dr - db;
+        add_shifted(rem->coeffs, b->coeffs, b->length, shift);
+        quot->coeffs[shift / 64] |= 1ull << (shift % 64);
+        if (shift / 64 + 1 > quot->length) quot->length = shift / 64 + 1;
+
+        // next leading term
+        slong w = dr / 64;
+        while (w >= 0 && rem->coeffs[w] == 0) --w;
+        dr = w < 0 ? -1 : w * 64 + 63 - __builtin_clzll(rem->coeffs[w]);
+    }
+    rem->length = dr < 0 ? 0 : dr / 64 + 1;
+
+    if (q) gf2x_swap(q, quot);
+    if (r) gf2x_swap(r, rem);
+    gf2x_clear(quot);
+    gf2x_clear(rem);
+}
+
+void gf2x_rem(gf2x_t r, const gf2x_t a, const gf2x_t b)
+{
+    gf2x_divrem(NULL, r, a, b);
+}
+
+void gf2x_gcd(gf2x_t g, const gf2x_t a, const gf2x_t b)
+{
+    gf2x_t x, y;
+    gf2x_init(x);
+    gf2x_init(y);
+    gf2x_set(x, a);
+    gf2x_set(y, b);
+
+    while (y->length) {
+        gf2x_rem(x, x, y);
+        gf2x_swap(x, y);
+    }
+
+    gf2x_swap(g, x);
+    gf2x_clear(x);
+    gf2x_clear(y);
+}
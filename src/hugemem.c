@@ -0,0 +1,190 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <malloc.h>
+#include <sys/mman.h>
+#include "hugemem.h"
+
+static const char *backing_names[HUGEMEM_BACKINGS] = {"heap", "4k pages", "transparent huge pages", "hugetlb"};
+
+// Mapped blocks, looked up on free; there are only ever a handful
+typedef struct huge_block {
+    void *p;
+    size_t size, mapped;
+    hugemem_backing backing;
+    struct huge_block *next;
+} huge_block;
+
+static struct {
+    pthread_mutex_t lock;
+    huge_block *blocks;
+    hugemem_stats stats;
+    hugemem_mode mode;
+    bool mode_set;
+} hm = {PTHREAD_MUTEX_INITIALIZER};
+
+// Caller holds the lock
+static hugemem_mode current_mode(void)
+{
+    if (!hm.mode_set) {
+        const char *env = getenv("SIG_HUGEPAGES");
+        hm.mode = HUGEMEM_AUTO;
+        if (env && strcmp(env, "thp") == 0) hm.mode = HUGEMEM_THP;
+        else if (env && strcmp(env, "off") == 0) hm.mode = HUGEMEM_OFF;
+        hm.mode_set = true;
+    }
+    return hm.mode;
+}
+
+void hugemem_set_mode(hugemem_mode mode)
+{
+    pthread_mutex_lock(&hm.lock);
+    hm.mode = mode;
+    hm.mode_set = true;
+    pthread_mutex_unlock(&hm.lock);
+}
+
+// Caller holds the lock
+static void account(hugemem_backing backing, size_t size, size_t mapped, bool add)
+{
+    hugemem_stats *s = &hm.stats;
+    if (add) {
+        s->bytes[backing] += size;
+        s->mapped[backing] += mapped;
+        ++s->allocs[backing];
+        size_t total = 0;
+        for (int i = 0; i < HUGEMEM_BACKINGS; ++i) total += s->bytes[i];
+        if (total > s->peak) s->peak = total;
+    } else {
+        s->bytes[backing] -= size;
+        s->mapped[backing] -= mapped;
+    }
+}
+
+// len is a multiple of HUGEMEM_PAGE; the over-mapped ends are trimmed to align the block
+static void *map_aligned(size_t len)
+{
+    unsigned char *raw = mmap(NULL, len + HUGEMEM_PAGE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) return NULL;
+    unsigned char *p = (unsigned char *) (((uintptr_t) raw + HUGEMEM_PAGE - 1) & ~(uintptr_t) (HUGEMEM_PAGE - 1));
+    if (p > raw) munmap(raw, p - raw);
+    size_t tail = (raw + len + HUGEMEM_PAGE) - (p + len);
+    if (tail) munmap(p + len, tail);
+    return p;
+}
+
+static void *map_block(size_t len, hugemem_mode mode, hugemem_backing *backing)
+{
+#ifdef MAP_HUGETLB
+    if (mode == HUGEMEM_AUTO) {
+        void *p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED) {
+            *backing = HUGEMEM_HUGETLB_PAGES;
+            return p;
+        }
+    }
+#endif
+    void *p = map_aligned(len);
+    if (!p) return NULL;
+    *backing = HUGEMEM_SMALL_PAGES;
+#ifdef MADV_HUGEPAGE
+    if (mode != HUGEMEM_OFF) {
+        if (madvise(p, len, MADV_HUGEPAGE) == 0) *backing = HUGEMEM_THP_PAGES;
+    } else {
+        madvise(p, len, MADV_NOHUGEPAGE);
+    }
+#endif
+    return p;
+}
+
+void *hugemem_alloc(size_t size)
+{
+    if (size < HUGEMEM_THRESHOLD) {
+        size_t alloc = (size + HUGEMEM_ALIGN - 1) & ~(size_t) (HUGEMEM_ALIGN - 1);
+        void *p = aligned_alloc(HUGEMEM_ALIGN, alloc ? alloc : HUGEMEM_ALIGN);
+        if (!p) return NULL;
+        memset(p, 0, size);
+        pthread_mutex_lock(&hm.lock);
+        size_t usable = malloc_usable_size(p);
+        account(HUGEMEM_HEAP, usable, usable, true);
+        pthread_mutex_unlock(&hm.lock);
+        return p;
+    }
+
+    huge_block *b = malloc(sizeof(huge_block));
+    if (!b) return NULL;
+    b->size = size;
+    b->mapped = (size + HUGEMEM_PAGE - 1) & ~(HUGEMEM_PAGE - 1);
+
+    pthread_mutex_lock(&hm.lock);
+    hugemem_mode mode = current_mode();
+    pthread_mutex_unlock(&hm.lock);
+
+    b->p = map_block(b->mapped, mode, &b->backing);
+    if (!b->p) {
+        free(b);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&hm.lock);
+    b->next = hm.blocks;
+    hm.blocks = b;
+    account(b->backing, b->size, b->mapped, true);
+    pthread_mutex_unlock(&hm.lock);
+    return b->p;
+}
+
+void hugemem_free(void *p)
+{
+    if (!p) return;
+
+    pthread_mutex_lock(&hm.lock);
+    huge_block **link = &hm.blocks;
+    while (*link && (*link)->p != p) link = &(*link)->next;
+    huge_block *b = *link;
+    if (b) {
+        *link = b->next;
+        account(b->backing, b->size, b->mapped, false);
+    } else {
+        size_t usable = malloc_usable_size(p);
+        account(HUGEMEM_HEAP, usable, usable, false);
+    }
+    pthread_mutex_unlock(&hm.lock);
+
+    if (b) {
+        munmap(b->p, b->mapped);
+        free(b);
+    } else {
+        free(p);
+    }
+}
+
+void hugemem_advise(void *p, size_t len)
+{
+#ifdef MADV_HUGEPAGE
+    if (len < HUGEMEM_THRESHOLD) return;
+    pthread_mutex_lock(&hm.lock);
+    hugemem_mode mode = current_mode();
+    pthread_mutex_unlock(&hm.lock);
+    if (mode != HUGEMEM_OFF) madvise(p, len, MADV_HUGEPAGE);
+#endif
+}
+
+void hugemem_get_stats(hugemem_stats *stats)
+{
+    pthread_mutex_lock(&hm.lock);
+    *stats = hm.stats;
+    pthread_mutex_unlock(&hm.lock);
+}
+
+void hugemem_print_stats(FILE *fp)
+{
+    hugemem_stats s;
+    hugemem_get_stats(&s);
+    fprintf(fp, "\nMatrix memory (live bytes / mapped bytes / allocations):\n");
+    for (int i = 0; i < HUGEMEM_BACKINGS; ++i) {
+        fprintf(fp, "  %-24s %12zu %12zu %8lu\n", backing_names[i], s.bytes[i], s.mapped[i], s.allocs[i]);
+    }
+    fprintf(fp, "  %-24s %12zu\n", "peak", s.peak);
+}
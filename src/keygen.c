@@ -2,12 +2,29 @@
 #include <sodium.h>
 #include <math.h>
 #include <stdint.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include "keygen.h"
 #include "matrix.h"     
 #include "utils.h"
 #include "params.h"
 #include "constants.h"
 #include "bch.h"
+#include "rng.h"
+#include "parallel.h"
+#include "shmcache.h"
+#include "qcmat.h"
+#include "trace.h"
+#include "dump.h"
+#include "memacct.h"
+
+// Rows per worker below which splitting a matrix across threads is not worth it
+#define MIN_ROWS_PER_THREAD 16
+
+// Nonce randombytes_buf_deterministic uses, so seeded streams can be reproduced from any offset
+static const unsigned char seed_stream_nonce[crypto_stream_chacha20_ietf_NONCEBYTES] = {
+    'L', 'i', 'b', 's', 'o', 'd', 'i', 'u', 'm', 'D', 'R', 'G'
+};
 
 void generate_random_seed(unsigned char *seed) {
     randombytes_buf(seed, SEED_SIZE);
@@ -29,15 +46,21 @@ void create_generator_matrix(slong n, slong k, slong d, nmod_mat_t gen_matrix, F
     int m = log2(n + 1);
     int t = floor(d / 2);
 
-    uint8_t *gpoly; uint32_t gdeg; uint32_t k_out;
-    bch_genpoly(m, t, &gpoly, &gdeg);
-    uint8_t **M = bch_generator_matrix_bytes(gpoly, gdeg, n, &k_out);
+    gf2x_t gpoly;
+    gf2x_init(gpoly);
+    bch_genpoly_gf2x(m, t, gpoly);
+    slong k_out = n - gf2x_degree(gpoly);
 
+    gf2_mat_t M;
+    gf2_mat_init(M, k_out, n);
+    bch_generator_matrix(M, gpoly, n);
+
+    nmod_mat_clear(gen_matrix);
     nmod_mat_init(gen_matrix, k_out, n, MOD);
-    copy_matrix_to_nmod_mat(gen_matrix, M, k_out, n);
+    gf2_mat_get_nmod(gen_matrix, M);
 
-    free_matrix_bytes(M, k_out);
-    free(gpoly);
+    gf2_mat_clear(M);
+    gf2x_clear(gpoly);
 }
 
 // void generate_parity_check_matrix(slong n, slong k, slong d, nmod_mat_t H, FILE *output_file) {
@@ -48,91 +71,235 @@ void create_generator_matrix(slong n, slong k, slong d, nmod_mat_t gen_matrix, F
 //     flint_randclear(state);
 // }
 
-void generate_parity_check_matrix(slong n, slong k, slong d, nmod_mat_t H, FILE *output_file) {
-    size_t num_bytes = (n - k) * n + 1;
-    unsigned char *random_buffer = (unsigned char *) malloc(num_bytes);
-
-    if (random_buffer == NULL) {
-        fprintf(stderr, "Memory allocation failed for H\n");
+typedef struct {
+    nmod_mat_struct *matrix;
+    slong cols;
+    const unsigned char *seed;
+    gf2_mat_struct *packed;
+    _Atomic bool failed;        /* a worker could not allocate its row buffer */
+} row_fill_ctx;
+
+/* Runs body over [0, rows) with a buf_bytes row buffer per chunk. The buffers are
+   charged here, on the calling thread, and a worker that cannot allocate its
+   buffer only flags the failure, so no worker exits the process mid-fill. */
+static void fill_rows(size_t rows, size_t buf_bytes, parallel_body body, row_fill_ctx *ctx, const char *what) {
+    size_t bytes = parallel_num_chunks(rows, MIN_ROWS_PER_THREAD) * buf_bytes;
+    if (!memacct_charge(MEM_SEEDS, bytes, what)) exit(EXIT_FAILURE);
+    parallel_for(rows, MIN_ROWS_PER_THREAD, body, ctx);
+    memacct_release(MEM_SEEDS, bytes);
+    if (atomic_load(&ctx->failed)) {
+        fprintf(stderr, "Failed to allocate %s\n", what);
         exit(EXIT_FAILURE);
     }
+}
 
-    randombytes_buf(random_buffer, num_bytes);
-
-    unsigned char *current_byte = random_buffer;
-    size_t bit_pos = 0;
-
-    for (slong i = 0; i < n - k; i++) {
-        for (slong j = 0; j < n; j++) {
-            unsigned int random_bit = (*current_byte >> (7 - bit_pos)) & 1;
-            nmod_mat_set_entry(H, i, j, random_bit);
-            bit_pos++;
+static void random_rows(void *arg, size_t begin, size_t end) {
+    row_fill_ctx *ctx = (row_fill_ctx *) arg;
+    size_t num_bytes = (ctx->cols + 7) / 8;
+    unsigned char *random_buffer = malloc(num_bytes);
+    if (random_buffer == NULL) {
+        atomic_store(&ctx->failed, true);
+        return;
+    }
 
-            if (bit_pos == 8) {
-                bit_pos = 0;
-                current_byte++;
-            }
+    for (size_t i = begin; i < end; i++) {
+        rng_bytes(random_buffer, num_bytes);
+        for (slong j = 0; j < ctx->cols; j++) {
+            unsigned int random_bit = (random_buffer[j / 8] >> (7 - j % 8)) & 1;
+            nmod_mat_set_entry(ctx->matrix, i, j, random_bit);
         }
     }
 
     free(random_buffer);
 }
 
-void create_generator_matrix_from_seed(slong n, slong k, slong d,
-                                       nmod_mat_t gen_matrix,
-                                       const unsigned char *seed,
-                                       FILE *output_file) {
+void generate_parity_check_matrix(slong n, slong k, slong d, nmod_mat_t H, FILE *output_file) {
+    row_fill_ctx ctx = {H, n, NULL, NULL};
+    fill_rows(n - k, (n + 7) / 8, random_rows, &ctx, "random row buffers");
+}
 
-    size_t num_entries = k * n;
-    size_t total_bytes = num_entries * sizeof(uint32_t);
-    unsigned char *stream = malloc(total_bytes);
+/* Writes bytes [offset, offset + len) of the stream randombytes_buf_deterministic(seed)
+   produces, by starting ChaCha20 at the block containing offset */
+static void seed_stream_at(unsigned char *out, size_t offset, size_t len, const unsigned char *seed) {
+    uint32_t block = (uint32_t) (offset / 64);
+    size_t skip = offset % 64;
+
+    if (skip) {
+        unsigned char first[64] = {0};
+        crypto_stream_chacha20_ietf_xor_ic(first, first, sizeof(first), seed_stream_nonce, block, seed);
+        size_t take = (64 - skip < len) ? 64 - skip : len;
+        memcpy(out, first + skip, take);
+        out += take;
+        len -= take;
+        ++block;
+    }
+
+    if (len) {
+        memset(out, 0, len);
+        crypto_stream_chacha20_ietf_xor_ic(out, out, len, seed_stream_nonce, block, seed);
+    }
+}
+
+// Each entry is its own 32-bit little endian word of the seeded stream, reduced mod MOD
+static void seeded_rows(void *arg, size_t begin, size_t end) {
+    row_fill_ctx *ctx = (row_fill_ctx *) arg;
+    size_t row_bytes = ctx->cols * sizeof(uint32_t);
+    unsigned char *stream = malloc(row_bytes);
     if (!stream) {
-        fprintf(stderr, "Failed to allocate stream buffer\n");
+        atomic_store(&ctx->failed, true);
         return;
     }
 
-    // this uses ChaCha20 under the hood
-    randombytes_buf_deterministic(stream, total_bytes, seed);
-
-    for (slong i = 0; i < k; ++i) {
-        for (slong j = 0; j < n; ++j) {
-            size_t idx = (i * n + j) * sizeof(uint32_t);
+    for (size_t i = begin; i < end; ++i) {
+        seed_stream_at(stream, i * row_bytes, row_bytes, ctx->seed);
+        for (slong j = 0; j < ctx->cols; ++j) {
+            size_t idx = j * sizeof(uint32_t);
             uint32_t value = 0;
             for (int b = 0; b < 4; ++b) {
                 value |= ((uint32_t)stream[idx + b]) << (8 * b);
             }
-            nmod_mat_set_entry(gen_matrix, i, j, value % MOD);
+            nmod_mat_set_entry(ctx->matrix, i, j, value % MOD);
         }
     }
 
     free(stream);
 }
 
+void create_generator_matrix_from_seed(slong n, slong k, slong d,
+                                       nmod_mat_t gen_matrix,
+                                       const unsigned char *seed,
+                                       FILE *output_file) {
+    row_fill_ctx ctx = {gen_matrix, n, seed, NULL};
+    fill_rows(k, n * sizeof(uint32_t), seeded_rows, &ctx, "seed stream buffers");
+}
+
 void generate_parity_check_matrix_from_seed(slong n, slong k, slong d, nmod_mat_t H, 
                                            const unsigned char *seed, FILE *output_file) {
+    row_fill_ctx ctx = {H, n, seed, NULL};
+    fill_rows(n - k, n * sizeof(uint32_t), seeded_rows, &ctx, "seed stream buffers");
+}
 
-    size_t num_entries = (n - k) * n;
-    size_t total_bytes = num_entries * sizeof(uint32_t);
-    unsigned char *stream = malloc(total_bytes);
+static void seeded_rows_packed(void *arg, size_t begin, size_t end) {
+    row_fill_ctx *ctx = (row_fill_ctx *) arg;
+    size_t row_bytes = ctx->cols * sizeof(uint32_t);
+    unsigned char *stream = malloc(row_bytes);
     if (!stream) {
-        fprintf(stderr, "Failed to allocate stream buffer\n");
+        atomic_store(&ctx->failed, true);
         return;
     }
 
-    randombytes_buf_deterministic(stream, total_bytes, seed);
+    for (size_t i = begin; i < end; ++i) {
+        seed_stream_at(stream, i * row_bytes, row_bytes, ctx->seed);
+        uint64_t *row = gf2_mat_row(ctx->packed, i);
+        for (slong j = 0; j < ctx->cols; ++j) {
+            // value % 2 of the little endian word only depends on its first byte
+            row[j / 64] |= (uint64_t) (stream[j * sizeof(uint32_t)] & 1) << (j % 64);
+        }
+    }
+
+    free(stream);
+}
 
-    for (slong i = 0; i < n - k; ++i) {
-        for (slong j = 0; j < n; ++j) {
-            size_t idx = (i * n + j) * sizeof(uint32_t);
-            uint32_t value = 0;
-            for (int b = 0; b < 4; ++b) {
-                value |= ((uint32_t)stream[idx + b]) << (8 * b);
-            }
-            nmod_mat_set_entry(H, i, j, value % MOD);
+// Same matrix as generate_parity_check_matrix_from_seed, expanded straight into packed rows
+void generate_parity_check_matrix_packed_from_seed(slong n, slong k, gf2_mat_t H,
+                                                   const unsigned char *seed) {
+    row_fill_ctx ctx = {NULL, n, seed, H};
+    gf2_mat_zero(H);
+    fill_rows(n - k, n * sizeof(uint32_t), seeded_rows_packed, &ctx, "seed stream buffers");
+}
+
+// Same matrix as create_generator_matrix_from_seed, packed; G must be k x n
+void create_generator_matrix_packed_from_seed(slong n, slong k, gf2_mat_t G,
+                                              const unsigned char *seed) {
+    row_fill_ctx ctx = {NULL, n, seed, G};
+    gf2_mat_zero(G);
+    fill_rows(k, n * sizeof(uint32_t), seeded_rows_packed, &ctx, "seed stream buffers");
+}
+
+/* Quasi-cyclic H_A: block j's first column h_j(x) is r = n - k bits of the seeded
+   stream starting at byte j * 8 * GF2_WORDS(r), read as little endian words */
+void generate_parity_check_qc_from_seed(slong n, slong k, qc_mat_t H, const unsigned char *seed) {
+    slong r = n - k;
+    size_t row_bytes = H->h.words * sizeof(uint64_t);
+    unsigned char *stream = memacct_charge(MEM_SEEDS, row_bytes, "seed stream buffer") ? malloc(row_bytes) : NULL;
+    if (!stream) {
+        fprintf(stderr, "Failed to allocate stream buffer\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (slong j = 0; j < H->blocks; ++j) {
+        seed_stream_at(stream, j * row_bytes, row_bytes, seed);
+        uint64_t *row = gf2_mat_row(&H->h, j);
+        for (slong w = 0; w < H->h.words; ++w) {
+            uint64_t value = 0;
+            for (int b = 0; b < 8; ++b) value |= (uint64_t) stream[w * 8 + b] << (8 * b);
+            row[w] = value;
         }
+        if (r % 64) row[H->h.words - 1] &= (UINT64_C(1) << (r % 64)) - 1;
     }
 
     free(stream);
+    memacct_release(MEM_SEEDS, row_bytes);
+}
+
+/* Seed and expansion of the quasi-cyclic H_A. It is O(n) bits, so unlike the dense
+   H_A it is expanded privately rather than through the shared-memory cache. */
+bool load_parity_check_qc(const struct code *C_A, bool create, qc_mat_t H, unsigned char *seed) {
+    if (create) {
+        if (!get_or_generate_seed("HQ", C_A->n, C_A->k, C_A->d, false, seed)) return false;
+    } else {
+        char *seed_filename = generate_seed_filename("HQ", C_A->n, C_A->k, C_A->d);
+        bool have_seed = seed_filename && load_seed(seed_filename, seed);
+        free(seed_filename);
+        if (!have_seed) return false;
+    }
+
+    qc_mat_init(H, C_A->n - C_A->k, C_A->n);
+    generate_parity_check_qc_from_seed(C_A->n, C_A->k, H, seed);
+    return true;
+}
+
+/* Loads the cached seed for (prefix, n, k, d), or creates and caches a new one when
+   none exists or regenerate is set. A replaced seed's shared-memory expansion is
+   invalidated so other processes stop using it. */
+bool get_or_generate_seed(const char* prefix, int n, int k, int d, bool regenerate, unsigned char *seed) {
+    char* seed_filename = generate_seed_filename(prefix, n, k, d);
+    if (seed_filename == NULL) {
+        fprintf(stderr, "Failed to generate seed filename\n");
+        return false;
+    }
+
+    if (!regenerate && load_seed(seed_filename, seed)) {
+        free(seed_filename);
+        return true;
+    }
+
+    // Only one process creates the seed; others block here and then load what it saved
+    int lock = lock_cache_entry(seed_filename);
+    bool have_seed = load_seed(seed_filename, seed);
+    if (!have_seed || regenerate) {
+        if (have_seed) shmcache_invalidate(prefix, n, k, d, seed);
+        generate_random_seed(seed);
+        if (!save_seed(seed_filename, seed)) {
+            fprintf(stderr, "Failed to save seed to %s\n", seed_filename);
+        }
+    }
+    unlock_cache_entry(lock);
+
+    free(seed_filename);
+    return true;
+}
+
+static void expand_parity_check(void *arg, gf2_mat_t H) {
+    const unsigned char *seed = (const unsigned char *) arg;
+    generate_parity_check_matrix_packed_from_seed(H->c, H->c - H->r, H, seed);
+}
+
+/* Packed H_A for the given seed, mapped from the cross-process cache when another
+   process already expanded it. Release with shmcache_release. */
+void acquire_parity_check_matrix(const struct code *C_A, const unsigned char *seed, shmcache_handle *handle) {
+    shmcache_acquire("H", C_A->n, C_A->k, C_A->d, seed, C_A->n - C_A->k, C_A->n,
+                     expand_parity_check, (void *) seed, handle);
 }
 
 void get_or_generate_matrix_with_seed(const char* prefix, int n, int k, int d, nmod_mat_t matrix,
@@ -141,24 +308,11 @@ void get_or_generate_matrix_with_seed(const char* prefix, int n, int k, int d, n
                                      FILE* output_file, bool regenerate, bool use_seed_mode, 
                                      unsigned char *seed_out) {
     if (use_seed_mode) {
-        char* seed_filename = generate_seed_filename(prefix, n, k, d);
-        if (seed_filename == NULL) {
-            fprintf(stderr, "Failed to generate seed filename\n");
-            return;
-        }
-
         unsigned char seed[SEED_SIZE];
-        
-        if (!regenerate && load_seed(seed_filename, seed)) {
-            generate_from_seed_func(n, k, d, matrix, seed, output_file);
-            if (seed_out) memcpy(seed_out, seed, SEED_SIZE);
-        } else {
-            generate_random_seed(seed);
-            save_seed(seed_filename, seed);
-            generate_from_seed_func(n, k, d, matrix, seed, output_file);
-            if (seed_out) memcpy(seed_out, seed, SEED_SIZE);
-        }
-        free(seed_filename);
+        if (!get_or_generate_seed(prefix, n, k, d, regenerate, seed)) return;
+
+        generate_from_seed_func(n, k, d, matrix, seed, output_file);
+        if (seed_out) memcpy(seed_out, seed, SEED_SIZE);
     } else {
         char* filename = generate_matrix_filename(prefix, n, k, d);
         if (filename == NULL) {
@@ -169,31 +323,100 @@ void get_or_generate_matrix_with_seed(const char* prefix, int n, int k, int d, n
         if (!regenerate && load_matrix(filename, matrix)) {
             // matrix loaded
         } else {
-            generate_func(n, k, d, matrix, output_file);
-            save_matrix(filename, matrix);
+            // Re-check under the lock: another process may have generated it meanwhile
+            int lock = lock_cache_entry(filename);
+            if (regenerate || !load_matrix(filename, matrix)) {
+                generate_func(n, k, d, matrix, output_file);
+                save_matrix(filename, matrix);
+            }
+            unlock_cache_entry(lock);
         }
         free(filename);
     }
 }
 
+typedef struct {
+    const char *prefix;
+    const struct code *C;
+    nmod_mat_struct *matrix;
+    void (*generate_func)(slong, slong, slong, nmod_mat_t, FILE*);
+    void (*generate_from_seed_func)(slong, slong, slong, nmod_mat_t, const unsigned char*, FILE*);
+    FILE *output_file;
+    bool regenerate, use_seed_mode;
+    unsigned char *seed_out;
+    uint64_t perf[PERF_NUM_COUNTERS];   /* counted on the job's own thread, credited on join */
+} keygen_job;
+
+static void *keygen_job_run(void *arg) {
+    keygen_job *job = (keygen_job *) arg;
+    trace_mark t = trace_begin();
+    get_or_generate_matrix_with_seed(job->prefix, job->C->n, job->C->k, job->C->d, job->matrix,
+                                     job->generate_func, job->generate_from_seed_func,
+                                     job->output_file, job->regenerate, job->use_seed_mode, job->seed_out);
+    trace_end_bits(job->prefix[0] == 'H' ? "keygen.H_A" : "keygen.G", t,
+                   (uint64_t) nmod_mat_nrows(job->matrix) * nmod_mat_ncols(job->matrix));
+    return NULL;
+}
+
+static void *keygen_job_thread(void *arg) {
+    keygen_job *job = (keygen_job *) arg;
+    uint64_t start[PERF_NUM_COUNTERS];
+    bool counted = perf_available() && perf_read(start);
+    keygen_job_run(job);
+    if (counted) perf_since(start, job->perf);
+    return NULL;
+}
+
+/* H_A, G1 and G2 are independent, so each is generated (and written to its cache file)
+   on its own thread; H_A is further split across workers inside its generate function.
+   G1 and G2 share a cache entry when their parameters match, so G2 is copied from G1
+   instead of racing on the same file. The G threads' hardware counts are credited
+   to the caller on join, as parallel_for does for its workers. */
 void generate_keys(struct code* C_A, struct code* C1, struct code* C2,
                    nmod_mat_t H_A, nmod_mat_t G1, nmod_mat_t G2,
                    bool use_seed_mode, bool regenerate, FILE* output_file,
                    unsigned char* h_a_seed, unsigned char* g1_seed, unsigned char* g2_seed)
 {
-    get_or_generate_matrix_with_seed("H", C_A->n, C_A->k, C_A->d, H_A, 
-                                     generate_parity_check_matrix, generate_parity_check_matrix_from_seed,
-                                     output_file, regenerate, use_seed_mode, h_a_seed);
-
-    get_or_generate_matrix_with_seed("G", C1->n, C1->k, C1->d, G1, 
-                                     create_generator_matrix, create_generator_matrix_from_seed,
-                                     output_file, regenerate, use_seed_mode, g1_seed);
+    bool shared_g = C1->n == C2->n && C1->k == C2->k && C1->d == C2->d;
+
+    keygen_job jobs[3] = {
+        {"H", C_A, H_A, generate_parity_check_matrix, generate_parity_check_matrix_from_seed,
+         output_file, regenerate, use_seed_mode, h_a_seed},
+        {"G", C1, G1, create_generator_matrix, create_generator_matrix_from_seed,
+         output_file, regenerate, use_seed_mode, g1_seed},
+        {"G", C2, G2, create_generator_matrix, create_generator_matrix_from_seed,
+         output_file, regenerate, use_seed_mode, g2_seed},
+    };
+    int num_jobs = shared_g ? 2 : 3;
+
+    pthread_t threads[3];
+    bool started[3] = {false};
+    for (int i = 1; i < num_jobs; ++i) {
+        for (int k = 0; k < PERF_NUM_COUNTERS; ++k) jobs[i].perf[k] = PERF_UNAVAILABLE;
+        started[i] = pthread_create(&threads[i], NULL, keygen_job_thread, &jobs[i]) == 0;
+        if (!started[i]) keygen_job_run(&jobs[i]);
+    }
+    if (C_A->quasi_cyclic) {
+        // Only the seed is kept; the circulant blocks are expanded from it where they are used
+        trace_mark t = trace_begin();
+        get_or_generate_seed("HQ", C_A->n, C_A->k, C_A->d, regenerate, h_a_seed);
+        trace_end("keygen.H_A_seed", t);
+    } else {
+        keygen_job_run(&jobs[0]);
+    }
+    for (int i = 1; i < num_jobs; ++i) {
+        if (!started[i]) continue;
+        pthread_join(threads[i], NULL);
+        perf_credit(jobs[i].perf);
+    }
 
-    get_or_generate_matrix_with_seed("G", C2->n, C2->k, C2->d, G2, 
-                                     create_generator_matrix, create_generator_matrix_from_seed,
-                                     output_file, regenerate, use_seed_mode, g2_seed);
+    if (shared_g) {
+        nmod_mat_clear(G2);
+        nmod_mat_init_set(G2, G1);
+        if (use_seed_mode) memcpy(g2_seed, g1_seed, SEED_SIZE);
+    }
 
-    if (use_seed_mode && PRINT) {
+    if ((use_seed_mode || C_A->quasi_cyclic) && dump_enabled(DUMP_SUMMARY)) {
         fprintf(output_file, "\nUsing seed-based key generation\n");
         fprintf(output_file, "H_A seed: ");
         for (int i = 0; i < SEED_SIZE; i++) fprintf(output_file, "%02x", h_a_seed[i]);
@@ -204,9 +427,18 @@ void generate_keys(struct code* C_A, struct code* C1, struct code* C2,
         fprintf(output_file, "\n");
     }
 
-    if (PRINT) {
-        fprintf(output_file, "\nParity check matrix, H_A:\n\n");
-        print_matrix(output_file, H_A);
+    if (dump_enabled(DUMP_MATRICES)) {
+        if (C_A->quasi_cyclic) {
+            qc_mat_t H;
+            qc_mat_init(H, C_A->n - C_A->k, C_A->n);
+            generate_parity_check_qc_from_seed(C_A->n, C_A->k, H, h_a_seed);
+            fprintf(output_file, "\nQuasi-cyclic parity check matrix, H_A (first column of each circulant block):\n\n");
+            gf2_mat_print(output_file, &H->h);
+            qc_mat_clear(H);
+        } else {
+            fprintf(output_file, "\nParity check matrix, H_A:\n\n");
+            print_matrix(output_file, H_A);
+        }
         fprintf(output_file, "\nGenerator matrix, G1:\n\n");
         print_matrix(output_file, G1);
         fprintf(output_file, "\nGenerator matrix, G2:\n\n");
@@ -0,0 +1,404 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sodium.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "keystore.h"
+#include "trace.h"
+
+#define KEYSTORE_INDEX_MAGIC "SIGKSI1"
+#define KEYSTORE_RECORD_MAGIC "SKR1"
+#define KEYSTORE_INITIAL_CAPACITY 1024
+
+typedef struct {
+    char magic[8];
+    uint64_t capacity;              /* slots, a power of two */
+    _Atomic uint64_t count;
+    uint64_t reserved[5];
+} index_header;
+
+typedef struct {
+    unsigned char id[KEYSTORE_ID_SIZE];
+    _Atomic uint64_t record;        /* record number + 1, 0 while the slot is empty; stored last */
+} index_slot;
+
+typedef struct {
+    char magic[4];
+    uint32_t flags;                 /* bit 0: quasi-cyclic H_A */
+    uint64_t created;               /* seconds since the epoch */
+    uint32_t n[3], k[3], d[3];      /* C_A, C1, C2 */
+    unsigned char id[KEYSTORE_ID_SIZE];
+    unsigned char seed[3][SEED_SIZE];   /* H_A, G1, G2 */
+    char name[KEYSTORE_NAME_SIZE];
+    unsigned char reserved[12];
+} key_record;
+
+_Static_assert(sizeof(index_header) == 64, "index_header must stay 64 bytes");
+_Static_assert(sizeof(index_slot) == 40, "index_slot must stay 40 bytes");
+_Static_assert(sizeof(key_record) == 256, "key_record must stay 256 bytes");
+
+struct keystore {
+    pthread_mutex_t lock;
+    char dir[MAX_FILENAME_LENGTH - 16];     // room for "/index.tmp"
+    bool writable;
+    int lock_fd;                    /* writers only */
+    int keys_fd;
+    index_header *index;
+    size_t index_len;
+    ino_t index_ino;
+    const key_record *keys;
+    size_t keys_len;
+    unsigned long remaps;
+};
+
+static void path_of(const keystore *ks, const char *file, char path[MAX_FILENAME_LENGTH])
+{
+    snprintf(path, MAX_FILENAME_LENGTH, "%s/%s", ks->dir, file);
+}
+
+static index_slot *slots_of(index_header *h)
+{
+    return (index_slot *) (h + 1);
+}
+
+/* The slot holding id, or the empty slot where it would go (*found false), or
+   NULL if the table is full. A slot whose record is not yet published reads as
+   empty, so a concurrent insert is simply not seen yet. */
+static index_slot *find_slot(index_header *h, const unsigned char *id, bool *found)
+{
+    uint64_t start, mask = h->capacity - 1;
+    memcpy(&start, id, sizeof(start));
+    *found = false;
+
+    for (uint64_t i = 0; i < h->capacity; ++i) {
+        index_slot *s = &slots_of(h)[(start + i) & mask];
+        if (!atomic_load_explicit(&s->record, memory_order_acquire)) return s;
+        if (memcmp(s->id, id, KEYSTORE_ID_SIZE) == 0) {
+            *found = true;
+            return s;
+        }
+    }
+    return NULL;
+}
+
+// Maps the index file afresh, dropping the old mapping once the new one checks out
+static bool map_index(keystore *ks)
+{
+    char path[MAX_FILENAME_LENGTH];
+    path_of(ks, "index", path);
+    int fd = open(path, ks->writable ? O_RDWR : O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(index_header)) {
+        close(fd);
+        return false;
+    }
+    int prot = PROT_READ | (ks->writable ? PROT_WRITE : 0);
+    index_header *h = mmap(NULL, st.st_size, prot, MAP_SHARED, fd, 0);
+    close(fd);
+    if (h == MAP_FAILED) return false;
+
+    bool ok = memcmp(h->magic, KEYSTORE_INDEX_MAGIC, sizeof(h->magic)) == 0 &&
+              h->capacity && !(h->capacity & (h->capacity - 1)) &&
+              (size_t) st.st_size == sizeof(index_header) + h->capacity * sizeof(index_slot);
+    if (!ok) {
+        munmap(h, st.st_size);
+        return false;
+    }
+
+    if (ks->index) munmap(ks->index, ks->index_len);
+    ks->index = h;
+    ks->index_len = st.st_size;
+    ks->index_ino = st.st_ino;
+    trace_add("io.bytes_read", st.st_size);
+    return true;
+}
+
+// True if a writer has renamed a larger index over the one mapped
+static bool index_replaced(const keystore *ks)
+{
+    char path[MAX_FILENAME_LENGTH];
+    path_of(ks, "index", path);
+    struct stat st;
+    return stat(path, &st) == 0 && st.st_ino != ks->index_ino;
+}
+
+static bool map_keys(keystore *ks)
+{
+    struct stat st;
+    if (fstat(ks->keys_fd, &st) != 0) return false;
+    size_t len = (size_t) st.st_size / sizeof(key_record) * sizeof(key_record);
+    if (len == ks->keys_len) return true;
+
+    void *map = len ? mmap(NULL, len, PROT_READ, MAP_SHARED, ks->keys_fd, 0) : NULL;
+    if (map == MAP_FAILED) return false;
+    if (ks->keys) munmap((void *) ks->keys, ks->keys_len);
+    ks->keys = map;
+    ks->keys_len = len;
+    return true;
+}
+
+/* Writes an index of the given capacity holding every published slot of the
+   current one, then renames it into place. The caller holds the writer lock. */
+static bool build_index(keystore *ks, uint64_t capacity)
+{
+    char path[MAX_FILENAME_LENGTH], tmp_path[MAX_FILENAME_LENGTH];
+    path_of(ks, "index", path);
+    path_of(ks, "index.tmp", tmp_path);
+
+    size_t len = sizeof(index_header) + capacity * sizeof(index_slot);
+    int fd = open(tmp_path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) return false;
+    index_header *h = ftruncate(fd, len) == 0 ? mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)
+                                              : MAP_FAILED;
+    if (h == MAP_FAILED) {
+        close(fd);
+        unlink(tmp_path);
+        return false;
+    }
+
+    memcpy(h->magic, KEYSTORE_INDEX_MAGIC, sizeof(h->magic));
+    h->capacity = capacity;
+    uint64_t count = 0;
+    if (ks->index) {
+        for (uint64_t i = 0; i < ks->index->capacity; ++i) {
+            index_slot *old = &slots_of(ks->index)[i];
+            uint64_t record = atomic_load_explicit(&old->record, memory_order_acquire);
+            if (!record) continue;
+            bool found;
+            index_slot *s = find_slot(h, old->id, &found);
+            memcpy(s->id, old->id, KEYSTORE_ID_SIZE);
+            atomic_store_explicit(&s->record, record, memory_order_relaxed);
+            ++count;
+        }
+    }
+    atomic_store(&h->count, count);
+
+    bool ok = msync(h, len, MS_SYNC) == 0 && fsync(fd) == 0;
+    munmap(h, len);
+    close(fd);
+    ok = ok && rename(tmp_path, path) == 0;
+    if (!ok) unlink(tmp_path);
+    else trace_add("io.bytes_written", len);
+    return ok;
+}
+
+keystore *keystore_open(const char *dir, bool writable)
+{
+    keystore *ks = calloc(1, sizeof(keystore));
+    if (!ks) return NULL;
+    pthread_mutex_init(&ks->lock, NULL);
+    snprintf(ks->dir, sizeof(ks->dir), "%s", dir);
+    ks->writable = writable;
+    ks->lock_fd = ks->keys_fd = -1;
+
+    char path[MAX_FILENAME_LENGTH];
+    bool ok = true;
+    if (writable) {
+        mkdir(dir, 0700);
+        path_of(ks, "lock", path);
+        ks->lock_fd = open(path, O_RDWR | O_CREAT, 0600);
+        ok = ks->lock_fd >= 0 && flock(ks->lock_fd, LOCK_EX) == 0;
+        // A missing index is created; one that is there but unreadable is left alone
+        path_of(ks, "index", path);
+        if (ok && access(path, F_OK) != 0) ok = build_index(ks, KEYSTORE_INITIAL_CAPACITY);
+        if (ks->lock_fd >= 0) flock(ks->lock_fd, LOCK_UN);
+    }
+
+    path_of(ks, "keys", path);
+    if (ok) ks->keys_fd = writable ? open(path, O_RDWR | O_CREAT, 0600) : open(path, O_RDONLY);
+    ok = ok && ks->keys_fd >= 0 && (ks->index || map_index(ks)) && map_keys(ks);
+    if (!ok) {
+        fprintf(stderr, "Could not open key store in %s%s\n", dir, writable ? "" : " (run keystore add first)");
+        keystore_close(ks);
+        return NULL;
+    }
+    return ks;
+}
+
+void keystore_close(keystore *ks)
+{
+    if (!ks) return;
+    if (ks->index) munmap(ks->index, ks->index_len);
+    if (ks->keys) munmap((void *) ks->keys, ks->keys_len);
+    if (ks->keys_fd >= 0) close(ks->keys_fd);
+    if (ks->lock_fd >= 0) close(ks->lock_fd);
+    pthread_mutex_destroy(&ks->lock);
+    free(ks);
+}
+
+void keystore_key_id(const char *name, unsigned char id[KEYSTORE_ID_SIZE])
+{
+    crypto_hash_sha256(id, (const unsigned char *) name, strlen(name));
+}
+
+bool keystore_keyset_init(keystore_keyset *keys, const char *name, const struct code *C_A,
+                          const struct code *C1, const struct code *C2)
+{
+    if (!*name || strlen(name) >= KEYSTORE_NAME_SIZE) {
+        fprintf(stderr, "Key names must be 1 to %d bytes\n", KEYSTORE_NAME_SIZE - 1);
+        return false;
+    }
+    memset(keys, 0, sizeof(*keys));
+    strcpy(keys->name, name);
+    keys->C_A = *C_A;
+    keys->C1 = *C1;
+    keys->C2 = *C2;
+    randombytes_buf(keys->h_a_seed, SEED_SIZE);
+    randombytes_buf(keys->g1_seed, SEED_SIZE);
+    randombytes_buf(keys->g2_seed, SEED_SIZE);
+    return true;
+}
+
+static void pack_record(key_record *r, const keystore_keyset *keys, const unsigned char *id)
+{
+    const struct code *codes[3] = {&keys->C_A, &keys->C1, &keys->C2};
+    const unsigned char *seeds[3] = {keys->h_a_seed, keys->g1_seed, keys->g2_seed};
+
+    memset(r, 0, sizeof(*r));
+    memcpy(r->magic, KEYSTORE_RECORD_MAGIC, sizeof(r->magic));
+    r->flags = keys->C_A.quasi_cyclic ? 1 : 0;
+    r->created = (uint64_t) time(NULL);
+    for (int i = 0; i < 3; ++i) {
+        r->n[i] = (uint32_t) codes[i]->n;
+        r->k[i] = (uint32_t) codes[i]->k;
+        r->d[i] = (uint32_t) codes[i]->d;
+        memcpy(r->seed[i], seeds[i], SEED_SIZE);
+    }
+    memcpy(r->id, id, KEYSTORE_ID_SIZE);
+    memcpy(r->name, keys->name, KEYSTORE_NAME_SIZE);
+}
+
+static void unpack_record(keystore_keyset *keys, const key_record *r)
+{
+    struct code *codes[3] = {&keys->C_A, &keys->C1, &keys->C2};
+    unsigned char *seeds[3] = {keys->h_a_seed, keys->g1_seed, keys->g2_seed};
+
+    for (int i = 0; i < 3; ++i) {
+        *codes[i] = (struct code) {r->n[i], r->k[i], r->d[i], false};
+        memcpy(seeds[i], r->seed[i], SEED_SIZE);
+    }
+    keys->C_A.quasi_cyclic = r->flags & 1;
+    memcpy(keys->name, r->name, KEYSTORE_NAME_SIZE);
+    keys->name[KEYSTORE_NAME_SIZE - 1] = '\0';
+}
+
+bool keystore_add(keystore *ks, const keystore_keyset *keys)
+{
+    if (!ks->writable) return false;
+
+    unsigned char id[KEYSTORE_ID_SIZE];
+    keystore_key_id(keys->name, id);
+
+    pthread_mutex_lock(&ks->lock);
+    bool ok = false;
+    if (flock(ks->lock_fd, LOCK_EX) != 0) {
+        pthread_mutex_unlock(&ks->lock);
+        return false;
+    }
+
+    // Another writer may have grown the index since it was mapped
+    if (index_replaced(ks) && map_index(ks)) ks->remaps++;
+
+    bool found;
+    index_slot *s = find_slot(ks->index, id, &found);
+    if (found) {
+        fprintf(stderr, "Key %s is already in the key store\n", keys->name);
+        goto done;
+    }
+    uint64_t count = atomic_load(&ks->index->count);
+    if (!s || 4 * (count + 1) > 3 * ks->index->capacity) {
+        if (!build_index(ks, 2 * ks->index->capacity) || !map_index(ks)) goto done;
+        s = find_slot(ks->index, id, &found);
+    }
+
+    // A partial record left by a writer that died is overwritten
+    struct stat st;
+    if (fstat(ks->keys_fd, &st) != 0) goto done;
+    uint64_t record = (uint64_t) st.st_size / sizeof(key_record);
+    key_record r;
+    pack_record(&r, keys, id);
+    if (pwrite(ks->keys_fd, &r, sizeof(r), (off_t) (record * sizeof(key_record))) != sizeof(r) ||
+        fdatasync(ks->keys_fd) != 0) {
+        goto done;
+    }
+    trace_add("io.bytes_written", sizeof(r));
+
+    memcpy(s->id, id, KEYSTORE_ID_SIZE);
+    atomic_store_explicit(&s->record, record + 1, memory_order_release);
+    atomic_fetch_add(&ks->index->count, 1);
+    ok = true;
+
+done:
+    flock(ks->lock_fd, LOCK_UN);
+    pthread_mutex_unlock(&ks->lock);
+    if (!ok && !found) fprintf(stderr, "Could not add key %s to %s\n", keys->name, ks->dir);
+    return ok;
+}
+
+// Caller holds ks->lock
+static bool read_record(keystore *ks, uint64_t record, const unsigned char *id, keystore_keyset *keys)
+{
+    size_t end = (record + 1) * sizeof(key_record);
+    if (end > ks->keys_len) {
+        if (!map_keys(ks) || end > ks->keys_len) return false;
+        ks->remaps++;
+    }
+    const key_record *r = &ks->keys[record];
+    if (memcmp(r->magic, KEYSTORE_RECORD_MAGIC, sizeof(r->magic)) != 0 ||
+        memcmp(r->id, id, KEYSTORE_ID_SIZE) != 0) {
+        return false;
+    }
+    unpack_record(keys, r);
+    return true;
+}
+
+bool keystore_lookup(keystore *ks, const unsigned char id[KEYSTORE_ID_SIZE], keystore_keyset *keys)
+{
+    pthread_mutex_lock(&ks->lock);
+    bool found;
+    index_slot *s = find_slot(ks->index, id, &found);
+    if (!found && index_replaced(ks) && map_index(ks)) {
+        ks->remaps++;
+        s = find_slot(ks->index, id, &found);
+    }
+    bool ok = found && read_record(ks, atomic_load_explicit(&s->record, memory_order_acquire) - 1, id, keys);
+    pthread_mutex_unlock(&ks->lock);
+    return ok;
+}
+
+bool keystore_find(keystore *ks, const char *name, keystore_keyset *keys)
+{
+    unsigned char id[KEYSTORE_ID_SIZE];
+    keystore_key_id(name, id);
+    return keystore_lookup(ks, id, keys);
+}
+
+void keystore_get_stats(keystore *ks, keystore_stats *stats)
+{
+    pthread_mutex_lock(&ks->lock);
+    if (index_replaced(ks) && map_index(ks)) ks->remaps++;
+    map_keys(ks);
+    stats->count = atomic_load(&ks->index->count);
+    stats->capacity = ks->index->capacity;
+    stats->index_bytes = ks->index_len;
+    stats->keys_bytes = ks->keys_len;
+    stats->remaps = ks->remaps;
+    pthread_mutex_unlock(&ks->lock);
+}
+
+void keystore_print_stats(FILE *fp, keystore *ks)
+{
+    keystore_stats s;
+    keystore_get_stats(ks, &s);
+    fprintf(fp, "Key store %s: %zu keys in %zu slots (%.0f%% full), index %zu bytes, records %zu bytes, %lu remaps\n",
+            ks->dir, s.count, s.capacity, 100.0 * s.count / s.capacity, s.index_bytes, s.keys_bytes, s.remaps);
+}
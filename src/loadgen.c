@@ -0,0 +1,688 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/stat.h>
+#include "loadgen.h"
+#include "params.h"
+#include "constants.h"
+#include "rng.h"
+#include "utils.h"
+#include "gf2mat.h"
+#include "qcmat.h"
+#include "keygen.h"
+#include "signer.h"
+#include "verifier.h"
+#include "registry.h"
+#include "shmcache.h"
+#include "pkstore.h"
+#include "keystore.h"
+#include "dump.h"
+
+/* Log-linear histogram of nanosecond latencies: values below 2 * HIST_HALF
+   are exact, above that each power of two is split into HIST_HALF buckets,
+   so a recorded value is within 1 / HIST_HALF (1.6%) of the true one. */
+#define HIST_HALF 64
+#define HIST_MAX_SHIFT 34       // values up to 2^41 ns, about 36 minutes
+#define HIST_BUCKETS (2 * HIST_HALF + HIST_MAX_SHIFT * HIST_HALF)
+
+typedef struct {
+    uint64_t counts[HIST_BUCKETS];
+    uint64_t total, max;
+    double sum;
+} latency_hist;
+
+static int hist_index(uint64_t v)
+{
+    if (v < 2 * HIST_HALF) return (int) v;
+    int shift = 63 - __builtin_clzll(v) - 6;
+    if (shift > HIST_MAX_SHIFT) return HIST_BUCKETS - 1;
+    return 2 * HIST_HALF + (shift - 1) * HIST_HALF + (int) ((v >> shift) - HIST_HALF);
+}
+
+// Midpoint of a bucket
+static uint64_t hist_value(int idx)
+{
+    if (idx < 2 * HIST_HALF) return (uint64_t) idx;
+    int shift = (idx - 2 * HIST_HALF) / HIST_HALF + 1;
+    uint64_t low = (uint64_t) ((idx - 2 * HIST_HALF) % HIST_HALF + HIST_HALF) << shift;
+    return low + ((1ull << shift) >> 1);
+}
+
+static void hist_add(latency_hist *h, uint64_t v, uint64_t count)
+{
+    h->counts[hist_index(v)] += count;
+    h->total += count;
+    h->sum += (double) v * count;
+    if (v > h->max) h->max = v;
+}
+
+static void hist_merge(latency_hist *dst, const latency_hist *src)
+{
+    for (int i = 0; i < HIST_BUCKETS; ++i) dst->counts[i] += src->counts[i];
+    dst->total += src->total;
+    dst->sum += src->sum;
+    if (src->max > dst->max) dst->max = src->max;
+}
+
+/* Closed-loop coordinated-omission correction: a sample of v means the requests
+   due at v - interval, v - 2 interval, ... were never sent, so record them with
+   the latencies they would have seen */
+static void hist_correct(latency_hist *dst, const latency_hist *src, uint64_t interval)
+{
+    *dst = *src;
+    if (!interval) return;
+    for (int i = 0; i < HIST_BUCKETS; ++i) {
+        if (!src->counts[i]) continue;
+        uint64_t v = hist_value(i);
+        for (uint64_t missing = v > interval ? v - interval : 0; missing >= interval; missing -= interval) {
+            hist_add(dst, missing, src->counts[i]);
+        }
+    }
+}
+
+static uint64_t hist_percentile(const latency_hist *h, double p)
+{
+    if (!h->total) return 0;
+    uint64_t rank = (uint64_t) ceil(p / 100.0 * h->total);
+    if (rank < 1) rank = 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; ++i) {
+        seen += h->counts[i];
+        if (seen >= rank) return hist_value(i) < h->max ? hist_value(i) : h->max;
+    }
+    return h->max;
+}
+
+// Percentile distribution in HdrHistogram's .hgrm layout, values in microseconds
+static bool hist_write(const char *path, const latency_hist *h)
+{
+    FILE *out = fopen(path, "w");
+    if (!out) {
+        fprintf(stderr, "Could not open %s: %s\n", path, strerror(errno));
+        return false;
+    }
+    fprintf(out, "%12s %14s %10s %14s\n\n", "Value", "Percentile", "TotalCount", "1/(1-Percentile)");
+    uint64_t seen = 0;
+    double sq = 0, mean = h->total ? h->sum / h->total : 0;
+    for (int i = 0; i < HIST_BUCKETS; ++i) {
+        if (!h->counts[i]) continue;
+        seen += h->counts[i];
+        double v = hist_value(i) / 1e3, q = (double) seen / h->total;
+        sq += h->counts[i] * (v - mean / 1e3) * (v - mean / 1e3);
+        if (q < 1) fprintf(out, "%12.3f %14.12f %10llu %14.2f\n", v, q, (unsigned long long) seen, 1 / (1 - q));
+        else fprintf(out, "%12.3f %14.12f %10llu\n", v, q, (unsigned long long) seen);
+    }
+    fprintf(out, "#[Mean    = %12.3f, StdDeviation   = %12.3f]\n", mean / 1e3, h->total ? sqrt(sq / h->total) : 0);
+    fprintf(out, "#[Max     = %12.3f, Total count    = %12llu]\n", h->max / 1e3, (unsigned long long) h->total);
+    fprintf(out, "#[Buckets = %12d, SubBuckets     = %12d]\n", HIST_BUCKETS, HIST_HALF);
+    fclose(out);
+    return true;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static void sleep_until(uint64_t t_ns)
+{
+    struct timespec ts = {(time_t) (t_ns / 1000000000u), (long) (t_ns % 1000000000u)};
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {}
+}
+
+typedef struct {
+    int size;                       /* index into the raw messages */
+    int tenant;                     /* tenant mode: whose key signed it */
+    unsigned char salt[SALT_LEN];
+    gf2_mat_t signature;
+    unsigned char key_id[PUBKEY_DIGEST_SIZE];   /* F, published to the key store */
+} pool_entry;
+
+// Tenant mode: the key store, kept open for every run, and the ids requests draw from
+typedef struct {
+    keystore *store;                /* read-only, shared by every worker */
+    keystore *writer;               /* --grow only, a separate handle so the readers' mapping goes stale */
+    const char *prefix;
+    unsigned char (*ids)[KEYSTORE_ID_SIZE];
+    int count, capacity;            /* initial tenants; room for those every run grows */
+    _Atomic int live;               /* ids the workers may draw from, published after each add */
+} loadgen_tenants;
+
+// Keys, messages and pre-signed signatures shared read-only by the workers
+typedef struct {
+    struct code C_A, C1, C2;
+    shmcache_handle h_a;
+    qc_mat_t H_qc;
+    const gf2_mat_struct *H;        /* NULL when quasi-cyclic */
+    const nmod_mat_struct *G1, *G2;     /* NULL in tenant mode */
+    loadgen_tenants *tenants;           /* NULL for the keys in params.txt */
+    unsigned char *raw[LOADGEN_MAX_SIZES];
+    size_t raw_len[LOADGEN_MAX_SIZES];
+    int num_sizes;
+    pool_entry *pool;
+    int pool_size;
+    FILE *sink;
+} loadgen_keys;
+
+typedef struct {
+    const loadgen_keys *keys;
+    loadgen_op op;
+    int threads;
+    double rate;
+    int grow;                       /* keys grow_run adds during the run */
+    uint64_t start_ns, measure_ns, end_ns;
+} loadgen_run_ctx;
+
+typedef struct {
+    const loadgen_run_ctx *run;
+    int id;
+    pthread_t thread;
+    latency_hist service, response;     /* response: from the scheduled start, open loop only */
+    uint64_t ops, errors, backlog;
+} loadgen_worker;
+
+// As sign and verify do: pad with spaces or truncate to k
+static void normalize(unsigned char *dst, const unsigned char *raw, size_t raw_len, size_t k)
+{
+    size_t n = raw_len < k ? raw_len : k;
+    memcpy(dst, raw, n);
+    memset(dst + n, ' ', k - n);
+}
+
+static bool same_code(const struct code *a, const struct code *b)
+{
+    return a->n == b->n && a->k == b->k && a->d == b->d && a->quasi_cyclic == b->quasi_cyclic;
+}
+
+static void tenant_name(char *name, size_t len, const char *prefix, int i)
+{
+    snprintf(name, len, "%s-%d", prefix, i);
+}
+
+/* Looks up a tenant's key set in the shared store and attaches its H_A, into
+   h_a or, quasi-cyclic, the caller's H_qc. Workspaces are sized once, so a
+   tenant whose parameters differ from the first tenant's fails the request. */
+static bool tenant_acquire(const loadgen_keys *keys, int tenant, keystore_keyset *key,
+                           shmcache_handle *h_a, qc_mat_struct *H_qc)
+{
+    if (!keystore_lookup(keys->tenants->store, keys->tenants->ids[tenant], key) ||
+        !same_code(&key->C_A, &keys->C_A) || !same_code(&key->C1, &keys->C1) || !same_code(&key->C2, &keys->C2)) {
+        return false;
+    }
+    if (keys->C_A.quasi_cyclic) generate_parity_check_qc_from_seed(keys->C_A.n, keys->C_A.k, H_qc, key->h_a_seed);
+    else acquire_parity_check_matrix(&keys->C_A, key->h_a_seed, h_a);
+    return true;
+}
+
+static void tenant_release(const loadgen_keys *keys, shmcache_handle *h_a)
+{
+    if (!keys->C_A.quasi_cyclic) shmcache_release(h_a);
+}
+
+static bool pool_build(loadgen_keys *keys, int count)
+{
+    size_t k = keys->C1.k;
+    unsigned char *message = malloc(k);
+    keys->pool = calloc(count, sizeof(pool_entry));
+    if (!message || !keys->pool) {
+        free(message);
+        return false;
+    }
+
+    sign_workspace ws;
+    sign_workspace_init(&ws, &keys->C_A, &keys->C1, &keys->C2);
+    if (!keys->tenants) sign_workspace_set_generators(&ws, keys->G1, keys->G2);
+    ws.max_attempts = 10000;
+    bool ok = true;
+    for (int i = 0; i < count && ok; ++i) {
+        pool_entry *e = &keys->pool[i];
+        e->size = i % keys->num_sizes;
+        normalize(message, keys->raw[e->size], keys->raw_len[e->size], k);
+        if (keys->tenants) {
+            keystore_keyset key;
+            shmcache_handle h_a;
+            e->tenant = i % keys->tenants->count;
+            ok = tenant_acquire(keys, e->tenant, &key, &h_a, keys->H_qc);
+            if (!ok) break;
+            sign_workspace_expand_generators(&ws, key.g1_seed, key.g2_seed);
+            ok = generate_signature(&ws, message, k, keys->C_A.quasi_cyclic ? NULL : &h_a.M,
+                                    keys->C_A.quasi_cyclic ? keys->H_qc : NULL, e->salt, keys->sink);
+            tenant_release(keys, &h_a);
+        } else {
+            ok = generate_signature(&ws, message, k, keys->H, keys->H ? NULL : keys->H_qc, e->salt, keys->sink);
+        }
+        if (!ok) break;
+        if (!pkstore_publish(ws.F, e->key_id)) {
+            ok = false;
+            break;
+        }
+        gf2_mat_init(e->signature, ws.signature->r, ws.signature->c);
+        memcpy(e->signature->bits, ws.signature->bits, ws.signature->r * ws.signature->words * sizeof(uint64_t));
+        keys->pool_size = i + 1;
+    }
+    sign_workspace_clear(&ws);
+    free(message);
+    return ok;
+}
+
+/* Opens the store for the whole run and takes the parameters from the first
+   tenant; room is kept for the keys each of runs runs adds */
+static bool tenants_open(loadgen_keys *keys, const loadgen_options *opts, int runs)
+{
+    loadgen_tenants *t = calloc(1, sizeof(loadgen_tenants));
+    if (!t) return false;
+    keys->tenants = t;
+    t->prefix = opts->tenant_prefix;
+    t->count = opts->tenants;
+    t->capacity = opts->tenants + opts->grow * runs;
+    t->ids = malloc(t->capacity * sizeof(*t->ids));
+    t->store = keystore_open(KEYSTORE_DIR, false);
+    if (!t->ids || !t->store) return false;
+    if (opts->grow && !(t->writer = keystore_open(KEYSTORE_DIR, true))) return false;
+
+    char name[KEYSTORE_NAME_SIZE + 16];
+    for (int i = 0; i < t->capacity; ++i) {
+        tenant_name(name, sizeof(name), t->prefix, i);
+        keystore_key_id(name, t->ids[i]);
+    }
+    atomic_store(&t->live, t->count);
+
+    keystore_keyset key;
+    tenant_name(name, sizeof(name), t->prefix, 0);
+    if (!keystore_lookup(t->store, t->ids[0], &key)) {
+        fprintf(stderr, "Error: No key %s in %s\n", name, KEYSTORE_DIR);
+        return false;
+    }
+    keys->C_A = key.C_A; keys->C1 = key.C1; keys->C2 = key.C2;
+    if (keys->C_A.quasi_cyclic) qc_mat_init(keys->H_qc, keys->C_A.n - keys->C_A.k, keys->C_A.n);
+    return true;
+}
+
+static void tenants_close(loadgen_tenants *t)
+{
+    if (!t) return;
+    keystore_close(t->store);
+    keystore_close(t->writer);
+    free(t->ids);
+    free(t);
+}
+
+static bool keys_load(loadgen_keys *keys, const loadgen_options *opts, int runs)
+{
+    memset(keys, 0, sizeof(*keys));
+    if (opts->tenants) {
+        if (!tenants_open(keys, opts, runs)) return false;
+    } else if (!load_params(&keys->C_A, &keys->C1, &keys->C2)) {
+        return false;
+    }
+
+    // A tenant's H_A and generators are attached per request instead
+    if (!keys->tenants) {
+        unsigned char h_a_seed[SEED_SIZE];
+        if (keys->C_A.quasi_cyclic) {
+            if (!load_parity_check_qc(&keys->C_A, true, keys->H_qc, h_a_seed)) return false;
+        } else {
+            if (!get_or_generate_seed("H", keys->C_A.n, keys->C_A.k, keys->C_A.d, false, h_a_seed)) return false;
+            acquire_parity_check_matrix(&keys->C_A, h_a_seed, &keys->h_a);
+            keys->H = &keys->h_a.M;
+        }
+
+        keys->G1 = registry_acquire("G", keys->C1.n, keys->C1.k, keys->C1.d, true, create_generator_matrix_from_seed);
+        keys->G2 = registry_acquire("G", keys->C2.n, keys->C2.k, keys->C2.d, true, create_generator_matrix_from_seed);
+        if (!keys->G1 || !keys->G2) {
+            fprintf(stderr, "Error: Could not load generator matrices from cache.\n");
+            return false;
+        }
+    }
+
+    // Without sizes, messages are exactly k bytes, the length sign pads or cuts them to
+    keys->num_sizes = opts->num_sizes ? opts->num_sizes : 1;
+    for (int i = 0; i < keys->num_sizes; ++i) {
+        keys->raw_len[i] = opts->num_sizes ? opts->sizes[i] : keys->C1.k;
+        keys->raw[i] = malloc(keys->raw_len[i] ? keys->raw_len[i] : 1);
+        if (!keys->raw[i]) return false;
+        for (size_t j = 0; j < keys->raw_len[i]; ++j) keys->raw[i][j] = 'a' + rng_uniform(26);
+    }
+
+    keys->sink = fopen("/dev/null", "w");
+    return keys->sink != NULL;
+}
+
+static void keys_clear(loadgen_keys *keys)
+{
+    for (int i = 0; i < keys->pool_size; ++i) {
+        gf2_mat_clear(keys->pool[i].signature);
+    }
+    free(keys->pool);
+    for (int i = 0; i < keys->num_sizes; ++i) free(keys->raw[i]);
+    if (keys->C_A.quasi_cyclic && keys->H_qc->blocks) qc_mat_clear(keys->H_qc);
+    else if (keys->H) shmcache_release(&keys->h_a);
+    if (keys->G1) registry_release(keys->G1);
+    if (keys->G2) registry_release(keys->G2);
+    tenants_close(keys->tenants);
+    if (keys->sink) fclose(keys->sink);
+}
+
+static void *worker_run(void *arg)
+{
+    loadgen_worker *w = arg;
+    const loadgen_run_ctx *run = w->run;
+    const loadgen_keys *keys = run->keys;
+    size_t k = keys->C1.k;
+
+    sign_workspace sw;
+    verify_workspace vw;
+    if (run->op == LOADGEN_SIGN) {
+        sign_workspace_init(&sw, &keys->C_A, &keys->C1, &keys->C2);
+        if (!keys->tenants) sign_workspace_set_generators(&sw, keys->G1, keys->G2);
+        sw.max_attempts = 10000;
+    } else {
+        verify_workspace_init(&vw, &keys->C_A, &keys->C1);
+    }
+    unsigned char *message = malloc(k);
+    unsigned char salt[SALT_LEN];
+
+    // Tenant mode: the requested tenant's H_A, mapped or (quasi-cyclic) expanded into this worker's blocks
+    bool tenant_qc = keys->tenants && keys->C_A.quasi_cyclic;
+    qc_mat_t H_qc;
+    if (tenant_qc) qc_mat_init(H_qc, keys->C_A.n - keys->C_A.k, keys->C_A.n);
+    keystore_keyset key;
+    shmcache_handle h_a;
+
+    // Open loop: this worker takes requests id, id + threads, ...; request i is due at start + i / rate
+    double period_ns = run->rate > 0 ? 1e9 / run->rate : 0;
+    uint64_t i = w->id, issued = 0;
+
+    sleep_until(run->start_ns);
+    for (;; i += run->threads, ++issued) {
+        uint64_t due = period_ns ? run->start_ns + (uint64_t) (i * period_ns) : 0;
+        if (period_ns) {
+            if (due >= run->end_ns) break;
+            if (now_ns() >= run->end_ns) {
+                // Still queued at the end: record what they have waited so far
+                for (; due < run->end_ns; i += run->threads, due = run->start_ns + (uint64_t) (i * period_ns)) {
+                    if (due >= run->measure_ns) {
+                        hist_add(&w->response, run->end_ns - due, 1);
+                        ++w->backlog;
+                    }
+                }
+                break;
+            }
+            sleep_until(due);
+        }
+
+        uint64_t start = now_ns();
+        if (!period_ns && start >= run->end_ns) break;
+
+        bool ok;
+        if (run->op == LOADGEN_SIGN && keys->tenants) {
+            // Every tenant, including those grown so far, as sign --key would see them
+            int live = atomic_load_explicit(&keys->tenants->live, memory_order_acquire);
+            int s = (int) (issued % keys->num_sizes);
+            normalize(message, keys->raw[s], keys->raw_len[s], k);
+            ok = tenant_acquire(keys, (int) ((w->id + issued * run->threads) % live), &key, &h_a, H_qc);
+            if (ok) {
+                sign_workspace_expand_generators(&sw, key.g1_seed, key.g2_seed);
+                ok = generate_signature(&sw, message, k, tenant_qc ? NULL : &h_a.M, tenant_qc ? H_qc : NULL,
+                                        salt, keys->sink);
+                tenant_release(keys, &h_a);
+            }
+        } else if (run->op == LOADGEN_SIGN) {
+            int s = (int) (issued % keys->num_sizes);
+            normalize(message, keys->raw[s], keys->raw_len[s], k);
+            ok = generate_signature(&sw, message, k, keys->H, keys->H ? NULL : keys->H_qc, salt, keys->sink);
+        } else if (keys->tenants) {
+            // The signer's key set and H_A, then F through the public key store, as verify --key does
+            const pool_entry *e = &keys->pool[(w->id + issued * run->threads) % keys->pool_size];
+            normalize(message, keys->raw[e->size], keys->raw_len[e->size], k);
+            ok = tenant_acquire(keys, e->tenant, &key, &h_a, H_qc);
+            if (ok) {
+                const gf2_mat_struct *F = pkstore_acquire(pkstore_shared(), e->key_id);
+                ok = F && (tenant_qc
+                    ? verify_signature_qc(&vw, message, k, e->salt, SALT_LEN, e->signature, F, H_qc, false, keys->sink)
+                    : verify_signature(&vw, message, k, e->salt, SALT_LEN, e->signature, F, &h_a.M, false,
+                                       keys->sink));
+                pkstore_release(pkstore_shared(), F);
+                tenant_release(keys, &h_a);
+            }
+        } else {
+            // As sig verify does, F comes from the public key store by the signature's key id
+            const pool_entry *e = &keys->pool[(w->id + issued * run->threads) % keys->pool_size];
+            const gf2_mat_struct *F = pkstore_acquire(pkstore_shared(), e->key_id);
+            normalize(message, keys->raw[e->size], keys->raw_len[e->size], k);
+            ok = F && (keys->H
+                ? verify_signature(&vw, message, k, e->salt, SALT_LEN, e->signature, F, keys->H, false, keys->sink)
+                : verify_signature_qc(&vw, message, k, e->salt, SALT_LEN, e->signature, F, keys->H_qc,
+                                      false, keys->sink));
+            pkstore_release(pkstore_shared(), F);
+        }
+        uint64_t end = now_ns();
+
+        // Throughput counts what started in the window; an overloaded open loop
+        // may still be working through requests that were due during warm-up
+        if (start >= run->measure_ns) {
+            ++w->ops;
+            if (!ok) ++w->errors;
+        }
+        if ((period_ns ? due : start) < run->measure_ns) continue;
+        hist_add(&w->service, end - start, 1);
+        if (period_ns) hist_add(&w->response, end - due, 1);
+    }
+
+    if (run->op == LOADGEN_SIGN) sign_workspace_clear(&sw);
+    else verify_workspace_clear(&vw);
+    if (tenant_qc) qc_mat_clear(H_qc);
+    free(message);
+    return NULL;
+}
+
+/* --grow: adds the run's keys through the writable handle, spread over the
+   measured window. Each is published to the workers only once it is in the
+   store, so their first lookup of it misses the stale mapping and remaps. */
+static void *grow_run(void *arg)
+{
+    const loadgen_run_ctx *run = arg;
+    const loadgen_keys *keys = run->keys;
+    loadgen_tenants *t = keys->tenants;
+    uint64_t step = (run->end_ns - run->measure_ns) / (uint64_t) (run->grow + 1);
+    char name[KEYSTORE_NAME_SIZE + 16];
+
+    for (int j = 1; j <= run->grow; ++j) {
+        int i = atomic_load(&t->live);
+        if (i == t->capacity) break;
+        sleep_until(run->measure_ns + j * step);
+        tenant_name(name, sizeof(name), t->prefix, i);
+
+        // Left by an earlier loadgen, the key is reused rather than added again
+        keystore_keyset key;
+        bool have = keystore_lookup(t->writer, t->ids[i], &key) ||
+                    (keystore_keyset_init(&key, name, &keys->C_A, &keys->C1, &keys->C2) &&
+                     keystore_add(t->writer, &key));
+        if (!have) break;
+        atomic_store_explicit(&t->live, i + 1, memory_order_release);
+    }
+    return NULL;
+}
+
+typedef struct {
+    uint64_t ops, errors, backlog;
+    double seconds;
+    latency_hist service, corrected;
+} loadgen_result;
+
+static void run_once(const loadgen_keys *keys, const loadgen_options *opts, loadgen_op op, int threads,
+                     loadgen_result *res)
+{
+    loadgen_run_ctx run = {keys, op, threads, opts->rate, keys->tenants ? opts->grow : 0, 0, 0, 0};
+    loadgen_worker *workers = calloc(threads, sizeof(loadgen_worker));
+    memset(res, 0, sizeof(*res));
+    if (!workers) return;
+
+    // Leave the workers time to build their workspaces before the clock starts
+    run.start_ns = now_ns() + 50000000u;
+    run.measure_ns = run.start_ns + (uint64_t) (opts->warmup * 1e9);
+    run.end_ns = run.measure_ns + (uint64_t) (opts->duration * 1e9);
+
+    int started = 0;
+    for (; started < threads; ++started) {
+        workers[started].run = &run;
+        workers[started].id = started;
+        if (pthread_create(&workers[started].thread, NULL, worker_run, &workers[started]) != 0) {
+            fprintf(stderr, "Could only start %d of %d threads\n", started, threads);
+            break;
+        }
+    }
+
+    pthread_t grower;
+    bool growing = run.grow && pthread_create(&grower, NULL, grow_run, &run) == 0;
+
+    latency_hist response;
+    memset(&response, 0, sizeof(response));
+    if (growing) pthread_join(grower, NULL);
+    for (int t = 0; t < started; ++t) {
+        pthread_join(workers[t].thread, NULL);
+        hist_merge(&res->service, &workers[t].service);
+        hist_merge(&response, &workers[t].response);
+        res->ops += workers[t].ops;
+        res->errors += workers[t].errors;
+        res->backlog += workers[t].backlog;
+    }
+    res->seconds = opts->duration;
+
+    if (opts->rate > 0) res->corrected = response;
+    else hist_correct(&res->corrected, &res->service, hist_percentile(&res->service, 50));
+    free(workers);
+}
+
+static const char *op_names[] = {"sign", "verify"};
+
+static void print_percentiles(FILE *out, const latency_hist *h)
+{
+    static const double p[] = {50, 90, 99, 99.9};
+    for (size_t i = 0; i < sizeof(p) / sizeof(p[0]); ++i) fprintf(out, ",%.3f", hist_percentile(h, p[i]) / 1e3);
+    fprintf(out, ",%.3f", h->max / 1e3);
+}
+
+static bool report(const loadgen_options *opts, loadgen_op op, int threads, const loadgen_result *res)
+{
+    const char *mode = opts->rate > 0 ? "open" : "closed";
+    double throughput = res->ops / res->seconds;
+
+    printf("%-6s %-6s %7d %10.1f %10.1f %10.3f %10.3f %10.3f %10.3f %8llu\n", op_names[op], mode, threads,
+           opts->rate, throughput,
+           hist_percentile(&res->corrected, 50) / 1e3, hist_percentile(&res->corrected, 99) / 1e3,
+           hist_percentile(&res->corrected, 99.9) / 1e3, res->corrected.max / 1e3,
+           (unsigned long long) res->errors);
+
+    char path[MAX_FILENAME_LENGTH];
+    snprintf(path, sizeof(path), "%s/loadgen.csv", opts->out_dir);
+    struct stat st;
+    bool fresh = stat(path, &st) != 0 || st.st_size == 0;
+    FILE *csv = fopen(path, "a");
+    if (!csv) {
+        fprintf(stderr, "Could not open %s: %s\n", path, strerror(errno));
+        return false;
+    }
+    if (fresh) {
+        fprintf(csv, "op,mode,threads,target_rate,seconds,ops,errors,backlog,throughput,"
+                     "service_p50_us,service_p90_us,service_p99_us,service_p999_us,service_max_us,"
+                     "corrected_p50_us,corrected_p90_us,corrected_p99_us,corrected_p999_us,corrected_max_us\n");
+    }
+    fprintf(csv, "%s,%s,%d,%.1f,%.3f,%llu,%llu,%llu,%.1f", op_names[op], mode, threads, opts->rate, res->seconds,
+            (unsigned long long) res->ops, (unsigned long long) res->errors, (unsigned long long) res->backlog,
+            throughput);
+    print_percentiles(csv, &res->service);
+    print_percentiles(csv, &res->corrected);
+    fprintf(csv, "\n");
+    fclose(csv);
+
+    snprintf(path, sizeof(path), "%s/loadgen_%s_%s_t%d_service.hgrm", opts->out_dir, op_names[op], mode, threads);
+    bool ok = hist_write(path, &res->service);
+    snprintf(path, sizeof(path), "%s/loadgen_%s_%s_t%d_corrected.hgrm", opts->out_dir, op_names[op], mode, threads);
+    return hist_write(path, &res->corrected) && ok;
+}
+
+void loadgen_default_options(loadgen_options *opts)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    opts->op = LOADGEN_BOTH;
+    opts->threads_min = 1;
+    opts->threads_max = cpus > 0 ? (int) cpus : 1;
+    opts->threads_step = 0;
+    opts->rate = 0;
+    opts->duration = 2;
+    opts->warmup = 0.5;
+    opts->sizes[0] = 0;
+    opts->num_sizes = 0;
+    opts->pool = 64;
+    opts->tenant_prefix = NULL;
+    opts->tenants = 0;
+    opts->grow = 0;
+    opts->out_dir = "timing";
+}
+
+// Step 0 doubles, always finishing on threads_max
+static int next_threads(const loadgen_options *o, int threads)
+{
+    int next = o->threads_step ? threads + o->threads_step : 2 * threads;
+    if (!o->threads_step && next > o->threads_max && threads < o->threads_max) next = o->threads_max;
+    return next;
+}
+
+int loadgen_run(const loadgen_options *opts)
+{
+    // Everything the workers print goes to /dev/null; formatting it would only skew the latencies
+    dump_verbosity = DUMP_NONE;
+    if (mkdir(opts->out_dir, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Could not create %s: %s\n", opts->out_dir, strerror(errno));
+        return 1;
+    }
+
+    loadgen_keys keys;
+    loadgen_options o = *opts;
+    int runs = 0;
+    for (int threads = o.threads_min; threads <= o.threads_max; threads = next_threads(&o, threads)) ++runs;
+    if (o.op == LOADGEN_BOTH) runs *= 2;
+    // One signed message per tenant at least, so verify touches every key
+    if (o.tenants && o.pool < o.tenants) o.pool = o.tenants;
+
+    bool ok = keys_load(&keys, &o, runs);
+    if (ok && o.op != LOADGEN_SIGN) ok = pool_build(&keys, o.pool);
+    if (!ok) {
+        fprintf(stderr, "Could not set up keys for the load generator; run %s first\n",
+                o.tenants ? "keystore add" : "keygen");
+        keys_clear(&keys);
+        return 1;
+    }
+
+    printf("n_A = %lu, k = %lu, %s H_A, %.1f s per run after %.1f s warm-up\n", keys.C_A.n, keys.C1.k,
+           keys.C_A.quasi_cyclic ? "quasi-cyclic" : "dense", o.duration, o.warmup);
+    if (o.tenants) printf("%d tenants %s-*, %d added per run\n", o.tenants, o.tenant_prefix, o.grow);
+    printf("\n");
+    printf("%-6s %-6s %7s %10s %10s %10s %10s %10s %10s %8s\n", "op", "mode", "threads", "rate/s", "ops/s",
+           "p50 us", "p99 us", "p99.9 us", "max us", "errors");
+
+    for (int op = LOADGEN_SIGN; op <= LOADGEN_VERIFY && ok; ++op) {
+        if (o.op != LOADGEN_BOTH && o.op != (loadgen_op) op) continue;
+        for (int threads = o.threads_min; threads <= o.threads_max && ok; ) {
+            loadgen_result res;
+            run_once(&keys, &o, (loadgen_op) op, threads, &res);
+            ok = report(&o, (loadgen_op) op, threads, &res);
+            threads = next_threads(&o, threads);
+        }
+    }
+
+    if (o.op != LOADGEN_SIGN) pkstore_print_stats(stdout, pkstore_shared());
+    if (keys.tenants) keystore_print_stats(stdout, keys.tenants->store);
+    printf("\nCorrected percentiles; results in %s/loadgen.csv and .hgrm files\n", o.out_dir);
+    keys_clear(&keys);
+    return ok ? 0 : 1;
+}
@@ -8,19 +8,39 @@
 #include "verifier.h"
 #include "utils.h"
 #include "constants.h"
+#include "gf2mat.h"
+#include "pkstore.h"
+#include "envelope.h"
+#include "registry.h"
+#include "bch.h"
+#include "bchenc.h"
+#include "sweep.h"
+#include "loadgen.h"
+#include "trace.h"
+#include "dump.h"
+#include "hugemem.h"
+#include "memacct.h"
+#include "keystore.h"
 
 int keygen(int argc, char *argv[]);
 int sign(int argc, char *argv[]);
 int verify(int argc, char *argv[]);
+int bch_catalogue(int argc, char *argv[]);
+int sweep(int argc, char *argv[]);
+int loadgen(int argc, char *argv[]);
+int keystore_command(int argc, char *argv[]);
 
 int main(int argc, char *argv[]) {
     if (argc < 2) {
-        fprintf(stderr, "Usage: %s {keygen|sign|verify} [options...]\n", argv[0]);
+        fprintf(stderr, "Usage: %s {keygen|sign|verify|keystore|bch-table|sweep|loadgen} [options...]\n", argv[0]);
         return 1;
     }
 
     ensure_matrix_cache();
     ensure_output_directory();
+    trace_init();
+    dump_init();
+    memacct_init();
 
     if (strcmp(argv[1], "keygen") == 0) {
         return keygen(argc - 1, &argv[1]);
@@ -28,19 +48,58 @@ int main(int argc, char *argv[]) {
         return sign(argc - 1, &argv[1]);
     } else if (strcmp(argv[1], "verify") == 0) {
         return verify(argc - 1, &argv[1]);
+    } else if (strcmp(argv[1], "keystore") == 0) {
+        return keystore_command(argc - 1, &argv[1]);
+    } else if (strcmp(argv[1], "bch-table") == 0) {
+        return bch_catalogue(argc - 1, &argv[1]);
+    } else if (strcmp(argv[1], "sweep") == 0) {
+        return sweep(argc - 1, &argv[1]);
+    } else if (strcmp(argv[1], "loadgen") == 0) {
+        return loadgen(argc - 1, &argv[1]);
     } else {
         fprintf(stderr, "Unknown command: %s\n", argv[1]);
         return 1;
     }
 }
 
+// --mem-budget, which overrides SIG_MEM_BUDGET
+static bool set_mem_budget(const char *arg) {
+    size_t bytes;
+    if (!memacct_parse_size(arg, &bytes)) {
+        fprintf(stderr, "Invalid memory budget %s, expected bytes with an optional K, M or G suffix\n", arg);
+        return false;
+    }
+    memacct_set_budget(bytes);
+    return true;
+}
+
+// --key: a tenant's parameters and seeds from the key store, in place of params.txt and matrix_cache/
+static bool load_keyset(const char *name, keystore_keyset *key) {
+    trace_mark t = trace_begin();
+    keystore *ks = keystore_open(KEYSTORE_DIR, false);
+    bool found = ks && keystore_find(ks, name, key);
+    if (ks && !found) fprintf(stderr, "Error: No key %s in %s\n", name, KEYSTORE_DIR);
+    keystore_close(ks);
+    trace_end("keystore.lookup", t);
+    return found;
+}
+
+static void print_memory_stats(FILE *output_file) {
+    if (!dump_enabled(DUMP_SUMMARY)) return;
+    hugemem_print_stats(output_file);
+    memacct_print_stats(output_file);
+}
+
 int keygen(int argc, char *argv[]) {
     bool use_seed_mode = false;
     bool regenerate = false;
+    bool quasi_cyclic = false;
 
     for (int i = 1; i < argc; ++i) {
         if (strcmp(argv[i], "--use-seed") == 0) use_seed_mode = true;
         if (strcmp(argv[i], "--regenerate") == 0) regenerate = true;
+        if (strcmp(argv[i], "--quasi-cyclic") == 0) quasi_cyclic = true;
+        if (strcmp(argv[i], "--mem-budget") == 0 && i + 1 < argc && !set_mem_budget(argv[++i])) return 1;
     }
 
     FILE *output_file = fopen(OUTPUT_PATH, "w");
@@ -50,26 +109,40 @@ int keygen(int argc, char *argv[]) {
     }
 
     Params g1, g2, h_a;
+    h_a.quasi_cyclic = quasi_cyclic;
     get_user_input(&g1, &g2, &h_a);
 
-    struct code C_A = {get_H_A_n(), get_H_A_k(), get_H_A_d()};
+    struct code C_A = {get_H_A_n(), get_H_A_k(), get_H_A_d(), get_H_A_qc()};
     struct code C1 = {get_G1_n(), get_G1_k(), get_G1_d()};
     struct code C2 = {get_G2_n(), get_G2_k(), get_G2_d()};
 
+    // The nmod matrices take a limb per bit, so they are checked against the budget up front
+    size_t nmod_bytes = ((size_t) (C_A.quasi_cyclic ? 0 : C_A.n - C_A.k) * C_A.n +
+                         (size_t) C1.k * C1.n + (size_t) C2.k * C2.n) * sizeof(mp_limb_t);
+    if (!memacct_charge(MEM_MATRICES, nmod_bytes, "key generation")) {
+        fclose(output_file);
+        return 1;
+    }
+
     nmod_mat_t H_A, G1, G2;
-    nmod_mat_init(H_A, C_A.n - C_A.k, C_A.n, MOD);
+    // A quasi-cyclic H_A is never expanded into a dense matrix
+    nmod_mat_init(H_A, C_A.quasi_cyclic ? 0 : C_A.n - C_A.k, C_A.n, MOD);
     nmod_mat_init(G1, C1.k, C1.n, MOD);
     nmod_mat_init(G2, C2.k, C2.n, MOD);
 
     unsigned char h_a_seed[SEED_SIZE], g1_seed[SEED_SIZE], g2_seed[SEED_SIZE];
 
+    trace_mark t = trace_begin();
     generate_keys(&C_A, &C1, &C2, H_A, G1, G2,
                   use_seed_mode, regenerate, output_file,
                   h_a_seed, g1_seed, g2_seed);
+    trace_end("keygen.generate_keys", t);
+    print_memory_stats(output_file);
 
     nmod_mat_clear(H_A);
     nmod_mat_clear(G1);
     nmod_mat_clear(G2);
+    memacct_release(MEM_MATRICES, nmod_bytes);
 
     fclose(output_file);
     return 0;
@@ -78,23 +151,54 @@ int keygen(int argc, char *argv[]) {
 int sign(int argc, char *argv[]) {
     const char *message_file = NULL;
     const char *signature_output = NULL;
+    const char *key_name = NULL;
+    bool low_memory = false;
 
     for (int i = 1; i < argc; ++i) {
         if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
             message_file = argv[++i];
         } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
             signature_output = argv[++i];
+        } else if (strcmp(argv[i], "--key") == 0 && i + 1 < argc) {
+            key_name = argv[++i];
+        } else if (strcmp(argv[i], "--low-memory") == 0) {
+            low_memory = true;
+        } else if (strcmp(argv[i], "--mem-budget") == 0 && i + 1 < argc) {
+            if (!set_mem_budget(argv[++i])) return 1;
         }
     }
 
     if (!message_file) {
-        fprintf(stderr, "Usage: sign -m message.txt [-o sig.bin]\n");
+        fprintf(stderr, "Usage: sign -m message.txt [-o sig.sig] [--key name] [--low-memory] [--mem-budget bytes]\n");
         return 1;
     }
 
+    trace_mark t = trace_begin();
     struct code C_A, C1, C2;
-    if (!load_params(&C_A, &C1, &C2)) return 1;
+    keystore_keyset key;
+    if (key_name) {
+        if (!load_keyset(key_name, &key)) return 1;
+        C_A = key.C_A; C1 = key.C1; C2 = key.C2;
+        // A tenant's generators are only seeds, never cached matrices
+        low_memory = true;
+    } else if (!load_params(&C_A, &C1, &C2)) {
+        return 1;
+    }
+    trace_end("sign.load_params", t);
 
+    // Over budget, expand G1 and G2 packed instead of caching them as nmod matrices, else refuse
+    if (!low_memory && !memacct_fits(sign_memory_estimate(&C_A, &C1, &C2, false))) {
+        low_memory = true;
+        fprintf(stderr, "Expanding G1 and G2 packed to stay within the memory budget\n");
+    }
+    size_t needed = sign_memory_estimate(&C_A, &C1, &C2, low_memory);
+    if (!memacct_fits(needed)) {
+        fprintf(stderr, "Error: signing needs about %zu bytes, over the memory budget of %zu bytes\n",
+                needed, memacct_budget());
+        return 1;
+    }
+
+    t = trace_begin();
     char *raw_msg = read_file_or_generate(message_file, C1.k);
     if (!raw_msg) return 1;
 
@@ -103,105 +207,437 @@ int sign(int argc, char *argv[]) {
     char *msg = normalize_message_length(raw_msg, raw_len, C1.k, &msg_len);
     free(raw_msg);
     if (!msg) return 1;
+    trace_end("sign.read_message", t);
 
     const unsigned char *message = (const unsigned char *)msg;
 
     FILE *output_file = fopen(OUTPUT_PATH, "w");
 
-    nmod_mat_t H_A, G1, G2, F, signature, bin_hash;
-    nmod_mat_init(H_A, C_A.n - C_A.k, C_A.n, MOD);
-    nmod_mat_init(G1, C1.k, C1.n, MOD);
-    nmod_mat_init(G2, C2.k, C2.n, MOD);
-    nmod_mat_init(F, C_A.n - C_A.k, C1.k, MOD);
-    nmod_mat_init(signature, 1, C_A.n, MOD);
-    nmod_mat_init(bin_hash, 1, msg_len, MOD);
-
-    get_or_generate_matrix_with_seed("H", C_A.n, C_A.k, C_A.d, H_A,
-                                     NULL, generate_parity_check_matrix_from_seed,
-                                     output_file, false, true, NULL);
-    get_or_generate_matrix_with_seed("G", C1.n, C1.k, C1.d, G1,
-                                     NULL, create_generator_matrix_from_seed,
-                                     output_file, false, true, NULL);
-    get_or_generate_matrix_with_seed("G", C2.n, C2.k, C2.d, G2,
-                                     NULL, create_generator_matrix_from_seed,
-                                     output_file, false, true, NULL);
-
-    const unsigned int salt_len = SALT_LEN;
-    unsigned char salt[salt_len];
-    generate_signature(bin_hash, message, msg_len, C_A, C1, C2,
-                 H_A, G1, G2, F, signature, salt_len, salt, output_file);
-
-    char path[MAX_FILENAME_LENGTH]; 
-    snprintf(path, sizeof(path), "%s/salt.txt", OUTPUT_DIR);
-    save_to_file(salt, salt_len, path);
-    snprintf(path, sizeof(path), "%s/signature.txt", OUTPUT_DIR);
-    save_matrix(path, signature);
-    snprintf(path, sizeof(path), "%s/public_key.txt", OUTPUT_DIR);
-    save_matrix(path, F);
-
-    nmod_mat_clear(H_A); nmod_mat_clear(G1); nmod_mat_clear(G2);
-    nmod_mat_clear(F); nmod_mat_clear(signature); nmod_mat_clear(bin_hash);
+    // G1 and G2 usually share (n, k, d), in which case the registry loads the matrix once
+    t = trace_begin();
+    const nmod_mat_struct *G1 = NULL, *G2 = NULL;
+    unsigned char g1_seed[SEED_SIZE], g2_seed[SEED_SIZE];
+    bool have_G = true;
+    if (key_name) {
+        memcpy(g1_seed, key.g1_seed, SEED_SIZE);
+        memcpy(g2_seed, key.g2_seed, SEED_SIZE);
+    } else if (low_memory) {
+        have_G = get_or_generate_seed("G", C1.n, C1.k, C1.d, false, g1_seed) &&
+                 get_or_generate_seed("G", C2.n, C2.k, C2.d, false, g2_seed);
+    } else {
+        G1 = registry_acquire("G", C1.n, C1.k, C1.d, true, create_generator_matrix_from_seed);
+        G2 = registry_acquire("G", C2.n, C2.k, C2.d, true, create_generator_matrix_from_seed);
+        have_G = G1 && G2;
+    }
+    if (!have_G) {
+        fprintf(stderr, "Error: Could not load generator matrices from cache.\n");
+        return 1;
+    }
+    trace_end("sign.load_G", t);
+
+    sign_workspace ws;
+    sign_workspace_init(&ws, &C_A, &C1, &C2);
+    t = trace_begin();
+    if (low_memory) {
+        sign_workspace_expand_generators(&ws, g1_seed, g2_seed);
+    } else {
+        sign_workspace_set_generators(&ws, G1, G2);
+        registry_release(G1); registry_release(G2);
+    }
+    trace_end(low_memory ? "sign.expand_G" : "sign.pack_G", t);
+
+    // H_A is attached only once the nmod G1 and G2 are released, so the two never coexist
+    t = trace_begin();
+    unsigned char h_a_seed[SEED_SIZE];
+    qc_mat_t H_A_qc;
+    shmcache_handle h_a;
+    if (key_name) {
+        memcpy(h_a_seed, key.h_a_seed, SEED_SIZE);
+        if (C_A.quasi_cyclic) {
+            qc_mat_init(H_A_qc, C_A.n - C_A.k, C_A.n);
+            generate_parity_check_qc_from_seed(C_A.n, C_A.k, H_A_qc, h_a_seed);
+        } else {
+            acquire_parity_check_matrix(&C_A, h_a_seed, &h_a);
+        }
+    } else if (C_A.quasi_cyclic) {
+        if (!load_parity_check_qc(&C_A, true, H_A_qc, h_a_seed)) return 1;
+    } else {
+        if (!get_or_generate_seed("H", C_A.n, C_A.k, C_A.d, false, h_a_seed)) return 1;
+        acquire_parity_check_matrix(&C_A, h_a_seed, &h_a);
+    }
+    trace_end("sign.load_H_A", t);
+
+    t = trace_begin();
+    unsigned char salt[SALT_LEN];
+    bool signed_ok = generate_signature(&ws, message, msg_len,
+                                        C_A.quasi_cyclic ? NULL : &h_a.M, C_A.quasi_cyclic ? H_A_qc : NULL,
+                                        salt, output_file);
+    trace_end("sign.generate_signature", t);
+
+    if (C_A.quasi_cyclic) qc_mat_clear(H_A_qc);
+    else shmcache_release(&h_a);
+
+    unsigned char key_id[PUBKEY_DIGEST_SIZE];
+
+    if (!signature_output) signature_output = SIGNATURE_PATH;
+    t = trace_begin();
+    bool saved = signed_ok && pkstore_publish(ws.F, key_id) &&
+                 envelope_write(signature_output, ws.signature, msg_len, salt, SALT_LEN, key_id);
+    trace_end("sign.write", t);
+    if (!saved) {
+        fprintf(stderr, "Error: Could not write signature to %s\n", signature_output);
+    }
+
+    print_memory_stats(output_file);
+    sign_workspace_clear(&ws);
     
     fclose(output_file); 
     free(msg);
 
-    return 0;
+    return saved ? 0 : 1;
 }
 
 int verify(int argc, char *argv[]) {
     const char *message_file = NULL;
     const char *signature_file = NULL;
+    const char *key_name = NULL;
+    bool full_check = false;
 
     for (int i = 1; i < argc; ++i) {
         if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
             message_file = argv[++i];
         } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
             signature_file = argv[++i];
+        } else if (strcmp(argv[i], "--full-check") == 0) {
+            full_check = true;
+        } else if (strcmp(argv[i], "--key") == 0 && i + 1 < argc) {
+            key_name = argv[++i];
+        } else if (strcmp(argv[i], "--mem-budget") == 0 && i + 1 < argc) {
+            if (!set_mem_budget(argv[++i])) return 1;
         }
     }
 
     if (!message_file || !signature_file) {
-        fprintf(stderr, "Usage: verify -m message.txt -s sig.bin\n");
+        fprintf(stderr, "Usage: verify -m message.txt -s sig.sig [--key name] [--full-check] [--mem-budget bytes]\n");
         return 1;
     }
 
+    trace_mark t = trace_begin();
     struct code C_A, C1, C2;
-    if (!load_params(&C_A, &C1, &C2)) return 1;
+    keystore_keyset key;
+    if (key_name) {
+        if (!load_keyset(key_name, &key)) return 1;
+        C_A = key.C_A; C1 = key.C1; C2 = key.C2;
+    } else if (!load_params(&C_A, &C1, &C2)) {
+        return 1;
+    }
+    trace_end("verify.load_params", t);
 
+    t = trace_begin();
     char *raw_msg = read_file(message_file);
+    if (!raw_msg) return 1;
     size_t raw_len = strlen(raw_msg);
     size_t msg_len = 0;
     char *msg = normalize_message_length(raw_msg, raw_len, C1.k, &msg_len);
     free(raw_msg);
+    if (!msg) return 1;
     const unsigned char *message = (const unsigned char *)msg;
+    trace_end("verify.read_message", t);
+
+    t = trace_begin();
+    unsigned char h_a_seed[SEED_SIZE];
+    qc_mat_t H_A_qc;
+    bool have_seed;
+    if (key_name) {
+        memcpy(h_a_seed, key.h_a_seed, SEED_SIZE);
+        if (C_A.quasi_cyclic) {
+            qc_mat_init(H_A_qc, C_A.n - C_A.k, C_A.n);
+            generate_parity_check_qc_from_seed(C_A.n, C_A.k, H_A_qc, h_a_seed);
+        }
+        have_seed = true;
+    } else if (C_A.quasi_cyclic) {
+        have_seed = load_parity_check_qc(&C_A, false, H_A_qc, h_a_seed);
+    } else {
+        char *seed_filename = generate_seed_filename("H", C_A.n, C_A.k, C_A.d);
+        have_seed = seed_filename && load_seed(seed_filename, h_a_seed);
+        free(seed_filename);
+    }
+    if (!have_seed) {
+        fprintf(stderr, "Error: Could not load H_A seed from cache, run keygen %s first.\n",
+                C_A.quasi_cyclic ? "--quasi-cyclic" : "--use-seed");
+        free(msg);
+        return 1;
+    }
+    trace_end("verify.load_seed", t);
+
+    t = trace_begin();
+    sig_envelope envelope;
+    if (!envelope_open(signature_file, &envelope)) {
+        fprintf(stderr, "Error: Could not read signature envelope from %s\n", signature_file);
+        free(msg);
+        return 1;
+    }
+
+    if (envelope.header->sig_bits != C_A.n || envelope.header->msg_len != msg_len) {
+        if (key_name) fprintf(stderr, "Error: Signature in %s does not match the parameters of key %s\n",
+                              signature_file, key_name);
+        else fprintf(stderr, "Error: Signature in %s does not match the parameters in %s\n", signature_file, PARAM_PATH);
+        envelope_close(&envelope); free(msg);
+        return 1;
+    }
+    trace_end("verify.open_envelope", t);
+
+    t = trace_begin();
+    pkstore *keys = pkstore_shared();
+    const gf2_mat_struct *F = keys ? pkstore_acquire(keys, envelope.key_id) : NULL;
+    if (!F) {
+        fprintf(stderr, "Error: Could not load public key F referenced by the signature.\n");
+        envelope_close(&envelope); free(msg);
+        return 1;
+    }
+    trace_end("verify.load_pubkey", t);
 
     FILE *output_file = fopen(OUTPUT_PATH, "w");
 
-    nmod_mat_t H_A, F, signature, bin_hash;
-    nmod_mat_init(H_A, C_A.n - C_A.k, C_A.n, MOD);
-    nmod_mat_init(F, C_A.n - C_A.k, C1.k, MOD);
-    nmod_mat_init(signature, 1, C_A.n, MOD);
+    verify_workspace ws;
+    verify_workspace_init(&ws, &C_A, &C1);
 
-    load_matrix(signature_file, signature);
+    bool valid;
+    if (C_A.quasi_cyclic) {
+        valid = verify_signature_qc(&ws, message, msg_len, envelope.salt, envelope.header->salt_len,
+                                    &envelope.signature, F, H_A_qc, full_check, output_file);
+        qc_mat_clear(H_A_qc);
+    } else {
+        shmcache_handle h_a;
+        t = trace_begin();
+        acquire_parity_check_matrix(&C_A, h_a_seed, &h_a);
+        trace_end("verify.expand_H_A", t);
+        valid = verify_signature(&ws, message, msg_len, envelope.salt, envelope.header->salt_len,
+                                 &envelope.signature, F, &h_a.M, full_check, output_file);
+        shmcache_release(&h_a);
+    }
+    verify_workspace_clear(&ws);
+
+    if (dump_enabled(DUMP_SUMMARY)) pkstore_print_stats(output_file, keys);
+    print_memory_stats(output_file);
+
+    pkstore_release(keys, F);
+    envelope_close(&envelope);
+    fclose(output_file); free(msg);
+    return valid ? 0 : 1;
+}
+
+int bch_catalogue(int argc, char *argv[]) {
+    int m = 0, t = 0;
+    bool self_test = false;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+            m = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            t = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--self-test") == 0) {
+            self_test = true;
+        } else {
+            fprintf(stderr, "Usage: bch-table [-m m] [-t t --self-test]\n");
+            return 1;
+        }
+    }
+
+    if (self_test) {
+        if (m < 1 || t < 1) {
+            fprintf(stderr, "bch-table --self-test needs both -m and -t\n");
+            return 1;
+        }
+        return bch_encoder_self_test(m, t, 64, stdout) == 0 ? 0 : 1;
+    }
+
+    return bch_print_table(stdout, m) == 0 ? 0 : 1;
+}
+
+// "a", "a:b" or "a:b:step"
+static bool parse_range(const char *arg, int *lo, int *hi, int *step) {
+    int a, b, c;
+    int fields = sscanf(arg, "%d:%d:%d", &a, &b, &c);
+    if (fields < 1) return false;
+    *lo = a;
+    *hi = fields >= 2 ? b : a;
+    if (step) *step = fields == 3 ? c : 1;
+    else if (fields == 3) return false;
+    return *lo <= *hi && (!step || *step > 0);
+}
 
-    get_or_generate_matrix_with_seed("H", C_A.n, C_A.k, C_A.d, H_A,
-                                     NULL, generate_parity_check_matrix_from_seed,
-                                     output_file, false, true, NULL);
+int sweep(int argc, char *argv[]) {
+    sweep_options opts;
+    sweep_default_options(&opts);
+    bool ok = true;
 
-    char path[MAX_FILENAME_LENGTH]; 
-    snprintf(path, sizeof(path), "%s/salt.txt", OUTPUT_DIR);
-    unsigned char *salt = (unsigned char *) read_file(path);
+    for (int i = 1; i < argc && ok; ++i) {
+        if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+            ok = parse_range(argv[++i], &opts.m_min, &opts.m_max, NULL);
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            ok = parse_range(argv[++i], &opts.t_min, &opts.t_max, &opts.t_step);
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            opts.reps = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--timeout") == 0 && i + 1 < argc) {
+            opts.timeout = (unsigned) atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--max-attempts") == 0 && i + 1 < argc) {
+            opts.max_attempts = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--min-n") == 0 && i + 1 < argc) {
+            opts.min_n = (uint32_t) strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--min-d") == 0 && i + 1 < argc) {
+            opts.min_d = (uint32_t) strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--quasi-cyclic") == 0) {
+            opts.quasi_cyclic = true;
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            opts.out_dir = argv[++i];
+        } else {
+            ok = false;
+        }
+    }
 
-    snprintf(path, sizeof(path), "%s/public_key.txt", OUTPUT_DIR);
-    if (!load_matrix(path, F)) {
-        fprintf(stderr, "Error: Could not load F matrix (public key) from cache.\n");
+    if (!ok || opts.m_min < 2 || opts.m_max > 20 || opts.t_min < 1 || opts.reps < 1) {
+        fprintf(stderr, "Usage: sweep [-m lo:hi] [-t lo:hi[:step]] [-r reps] [--timeout s] [--max-attempts n]\n"
+                        "             [--min-n n_A] [--min-d d_A] [--quasi-cyclic] [-o dir]\n");
         return 1;
     }
 
-    verify_signature(message, msg_len, salt, SALT_LEN, C_A.n, signature, F, C_A, H_A, output_file);
+    return sweep_run(&opts);
+}
 
-    nmod_mat_clear(H_A); nmod_mat_clear(F);
-    nmod_mat_clear(signature);
-    fclose(output_file); free(msg); free(salt);
-    return 0;
-}
\ No newline at end of file
+// Comma-separated message sizes in bytes
+static bool parse_sizes(char *arg, loadgen_options *opts) {
+    opts->num_sizes = 0;
+    for (char *tok = strtok(arg, ","); tok; tok = strtok(NULL, ",")) {
+        char *end;
+        unsigned long size = strtoul(tok, &end, 10);
+        if (*end || opts->num_sizes == LOADGEN_MAX_SIZES) return false;
+        opts->sizes[opts->num_sizes++] = size;
+    }
+    return opts->num_sizes > 0;
+}
+
+int loadgen(int argc, char *argv[]) {
+    loadgen_options opts;
+    loadgen_default_options(&opts);
+    bool ok = true;
+
+    for (int i = 1; i < argc && ok; ++i) {
+        if (strcmp(argv[i], "--op") == 0 && i + 1 < argc) {
+            const char *op = argv[++i];
+            if (strcmp(op, "sign") == 0) opts.op = LOADGEN_SIGN;
+            else if (strcmp(op, "verify") == 0) opts.op = LOADGEN_VERIFY;
+            else if (strcmp(op, "both") == 0) opts.op = LOADGEN_BOTH;
+            else ok = false;
+        } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            // A bare range doubles the thread count; an explicit step is linear
+            const char *arg = argv[++i];
+            ok = parse_range(arg, &opts.threads_min, &opts.threads_max, &opts.threads_step);
+            if (ok && strchr(arg, ':') == strrchr(arg, ':')) opts.threads_step = 0;
+        } else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc) {
+            opts.rate = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            opts.duration = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+            opts.warmup = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--sizes") == 0 && i + 1 < argc) {
+            ok = parse_sizes(argv[++i], &opts);
+        } else if (strcmp(argv[i], "--pool") == 0 && i + 1 < argc) {
+            opts.pool = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--tenants") == 0 && i + 1 < argc) {
+            // <name>:<count>, the key sets keystore add <name> --count <count> created
+            char *arg = argv[++i], *colon = strrchr(arg, ':');
+            ok = colon && colon != arg;
+            if (ok) {
+                *colon = '\0';
+                opts.tenant_prefix = arg;
+                opts.tenants = atoi(colon + 1);
+            }
+        } else if (strcmp(argv[i], "--grow") == 0 && i + 1 < argc) {
+            opts.grow = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            opts.out_dir = argv[++i];
+        } else {
+            ok = false;
+        }
+    }
+
+    if (!ok || opts.threads_min < 1 || opts.rate < 0 || opts.duration <= 0 || opts.warmup < 0 || opts.pool < 1 ||
+        (opts.tenant_prefix && opts.tenants < 1) || opts.grow < 0 || (opts.grow && !opts.tenants)) {
+        fprintf(stderr, "Usage: loadgen [--op sign|verify|both] [-c lo:hi[:step]] [--rate req/s] [-d seconds]\n"
+                        "               [--warmup seconds] [--sizes b1,b2,...] [--pool n]\n"
+                        "               [--tenants name:count [--grow n]] [-o dir]\n");
+        return 1;
+    }
+
+    return loadgen_run(&opts);
+}
+
+int keystore_command(int argc, char *argv[]) {
+    const char *action = argc > 1 ? argv[1] : "";
+    const char *name = argc > 2 ? argv[2] : NULL;
+    long count = 0;
+    bool ok = true;
+
+    for (int i = 3; i < argc && ok; ++i) {
+        if (strcmp(argv[i], "--count") == 0 && i + 1 < argc) {
+            count = atol(argv[++i]);
+            ok = count > 0;
+        } else {
+            ok = false;
+        }
+    }
+    bool add = strcmp(action, "add") == 0, show = strcmp(action, "show") == 0;
+    if (!ok || ((add || show) && !name) || (!add && !show && strcmp(action, "stats") != 0) || (show && count)) {
+        fprintf(stderr, "Usage: keystore add <name> [--count n]\n"
+                        "       keystore show <name>\n"
+                        "       keystore stats\n");
+        return 1;
+    }
+
+    if (add) {
+        // New key sets take the parameters in params.txt, with fresh seeds
+        struct code C_A, C1, C2;
+        if (!load_params(&C_A, &C1, &C2)) return 1;
+        keystore *ks = keystore_open(KEYSTORE_DIR, true);
+        if (!ks) return 1;
+
+        long added = 0;
+        for (long i = 0; i < (count ? count : 1); ++i) {
+            char key_name[KEYSTORE_NAME_SIZE + 32];
+            if (count) snprintf(key_name, sizeof(key_name), "%s-%ld", name, i);
+            else snprintf(key_name, sizeof(key_name), "%s", name);
+
+            keystore_keyset key;
+            if (!keystore_keyset_init(&key, key_name, &C_A, &C1, &C2) || !keystore_add(ks, &key)) break;
+            ++added;
+        }
+        printf("Added %ld key set%s to %s\n", added, added == 1 ? "" : "s", KEYSTORE_DIR);
+        keystore_print_stats(stdout, ks);
+        keystore_close(ks);
+        return added == (count ? count : 1) ? 0 : 1;
+    }
+
+    keystore *ks = keystore_open(KEYSTORE_DIR, false);
+    if (!ks) return 1;
+    if (show) {
+        keystore_keyset key;
+        ok = keystore_find(ks, name, &key);
+        if (ok) {
+            unsigned char id[KEYSTORE_ID_SIZE];
+            char hex[2 * KEYSTORE_ID_SIZE + 1];
+            keystore_key_id(name, id);
+            sodium_bin2hex(hex, sizeof(hex), id, KEYSTORE_ID_SIZE);
+            // Seeds are the private key and are not printed
+            printf("%s\n  id   %s\n  H_A  n=%lu k=%lu d=%lu%s\n  G1   n=%lu k=%lu d=%lu\n  G2   n=%lu k=%lu d=%lu\n",
+                   key.name, hex, key.C_A.n, key.C_A.k, key.C_A.d, key.C_A.quasi_cyclic ? " quasi-cyclic" : "",
+                   key.C1.n, key.C1.k, key.C1.d, key.C2.n, key.C2.k, key.C2.d);
+        } else {
+            fprintf(stderr, "No key %s in %s\n", name, KEYSTORE_DIR);
+        }
+    } else {
+        keystore_print_stats(stdout, ks);
+    }
+    keystore_close(ks);
+    return ok ? 0 : 1;
+}
@@ -2,29 +2,14 @@
 #include <sodium.h>
 #include <flint/flint.h>
 #include <flint/nmod_mat.h>
+#include "dump.h"
 
 void print_matrix(FILE *fp, nmod_mat_t matrix) {
-    fprintf(fp, "<%ld x %ld matrix>\n", matrix->r, matrix->c);
-    for (int i = 0; i < matrix->r; i++) {
-        fprintf(fp, "[ ");
-        for (int j = 0; j < matrix->c; j++) {
-            fprintf(fp, "%ld ", nmod_mat_get_entry(matrix, i, j));
-        }
-        fprintf(fp, "]");
-        fprintf(fp, "\n");
-    }
+    dump_nmod_mat(fp, matrix, false);
 }
 
 void print_matrix_transpose(FILE *fp, nmod_mat_t matrix) {
-    fprintf(fp, "<%ld x %ld matrix transpose>\n", matrix->r, matrix->c);
-    for (int i = 0; i < matrix->c; i++) {  
-        fprintf(fp, "[ ");
-        for (int j = 0; j < matrix->r; j++) {  
-            fprintf(fp, "%ld ", nmod_mat_get_entry(matrix, j, i));  
-        }
-        fprintf(fp, "]");
-        fprintf(fp, "\n");
-    }
+    dump_nmod_mat(fp, matrix, true);
 }
 
 void transpose_matrix(int rows, int cols, int matrix[rows][cols], int transpose[cols][rows]) {
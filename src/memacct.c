@@ -0,0 +1,127 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include "memacct.h"
+
+static const char *subsystem_names[MEM_SUBSYSTEMS] = {
+    "matrices", "seed buffers", "BCH temporaries", "message buffers", "scratch"
+};
+
+static struct {
+    pthread_mutex_t lock;
+    memacct_stats stats;
+} ma = {PTHREAD_MUTEX_INITIALIZER};
+
+void memacct_init(void)
+{
+    const char *env = getenv("SIG_MEM_BUDGET");
+    if (!env || !*env) return;
+
+    size_t bytes;
+    if (memacct_parse_size(env, &bytes)) memacct_set_budget(bytes);
+    else fprintf(stderr, "Ignoring SIG_MEM_BUDGET=%s, expected bytes with an optional K, M or G suffix\n", env);
+}
+
+bool memacct_parse_size(const char *arg, size_t *bytes)
+{
+    char *end;
+    unsigned long long value = strtoull(arg, &end, 10);
+    if (end == arg || *arg == '-') return false;
+
+    int shift = 0;
+    switch (*end) {
+    case 'k': case 'K': shift = 10; break;
+    case 'm': case 'M': shift = 20; break;
+    case 'g': case 'G': shift = 30; break;
+    case '\0': break;
+    default: return false;
+    }
+    if (shift && *++end) return false;
+    if (value > (SIZE_MAX >> shift)) return false;
+
+    *bytes = (size_t) value << shift;
+    return true;
+}
+
+void memacct_set_budget(size_t bytes)
+{
+    pthread_mutex_lock(&ma.lock);
+    ma.stats.budget = bytes;
+    pthread_mutex_unlock(&ma.lock);
+}
+
+size_t memacct_budget(void)
+{
+    pthread_mutex_lock(&ma.lock);
+    size_t budget = ma.stats.budget;
+    pthread_mutex_unlock(&ma.lock);
+    return budget;
+}
+
+// Caller holds the lock
+static bool within_budget(size_t bytes)
+{
+    const memacct_stats *s = &ma.stats;
+    return !s->budget || (s->total <= s->budget && bytes <= s->budget - s->total);
+}
+
+bool memacct_fits(size_t bytes)
+{
+    pthread_mutex_lock(&ma.lock);
+    bool fits = within_budget(bytes);
+    pthread_mutex_unlock(&ma.lock);
+    return fits;
+}
+
+bool memacct_charge(mem_subsystem s, size_t bytes, const char *what)
+{
+    memacct_stats *st = &ma.stats;
+    pthread_mutex_lock(&ma.lock);
+    if (!within_budget(bytes)) {
+        size_t total = st->total, budget = st->budget;
+        pthread_mutex_unlock(&ma.lock);
+        fprintf(stderr, "Memory budget of %zu bytes exceeded: %s needs %zu bytes with %zu already in use\n",
+                budget, what, bytes, total);
+        return false;
+    }
+    st->live[s] += bytes;
+    st->total += bytes;
+    if (st->live[s] > st->peak[s]) st->peak[s] = st->live[s];
+    if (st->total > st->total_peak) st->total_peak = st->total;
+    pthread_mutex_unlock(&ma.lock);
+    return true;
+}
+
+void memacct_release(mem_subsystem s, size_t bytes)
+{
+    pthread_mutex_lock(&ma.lock);
+    ma.stats.live[s] -= bytes;
+    ma.stats.total -= bytes;
+    pthread_mutex_unlock(&ma.lock);
+}
+
+void memacct_get_stats(memacct_stats *stats)
+{
+    pthread_mutex_lock(&ma.lock);
+    *stats = ma.stats;
+    pthread_mutex_unlock(&ma.lock);
+
+    // ru_maxrss is in KiB on Linux
+    struct rusage usage;
+    stats->peak_rss = getrusage(RUSAGE_SELF, &usage) == 0 ? (size_t) usage.ru_maxrss * 1024 : 0;
+}
+
+void memacct_print_stats(FILE *fp)
+{
+    memacct_stats s;
+    memacct_get_stats(&s);
+    fprintf(fp, "\nMemory by subsystem (live bytes / peak bytes):\n");
+    for (int i = 0; i < MEM_SUBSYSTEMS; ++i) {
+        fprintf(fp, "  %-24s %12zu %12zu\n", subsystem_names[i], s.live[i], s.peak[i]);
+    }
+    fprintf(fp, "  %-24s %12zu %12zu\n", "total", s.total, s.total_peak);
+    if (s.budget) fprintf(fp, "  %-24s %12zu\n", "budget", s.budget);
+    else fprintf(fp, "  %-24s %12s\n", "budget", "none");
+    fprintf(fp, "  %-24s %12zu\n", "peak RSS", s.peak_rss);
+}
@@ -0,0 +1,87 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "parallel.h"
+#include "perfctr.h"
+
+#define MAX_THREADS 256
+
+typedef struct {
+    parallel_body body;
+    void *ctx;
+    size_t begin, end;
+    uint64_t perf[PERF_NUM_COUNTERS];   /* counted by a worker thread, credited to the caller */
+} parallel_task;
+
+// Number of worker threads, SIG_THREADS overrides the online core count
+int parallel_num_threads(void) {
+    const char *env = getenv("SIG_THREADS");
+    long n = env ? atol(env) : sysconf(_SC_NPROCESSORS_ONLN);
+    if (n < 1) n = 1;
+    if (n > MAX_THREADS) n = MAX_THREADS;
+    return (int) n;
+}
+
+static void *parallel_task_run(void *arg) {
+    parallel_task *task = (parallel_task *) arg;
+    task->body(task->ctx, task->begin, task->end);
+    return NULL;
+}
+
+// As parallel_task_run, on a worker thread: records its hardware counts for the caller
+static void *parallel_worker_run(void *arg) {
+    parallel_task *task = (parallel_task *) arg;
+    uint64_t start[PERF_NUM_COUNTERS];
+    bool counted = perf_available() && perf_read(start);
+    parallel_task_run(task);
+    if (counted) perf_since(start, task->perf);
+    return NULL;
+}
+
+size_t parallel_num_chunks(size_t count, size_t min_chunk) {
+    if (count == 0) return 0;
+    if (min_chunk == 0) min_chunk = 1;
+    size_t threads = (size_t) parallel_num_threads();
+    if (threads > count / min_chunk) threads = count / min_chunk;
+    return threads > 1 ? threads : 1;
+}
+
+/* Splits [0, count) into contiguous chunks of at least min_chunk items, one per thread.
+   The calling thread runs the first chunk itself; falls back to serial execution
+   if threads cannot be created. With hardware counters open, each worker's counts
+   are credited to the calling thread once it is joined. */
+void parallel_for(size_t count, size_t min_chunk, parallel_body body, void *ctx) {
+    size_t threads = parallel_num_chunks(count, min_chunk);
+    if (threads == 0) return;
+    if (threads == 1) {
+        body(ctx, 0, count);
+        return;
+    }
+
+    parallel_task tasks[MAX_THREADS];
+    pthread_t ids[MAX_THREADS];
+    int started[MAX_THREADS] = {0};
+
+    size_t chunk = count / threads, extra = count % threads, begin = 0;
+    for (size_t i = 0; i < threads; ++i) {
+        size_t len = chunk + (i < extra ? 1 : 0);
+        tasks[i] = (parallel_task) {body, ctx, begin, begin + len};
+        for (int k = 0; k < PERF_NUM_COUNTERS; ++k) tasks[i].perf[k] = PERF_UNAVAILABLE;
+        begin += len;
+    }
+
+    for (size_t i = 1; i < threads; ++i) {
+        started[i] = pthread_create(&ids[i], NULL, parallel_worker_run, &tasks[i]) == 0;
+        if (!started[i]) {
+            parallel_task_run(&tasks[i]);
+        }
+    }
+    parallel_task_run(&tasks[0]);
+
+    for (size_t i = 1; i < threads; ++i) {
+        if (!started[i]) continue;
+        pthread_join(ids[i], NULL);
+        perf_credit(tasks[i].perf);
+    }
+}
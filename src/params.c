@@ -3,7 +3,10 @@
 #include <string.h>
 #include <sodium.h>
 #include <stdint.h>
+#include <flint/nmod_mat.h>
 #include "params.h"
+#include "bch.h"
+#include "rng.h"
 #include "constants.h"
 
 static Params G1, G2, H_A;
@@ -18,7 +21,7 @@ void init_params(void) {
 }
 
 uint32_t random_range(uint32_t min, uint32_t max) {
-    return min + randombytes_uniform(max - min + 1);
+    return min + rng_uniform(max - min + 1);
 }
 
 static void generate_random_params(Params *p) {
@@ -29,43 +32,6 @@ static void generate_random_params(Params *p) {
     } while (p->n <= p->k || p->n <= p->d);
 }
 
-static int bch_compute_k_from_mt(int m, int t, uint32_t *k_out, uint32_t *r_out) {
-    if (m < 1 || m > 31) return -1;           
-    if (t < 1) return -2;
-
-    uint32_t n = ((uint32_t)1 << m) - 1u;
-    uint32_t max_req = 2u * (uint32_t)t;
-    if (max_req >= n) return -3;              
-
-    char *covered = (char *) calloc(n, sizeof(char));
-    if (!covered) return -4;
-
-    uint32_t r = 0;
-
-    for (uint32_t a = 1; a <= max_req; ++a) {
-        uint32_t p = a % n;
-        if (covered[p]) continue;
-
-        /* walk coset starting at p: p, 2p mod n, 4p mod n, ... */
-        uint32_t cur = p;
-        uint32_t coset_size = 0;
-        do {
-            covered[cur] = 1;
-            ++coset_size;
-            cur = (cur * 2u) % n;
-        } while (cur != p);
-
-        r += coset_size;
-    }
-
-    free(covered);
-
-    uint32_t k = n - r;
-    if (k_out) *k_out = k;
-    if (r_out) *r_out = r;
-    return 0;
-}
-
 bool get_yes_no_input(const char *prompt) {
     char response[10];
     printf("%s (y/n): ", prompt);
@@ -109,6 +75,28 @@ void get_param(FILE *file, const char *format, void *param) {
     }
 }
 
+/* G1 = G2 = the narrow-sense BCH code of length 2^m - 1 correcting t errors,
+   C_A of twice that length with d_A = 2 (d1 + d2) + 1 and k_A at the
+   Gilbert-Varshamov bound. Returns false when no valid code results. */
+bool bch_code_params(unsigned int m, unsigned int t, Params *g1, Params *g2, Params *h) {
+    if (m < 2 || m > 31 || t < 1) return false;
+
+    unsigned int n = (1u << m) - 1;
+    unsigned int d = 2 * t + 1;
+    unsigned int k_out, r_out;
+    if (bch_compute_k_from_mt(m, t, &k_out, &r_out) != 0 || k_out == 0) return false;
+    unsigned int k = k_out;
+
+    g1->n = g2->n = n;
+    g1->k = g2->k = k;
+    g1->d = g2->d = d;
+
+    h->n = g1->n + g2->n;
+    h->d = 2 * (g1->d + g2->d) + 1;
+    h->k = h->n * (1 - binary_entropy((double) h->d / h->n));
+    return h->d < h->n && h->k > 0 && h->k < h->n;
+}
+
 void get_user_input(Params *g1, Params *g2, Params *h) {
     bool param_choice = false;
     FILE *param_file = fopen(PARAM_PATH, "r");
@@ -142,19 +130,10 @@ void get_user_input(Params *g1, Params *g2, Params *h) {
             exit(EXIT_FAILURE);
         }
 
-        unsigned int n = (1 << m) - 1;
-        unsigned int d = 2 * t + 1;
-        unsigned int k_out, r_out;
-        bch_compute_k_from_mt(m, t, &k_out, &r_out);
-        unsigned int k = k_out;
-
-        g1->n = g2->n = n;
-        g1->k = g2->k = k;
-        g1->d = g2->d = d;
-
-        h->n = g1->n + g2->n;
-        h->d = 2 * (g1->d + g2->d) + 1;
-        h->k = h->n * (1 - binary_entropy((double) h->d / h->n));
+        if (!bch_code_params(m, t, g1, g2, h)) {
+            fprintf(stderr, "No usable BCH code for m = %u, t = %u\n", m, t);
+            exit(EXIT_FAILURE);
+        }
     } else if (!param_choice) {
         printf("Key generation requires BCH Code parameters");
         exit(EXIT_FAILURE);
@@ -195,6 +174,7 @@ void get_user_input(Params *g1, Params *g2, Params *h) {
         fprintf(param_file, "G2_n %u\n", g2->n);
         fprintf(param_file, "G2_k %u\n", g2->k);
         fprintf(param_file, "G2_d %u\n", g2->d);
+        fprintf(param_file, "H_A_qc %u\n", h->quasi_cyclic ? 1u : 0u);
         fclose(param_file);
     }
 
@@ -210,6 +190,7 @@ void get_user_input(Params *g1, Params *g2, Params *h) {
 uint32_t get_H_A_n(void) { return H_A.n; }
 uint32_t get_H_A_k(void) { return H_A.k; }
 uint32_t get_H_A_d(void) { return H_A.d; }
+bool get_H_A_qc(void) { return H_A.quasi_cyclic; }
 uint32_t get_G1_n(void) { return G1.n; }
 uint32_t get_G1_k(void) { return G1.k; }
 uint32_t get_G1_d(void) { return G1.d; }
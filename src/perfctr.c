@@ -0,0 +1,201 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "perfctr.h"
+
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+const char *const perf_counter_names[PERF_NUM_COUNTERS] = {
+    "cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses", "dtlb_misses"
+};
+
+#ifdef __linux__
+
+static const struct {
+    uint32_t type;
+    uint64_t config;
+} perf_events[PERF_NUM_COUNTERS] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                         (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                         (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+};
+
+typedef struct {
+    int fd[PERF_NUM_COUNTERS];      // -1 where the PMU refused the event
+    int slot[PERF_NUM_COUNTERS];    // position in the group read, -1 if absent
+    int leader, nr;
+} perf_group;
+
+static bool perf_ok = false;
+static pthread_key_t perf_key;
+static pthread_once_t perf_key_once = PTHREAD_ONCE_INIT;
+static _Thread_local perf_group *perf_thread = NULL;
+static _Thread_local bool perf_tried = false;
+static _Thread_local uint64_t perf_credited[PERF_NUM_COUNTERS];
+
+static void close_group(void *arg)
+{
+    perf_group *g = arg;
+    for (int i = 0; i < PERF_NUM_COUNTERS; ++i) {
+        if (g->fd[i] >= 0) close(g->fd[i]);
+    }
+    free(g);
+}
+
+static void make_key(void)
+{
+    pthread_key_create(&perf_key, close_group);
+}
+
+// The first event that opens leads the group; *err is the first errno seen
+static perf_group *open_group(int *err)
+{
+    perf_group *g = malloc(sizeof(perf_group));
+    if (!g) return NULL;
+    g->leader = -1;
+    g->nr = 0;
+    *err = 0;
+
+    for (int i = 0; i < PERF_NUM_COUNTERS; ++i) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = perf_events[i].type;
+        attr.config = perf_events[i].config;
+        attr.disabled = g->leader < 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        int fd = (int) syscall(SYS_perf_event_open, &attr, 0, -1, g->leader, 0);
+        g->fd[i] = fd;
+        g->slot[i] = fd >= 0 ? g->nr++ : -1;
+        if (fd < 0 && !*err) *err = errno;
+        if (fd >= 0 && g->leader < 0) g->leader = fd;
+    }
+    if (g->leader < 0) {
+        free(g);
+        return NULL;
+    }
+
+    ioctl(g->leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(g->leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    return g;
+}
+
+static perf_group *thread_group(void)
+{
+    if (!perf_tried) {
+        perf_tried = true;
+        int err;
+        perf_thread = open_group(&err);
+        if (perf_thread) {
+            pthread_once(&perf_key_once, make_key);
+            pthread_setspecific(perf_key, perf_thread);
+        }
+    }
+    return perf_thread;
+}
+
+bool perf_open(void)
+{
+    if (perf_ok) return true;
+
+    pthread_once(&perf_key_once, make_key);
+    perf_tried = true;
+    int err;
+    perf_thread = open_group(&err);
+    if (!perf_thread) {
+        fprintf(stderr, "Hardware counters unavailable (%s); timing wall clock only\n", strerror(err));
+        return false;
+    }
+    pthread_setspecific(perf_key, perf_thread);
+
+    for (int i = 0; i < PERF_NUM_COUNTERS; ++i) {
+        if (perf_thread->fd[i] < 0) fprintf(stderr, "Hardware counter %s unavailable\n", perf_counter_names[i]);
+    }
+    perf_ok = true;
+    return true;
+}
+
+bool perf_available(void)
+{
+    return perf_ok;
+}
+
+bool perf_read(uint64_t counts[PERF_NUM_COUNTERS])
+{
+    for (int i = 0; i < PERF_NUM_COUNTERS; ++i) counts[i] = PERF_UNAVAILABLE;
+    if (!perf_ok) return false;
+
+    perf_group *g = thread_group();
+    if (!g) return false;
+
+    // nr, time enabled, time running, then one value per event in group order
+    uint64_t buf[3 + PERF_NUM_COUNTERS];
+    ssize_t want = (ssize_t) ((3 + g->nr) * sizeof(uint64_t));
+    if (read(g->leader, buf, sizeof(buf)) < want) return false;
+
+    uint64_t enabled = buf[1], running = buf[2];
+    if (!running) return false;     // never scheduled onto the PMU
+    for (int i = 0; i < PERF_NUM_COUNTERS; ++i) {
+        if (g->slot[i] < 0) continue;
+        uint64_t v = buf[3 + g->slot[i]];
+        counts[i] = running < enabled ? (uint64_t) ((double) v * enabled / running) : v;
+        counts[i] += perf_credited[i];
+    }
+    return true;
+}
+
+void perf_since(const uint64_t start[PERF_NUM_COUNTERS], uint64_t counts[PERF_NUM_COUNTERS])
+{
+    perf_read(counts);
+    for (int i = 0; i < PERF_NUM_COUNTERS; ++i) {
+        if (counts[i] != PERF_UNAVAILABLE && start[i] != PERF_UNAVAILABLE) counts[i] -= start[i];
+        else counts[i] = PERF_UNAVAILABLE;
+    }
+}
+
+void perf_credit(const uint64_t counts[PERF_NUM_COUNTERS])
+{
+    for (int i = 0; i < PERF_NUM_COUNTERS; ++i) {
+        if (counts[i] != PERF_UNAVAILABLE) perf_credited[i] += counts[i];
+    }
+}
+
+#else
+
+bool perf_open(void)
+{
+    fprintf(stderr, "Hardware counters need Linux perf events; timing wall clock only\n");
+    return false;
+}
+
+bool perf_available(void) { return false; }
+
+bool perf_read(uint64_t counts[PERF_NUM_COUNTERS])
+{
+    for (int i = 0; i < PERF_NUM_COUNTERS; ++i) counts[i] = PERF_UNAVAILABLE;
+    return false;
+}
+
+void perf_since(const uint64_t start[PERF_NUM_COUNTERS], uint64_t counts[PERF_NUM_COUNTERS])
+{
+    for (int i = 0; i < PERF_NUM_COUNTERS; ++i) counts[i] = PERF_UNAVAILABLE;
+}
+
+void perf_credit(const uint64_t counts[PERF_NUM_COUNTERS]) {}
+
+#endif
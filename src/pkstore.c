@@ -0,0 +1,189 @@
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "pkstore.h"
+#include "constants.h"
+
+#define PKSTORE_BUCKETS 256
+
+typedef struct pkstore_entry {
+    gf2_mat_struct F;                   /* first member, so a returned F maps back to its entry */
+    unsigned char digest[PUBKEY_DIGEST_SIZE];
+    void *map;
+    size_t map_len;
+    int refs;
+    struct pkstore_entry *lru_prev, *lru_next;
+    struct pkstore_entry *bucket_next;
+} pkstore_entry;
+
+struct pkstore {
+    pthread_mutex_t lock;
+    pkstore_entry *buckets[PKSTORE_BUCKETS];
+    pkstore_entry *lru_head, *lru_tail;   /* head is most recently used */
+    pkstore_stats stats;
+};
+
+static unsigned bucket_of(const unsigned char *digest) {
+    return digest[0] % PKSTORE_BUCKETS;
+}
+
+static void lru_unlink(pkstore *store, pkstore_entry *e) {
+    if (e->lru_prev) e->lru_prev->lru_next = e->lru_next; else store->lru_head = e->lru_next;
+    if (e->lru_next) e->lru_next->lru_prev = e->lru_prev; else store->lru_tail = e->lru_prev;
+    e->lru_prev = e->lru_next = NULL;
+}
+
+static void lru_push_front(pkstore *store, pkstore_entry *e) {
+    e->lru_prev = NULL;
+    e->lru_next = store->lru_head;
+    if (store->lru_head) store->lru_head->lru_prev = e;
+    store->lru_head = e;
+    if (!store->lru_tail) store->lru_tail = e;
+}
+
+static void entry_remove(pkstore *store, pkstore_entry *e) {
+    pkstore_entry **p = &store->buckets[bucket_of(e->digest)];
+    while (*p && *p != e) p = &(*p)->bucket_next;
+    if (*p) *p = e->bucket_next;
+
+    lru_unlink(store, e);
+    store->stats.entries--;
+    store->stats.bytes -= e->map_len;
+    pubkey_unmap(e->map, e->map_len);
+    free(e);
+}
+
+// Evicts least recently used entries that are not in use until the store fits its capacity
+static void evict(pkstore *store) {
+    pkstore_entry *e = store->lru_tail;
+    while (e && store->stats.bytes > store->stats.capacity) {
+        pkstore_entry *prev = e->lru_prev;
+        if (e->refs == 0) {
+            entry_remove(store, e);
+            store->stats.evictions++;
+        }
+        e = prev;
+    }
+}
+
+pkstore *pkstore_create(size_t capacity_bytes) {
+    pkstore *store = calloc(1, sizeof(pkstore));
+    if (!store) return NULL;
+    pthread_mutex_init(&store->lock, NULL);
+    store->stats.capacity = capacity_bytes;
+    return store;
+}
+
+void pkstore_destroy(pkstore *store) {
+    if (!store) return;
+    while (store->lru_head) entry_remove(store, store->lru_head);
+    pthread_mutex_destroy(&store->lock);
+    free(store);
+}
+
+static pkstore *shared_store;
+static pthread_once_t shared_once = PTHREAD_ONCE_INIT;
+
+static void shared_create(void) {
+    shared_store = pkstore_create(PKSTORE_CAPACITY);
+}
+
+pkstore *pkstore_shared(void) {
+    pthread_once(&shared_once, shared_create);
+    return shared_store;
+}
+
+/* Returns F for the digest, or NULL if no valid key file exists.
+   The matrix stays valid until it is handed back with pkstore_release. */
+const gf2_mat_struct *pkstore_acquire(pkstore *store, const unsigned char digest[PUBKEY_DIGEST_SIZE]) {
+    pthread_mutex_lock(&store->lock);
+
+    pkstore_entry *e = store->buckets[bucket_of(digest)];
+    while (e && memcmp(e->digest, digest, PUBKEY_DIGEST_SIZE) != 0) e = e->bucket_next;
+
+    if (e) {
+        store->stats.hits++;
+        lru_unlink(store, e);
+        lru_push_front(store, e);
+        e->refs++;
+        pthread_mutex_unlock(&store->lock);
+        return &e->F;
+    }
+    pthread_mutex_unlock(&store->lock);
+
+    // Map and check the file outside the lock, then insert unless another thread won the race
+    pkstore_entry *fresh = calloc(1, sizeof(pkstore_entry));
+    if (!fresh || !pubkey_map(digest, &fresh->F, &fresh->map, &fresh->map_len)) {
+        free(fresh);
+        pthread_mutex_lock(&store->lock);
+        store->stats.misses++;
+        pthread_mutex_unlock(&store->lock);
+        return NULL;
+    }
+    memcpy(fresh->digest, digest, PUBKEY_DIGEST_SIZE);
+
+    pthread_mutex_lock(&store->lock);
+    e = store->buckets[bucket_of(digest)];
+    while (e && memcmp(e->digest, digest, PUBKEY_DIGEST_SIZE) != 0) e = e->bucket_next;
+
+    if (e) {
+        pubkey_unmap(fresh->map, fresh->map_len);
+        free(fresh);
+        lru_unlink(store, e);
+        store->stats.hits++;
+    } else {
+        e = fresh;
+        e->bucket_next = store->buckets[bucket_of(digest)];
+        store->buckets[bucket_of(digest)] = e;
+        store->stats.entries++;
+        store->stats.bytes += e->map_len;
+        store->stats.disk_hits++;
+    }
+    lru_push_front(store, e);
+    e->refs++;
+    evict(store);
+    pthread_mutex_unlock(&store->lock);
+    return &e->F;
+}
+
+void pkstore_release(pkstore *store, const gf2_mat_struct *F) {
+    if (!F) return;
+    pkstore_entry *e = (pkstore_entry *) F;
+
+    pthread_mutex_lock(&store->lock);
+    e->refs--;
+    evict(store);
+    pthread_mutex_unlock(&store->lock);
+}
+
+/* Computes the digest of F and writes its key file unless a valid one with that
+   digest already exists; a truncated or corrupt file is replaced */
+bool pkstore_publish(const gf2_mat_t F, unsigned char digest_out[PUBKEY_DIGEST_SIZE]) {
+    pubkey_digest(F, digest_out);
+
+    gf2_mat_struct existing;
+    void *map;
+    size_t map_len;
+    if (pubkey_map(digest_out, &existing, &map, &map_len)) {
+        pubkey_unmap(map, map_len);
+        return true;
+    }
+    return pubkey_save(F, digest_out);
+}
+
+void pkstore_get_stats(pkstore *store, pkstore_stats *stats) {
+    pthread_mutex_lock(&store->lock);
+    *stats = store->stats;
+    pthread_mutex_unlock(&store->lock);
+}
+
+void pkstore_print_stats(FILE *fp, pkstore *store) {
+    pkstore_stats s;
+    pkstore_get_stats(store, &s);
+
+    unsigned long lookups = s.hits + s.disk_hits + s.misses;
+    fprintf(fp, "\nPublic key cache: %lu lookups, %lu memory hits, %lu disk hits, %lu misses, "
+                "%lu evictions, hit rate %.1f%%, %zu entries, %zu of %zu bytes\n",
+            lookups, s.hits, s.disk_hits, s.misses, s.evictions,
+            lookups ? 100.0 * s.hits / lookups : 0.0, s.entries, s.bytes, s.capacity);
+}
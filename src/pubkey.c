@@ -0,0 +1,123 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sodium.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "pubkey.h"
+#include "constants.h"
+#include "utils.h"
+#include "trace.h"
+
+_Static_assert(sizeof(pubkey_header) == 16, "pubkey_header must stay 16 bytes");
+
+static size_t packed_bytes(const gf2_mat_t F) {
+    return (size_t) (F->r * F->words) * sizeof(uint64_t);
+}
+
+void pubkey_digest(const gf2_mat_t F, unsigned char digest[PUBKEY_DIGEST_SIZE]) {
+    uint32_t dims[2] = {(uint32_t) F->r, (uint32_t) F->c};
+    crypto_hash_sha256_state state;
+    crypto_hash_sha256_init(&state);
+    crypto_hash_sha256_update(&state, (const unsigned char *) dims, sizeof(dims));
+    crypto_hash_sha256_update(&state, (const unsigned char *) F->bits, packed_bytes(F));
+    crypto_hash_sha256_final(&state, digest);
+}
+
+char *pubkey_filename(const unsigned char digest[PUBKEY_DIGEST_SIZE]) {
+    char hex[2 * PUBKEY_DIGEST_SIZE + 1];
+    sodium_bin2hex(hex, sizeof(hex), digest, PUBKEY_DIGEST_SIZE);
+
+    char *filename = malloc(MAX_FILENAME_LENGTH);
+    if (filename) {
+        snprintf(filename, MAX_FILENAME_LENGTH, "%s/%s.key", KEY_DIR, hex);
+    }
+    return filename;
+}
+
+bool pubkey_write(const char *filename, const gf2_mat_t F) {
+    char tmp_path[MAX_FILENAME_LENGTH];
+    FILE *file = open_atomic_file(filename, "wb", tmp_path);
+    if (!file) {
+        fprintf(stderr, "Error opening file for writing: %s\n", filename);
+        return false;
+    }
+
+    pubkey_header header = {{0}, (uint32_t) F->r, (uint32_t) F->c, 0};
+    memcpy(header.magic, PUBKEY_MAGIC, sizeof(header.magic));
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+              fwrite(F->bits, 1, packed_bytes(F), file) == packed_bytes(F);
+    if (ok) {
+        trace_add("io.bytes_written", sizeof(header) + packed_bytes(F));
+        ok = commit_atomic_file(file, tmp_path, filename);
+    } else {
+        discard_atomic_file(file, tmp_path);
+    }
+    return ok;
+}
+
+bool pubkey_save(const gf2_mat_t F, const unsigned char digest[PUBKEY_DIGEST_SIZE]) {
+    struct stat st = {0};
+    if (stat(KEY_DIR, &st) == -1) {
+        mkdir(KEY_DIR, 0700);
+    }
+
+    char *filename = pubkey_filename(digest);
+    if (!filename) return false;
+    bool ok = pubkey_write(filename, F);
+    free(filename);
+    return ok;
+}
+
+/* Maps a key file read-only and points F at its packed rows (no copy).
+   Files whose contents do not match the digest are rejected. */
+bool pubkey_map(const unsigned char digest[PUBKEY_DIGEST_SIZE], gf2_mat_struct *F,
+                void **map_out, size_t *map_len_out) {
+    char *filename = pubkey_filename(digest);
+    if (!filename) return false;
+
+    int fd = open(filename, O_RDONLY);
+    free(filename);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(pubkey_header)) {
+        close(fd);
+        return false;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return false;
+
+    const pubkey_header *header = (const pubkey_header *) map;
+    F->r = header->rows;
+    F->c = header->cols;
+    F->words = GF2_WORDS(F->c);
+    F->bits = (uint64_t *) ((unsigned char *) map + sizeof(pubkey_header));
+
+    bool ok = memcmp(header->magic, PUBKEY_MAGIC, sizeof(header->magic)) == 0 &&
+              (size_t) st.st_size == sizeof(pubkey_header) + packed_bytes(F);
+
+    unsigned char check[PUBKEY_DIGEST_SIZE];
+    if (ok) {
+        pubkey_digest(F, check);
+        ok = sodium_memcmp(check, digest, PUBKEY_DIGEST_SIZE) == 0;
+    }
+    if (!ok) {
+        munmap(map, st.st_size);
+        return false;
+    }
+
+    *map_out = map;
+    *map_len_out = st.st_size;
+    trace_add("io.bytes_read", st.st_size);
+    return true;
+}
+
+void pubkey_unmap(void *map, size_t map_len) {
+    if (map) munmap(map, map_len);
+}
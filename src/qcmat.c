@@ -0,0 +1,109 @@
+#include <stdlib.h>
+#include <string.h>
+#include "qcmat.h"
+#include "gf2x.h"
+
+void qc_mat_init(qc_mat_t H, slong r, slong c) {
+    H->r = r;
+    H->c = c;
+    H->blocks = (c + r - 1) / r;
+    gf2_mat_init(&H->h, H->blocks, r);
+}
+
+void qc_mat_clear(qc_mat_t H) {
+    gf2_mat_clear(&H->h);
+}
+
+// dst (GF2_WORDS(nbits) words) = bits [offset, offset + nbits) of src
+static void extract_bits(uint64_t *dst, const uint64_t *src, slong offset, slong nbits) {
+    slong words = GF2_WORDS(nbits), ws = offset / 64, bs = offset % 64;
+    slong src_end = GF2_WORDS(offset + nbits);
+
+    for (slong i = 0; i < words; ++i) {
+        uint64_t w = src[ws + i] >> bs;
+        if (bs && ws + i + 1 < src_end) w |= src[ws + i + 1] << (64 - bs);
+        dst[i] = w;
+    }
+    if (nbits % 64) dst[words - 1] &= (UINT64_C(1) << (nbits % 64)) - 1;
+}
+
+typedef struct {
+    slong words;
+    uint64_t *segment;   /* v_j(x) */
+    uint64_t *product;   /* h_j(x) v_j(x), 2 words per word of r */
+    uint64_t *acc;       /* unreduced sum of the products */
+    uint64_t *high;
+    uint64_t *tmp;       /* Karatsuba scratch */
+} qc_scratch;
+
+static void scratch_init(qc_scratch *s, slong r, arena_t arena) {
+    s->words = GF2_WORDS(r);
+    s->segment = (uint64_t *) arena_calloc(arena, 6 * s->words, sizeof(uint64_t));
+    s->product = s->segment + s->words;
+    s->acc = s->product + 2 * s->words;
+    s->high = s->acc + 2 * s->words;
+    s->tmp = (uint64_t *) arena_alloc(arena, gf2x_mul_scratch_words(s->words, s->words) * sizeof(uint64_t));
+}
+
+static void syndrome_with(uint64_t *out, const qc_mat_t H, const uint64_t *v, qc_scratch *s) {
+    slong r = H->r;
+    memset(s->acc, 0, 2 * s->words * sizeof(uint64_t));
+
+    // The reduction mod x^r - 1 is linear, so the products are summed first and folded once
+    for (slong j = 0; j < H->blocks; ++j) {
+        slong len = (j + 1) * r <= H->c ? r : H->c - j * r;
+        extract_bits(s->segment, v, j * r, len);
+        if (len < r) memset(s->segment + GF2_WORDS(len), 0, (s->words - GF2_WORDS(len)) * sizeof(uint64_t));
+
+        uint64_t any = 0;
+        for (slong w = 0; w < s->words; ++w) any |= s->segment[w];
+        if (!any) continue;
+
+        gf2x_mul_words_tmp(s->product, gf2_mat_row(&H->h, j), s->words, s->segment, s->words, s->tmp);
+        for (slong w = 0; w < 2 * s->words; ++w) s->acc[w] ^= s->product[w];
+    }
+
+    // x^(r + i) = x^i mod x^r - 1: fold the coefficients from r upwards onto the low ones
+    extract_bits(s->high, s->acc, r, r);
+    for (slong w = 0; w < s->words; ++w) out[w] = s->acc[w] ^ s->high[w];
+    if (r % 64) out[s->words - 1] &= (UINT64_C(1) << (r % 64)) - 1;
+}
+
+void qc_mat_syndrome_arena(uint64_t *out, const qc_mat_t H, const uint64_t *v, arena_t arena) {
+    arena_mark mark = arena_save(arena);
+    qc_scratch s;
+    scratch_init(&s, H->r, arena);
+    syndrome_with(out, H, v, &s);
+    arena_restore(arena, mark);
+}
+
+void qc_mat_syndrome(uint64_t *out, const qc_mat_t H, const uint64_t *v) {
+    arena_t arena;
+    arena_init(arena, 0);
+    qc_mat_syndrome_arena(out, H, v, arena);
+    arena_clear(arena);
+}
+
+void qc_mat_mul_transpose_arena(gf2_mat_t F, const qc_mat_t H, const gf2_mat_t G, arena_t arena) {
+    arena_mark mark = arena_save(arena);
+    qc_scratch s;
+    scratch_init(&s, H->r, arena);
+    uint64_t *column = (uint64_t *) arena_alloc(arena, s.words * sizeof(uint64_t));
+
+    gf2_mat_zero(F);
+    for (slong i = 0; i < G->r; ++i) {
+        syndrome_with(column, H, gf2_mat_row(G, i), &s);
+        for (slong row = 0; row < H->r; ++row) {
+            if ((column[row / 64] >> (row % 64)) & 1) gf2_mat_row(F, row)[i / 64] |= UINT64_C(1) << (i % 64);
+        }
+    }
+
+    arena_restore(arena, mark);
+}
+
+void qc_mat_mul_transpose(gf2_mat_t F, const qc_mat_t H, const gf2_mat_t G) {
+    arena_t arena;
+    arena_init(arena, 0);
+    qc_mat_mul_transpose_arena(F, H, G, arena);
+    arena_clear(arena);
+}
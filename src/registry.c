@@ -0,0 +1,140 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "registry.h"
+#include "keygen.h"
+#include "utils.h"
+#include "memacct.h"
+
+typedef struct registry_entry {
+    nmod_mat_struct M;      /* first member, so a returned matrix maps back to its entry */
+    char prefix[8];
+    int n, k, d;
+    bool seeded;
+    unsigned char seed[SEED_SIZE];
+    int refs;
+    bool loading;           /* placeholder, M is being filled outside the lock */
+    bool failed;            /* could not be loaded; freed by the last holder */
+    struct registry_entry *next;
+} registry_entry;
+
+static pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t registry_loaded = PTHREAD_COND_INITIALIZER;
+static registry_entry *registry_head = NULL;
+
+static registry_entry *find_entry(const char *prefix, int n, int k, int d,
+                                  bool seeded, const unsigned char *seed) {
+    for (registry_entry *e = registry_head; e; e = e->next) {
+        if (e->n == n && e->k == k && e->d == d && e->seeded == seeded &&
+            strcmp(e->prefix, prefix) == 0 &&
+            (!seeded || memcmp(e->seed, seed, SEED_SIZE) == 0)) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+// Entries are full nmod matrices, a limb per bit
+static size_t entry_bytes(const registry_entry *e) {
+    return (size_t) e->k * e->n * sizeof(mp_limb_t);
+}
+
+static void unlink_entry(registry_entry *e) {
+    registry_entry **p = &registry_head;
+    while (*p && *p != e) p = &(*p)->next;
+    if (*p) *p = e->next;
+}
+
+// Caller holds the lock; drops a reference to an entry that failed to load
+static void drop_failed(registry_entry *e) {
+    if (--e->refs == 0) free(e);
+}
+
+/* Returns the shared matrix for the cache entry, loading it on first use: from the
+   seed file in seed mode (creating the seed if missing), otherwise from the text
+   cache. Returns NULL if the entry cannot be loaded.
+   The first acquirer inserts a placeholder and fills it without holding the lock,
+   so acquirers of other entries are not held up; acquirers of the same entry wait
+   for it to be filled. */
+const nmod_mat_struct *registry_acquire(const char *prefix, int n, int k, int d,
+                                        bool use_seed_mode, registry_seed_func generate_from_seed_func) {
+    unsigned char seed[SEED_SIZE];
+    if (use_seed_mode && !get_or_generate_seed(prefix, n, k, d, false, seed)) return NULL;
+
+    pthread_mutex_lock(&registry_lock);
+
+    registry_entry *e = find_entry(prefix, n, k, d, use_seed_mode, seed);
+    if (e) {
+        e->refs++;
+        while (e->loading) pthread_cond_wait(&registry_loaded, &registry_lock);
+        if (e->failed) {
+            drop_failed(e);
+            e = NULL;
+        }
+        pthread_mutex_unlock(&registry_lock);
+        return e ? &e->M : NULL;
+    }
+
+    e = calloc(1, sizeof(registry_entry));
+    if (!e) {
+        pthread_mutex_unlock(&registry_lock);
+        return NULL;
+    }
+    snprintf(e->prefix, sizeof(e->prefix), "%s", prefix);
+    e->n = n; e->k = k; e->d = d;
+    e->seeded = use_seed_mode;
+    if (use_seed_mode) memcpy(e->seed, seed, SEED_SIZE);
+    e->refs = 1;
+    if (!memacct_charge(MEM_MATRICES, entry_bytes(e), "cached matrix")) {
+        free(e);
+        pthread_mutex_unlock(&registry_lock);
+        return NULL;
+    }
+    e->loading = true;
+    e->next = registry_head;
+    registry_head = e;
+    pthread_mutex_unlock(&registry_lock);
+
+    nmod_mat_init(&e->M, k, n, MOD);
+    bool loaded = true;
+    if (use_seed_mode) {
+        generate_from_seed_func(n, k, d, &e->M, seed, NULL);
+    } else {
+        char *filename = generate_matrix_filename(prefix, n, k, d);
+        loaded = filename && load_matrix(filename, &e->M);
+        free(filename);
+    }
+    if (!loaded) {
+        memacct_release(MEM_MATRICES, entry_bytes(e));
+        nmod_mat_clear(&e->M);
+    }
+
+    pthread_mutex_lock(&registry_lock);
+    e->loading = false;
+    if (!loaded) {
+        e->failed = true;
+        unlink_entry(e);
+        drop_failed(e);
+    }
+    pthread_cond_broadcast(&registry_loaded);
+    pthread_mutex_unlock(&registry_lock);
+    return loaded ? &e->M : NULL;
+}
+
+// The last holder frees the entry; the next acquirer loads it again
+void registry_release(const nmod_mat_struct *M) {
+    if (!M) return;
+    registry_entry *e = (registry_entry *) M;
+
+    pthread_mutex_lock(&registry_lock);
+    bool last = --e->refs == 0;
+    if (last) unlink_entry(e);
+    pthread_mutex_unlock(&registry_lock);
+
+    if (last) {
+        nmod_mat_clear(&e->M);
+        memacct_release(MEM_MATRICES, entry_bytes(e));
+        free(e);
+    }
+}
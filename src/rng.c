@@ -0,0 +1,152 @@
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <sodium.h>
+#include "rng.h"
+
+#define RNG_KEY_SIZE crypto_stream_chacha20_KEYBYTES
+
+typedef struct {
+    unsigned char key[RNG_KEY_SIZE];
+    uint64_t nonce;
+    unsigned long generation;
+    size_t pos;
+    bool seeded;
+    unsigned char pool[RNG_POOL_SIZE];
+} rng_state;
+
+static _Thread_local rng_state state;
+
+/* Bumped in the child after fork() so a forked process never replays its parent's pool */
+static volatile unsigned long fork_generation = 0;
+static pthread_once_t atfork_once = PTHREAD_ONCE_INIT;
+
+static void rng_on_fork_child(void) {
+    ++fork_generation;
+}
+
+static void rng_register_atfork(void) {
+    pthread_atfork(NULL, NULL, rng_on_fork_child);
+}
+
+static void rng_stream(unsigned char *out, size_t len) {
+    unsigned char nonce[crypto_stream_chacha20_NONCEBYTES];
+    uint64_t ctr = state.nonce++;
+    for (size_t i = 0; i < sizeof(nonce); ++i) {
+        nonce[i] = (unsigned char)(ctr >> (8 * i));
+    }
+    crypto_stream_chacha20(out, len, nonce, state.key);
+}
+
+static void rng_seed(void) {
+    pthread_once(&atfork_once, rng_register_atfork);
+    randombytes_buf(state.key, RNG_KEY_SIZE);
+    state.nonce = 0;
+    state.generation = fork_generation;
+    state.pos = RNG_POOL_SIZE;
+    state.seeded = true;
+}
+
+void rng_set_seed(const unsigned char seed[RNG_SEED_SIZE]) {
+    pthread_once(&atfork_once, rng_register_atfork);
+    memcpy(state.key, seed, RNG_KEY_SIZE);
+    state.nonce = 0;
+    state.generation = fork_generation;
+    state.pos = RNG_POOL_SIZE;
+    state.seeded = true;
+}
+
+/* Refill the pool; the first RNG_KEY_SIZE bytes of each block become the next key
+   (fast key erasure), so earlier output cannot be recomputed from a later state. */
+static void rng_refill(void) {
+    if (!state.seeded || state.generation != fork_generation) {
+        rng_seed();
+    }
+    rng_stream(state.pool, RNG_POOL_SIZE);
+    memcpy(state.key, state.pool, RNG_KEY_SIZE);
+    sodium_memzero(state.pool, RNG_KEY_SIZE);
+    state.pos = RNG_KEY_SIZE;
+}
+
+void rng_bytes(void *buf, size_t len) {
+    unsigned char *out = (unsigned char *) buf;
+
+    if (!state.seeded || state.generation != fork_generation) {
+        rng_seed();
+    }
+
+    // Large requests bypass the pool and are streamed straight into the output
+    if (len >= RNG_POOL_SIZE) {
+        rng_stream(out, len);
+        rng_refill();
+        return;
+    }
+
+    while (len > 0) {
+        if (state.pos == RNG_POOL_SIZE) {
+            rng_refill();
+        }
+        size_t avail = RNG_POOL_SIZE - state.pos;
+        size_t take = len < avail ? len : avail;
+        memcpy(out, state.pool + state.pos, take);
+        sodium_memzero(state.pool + state.pos, take);
+        state.pos += take;
+        out += take;
+        len -= take;
+    }
+}
+
+uint32_t rng_u32(void) {
+    uint32_t v;
+    rng_bytes(&v, sizeof(v));
+    return v;
+}
+
+uint64_t rng_u64(void) {
+    uint64_t v;
+    rng_bytes(&v, sizeof(v));
+    return v;
+}
+
+/* Unbiased integer in [0, upper_bound) using Lemire's multiply-and-reject method:
+   the rejection branch is only taken with probability < upper_bound / 2^32. */
+uint32_t rng_uniform(uint32_t upper_bound) {
+    if (upper_bound < 2) return 0;
+
+    uint64_t m = (uint64_t) rng_u32() * upper_bound;
+    uint32_t low = (uint32_t) m;
+    if (low < upper_bound) {
+        uint32_t threshold = (uint32_t) -upper_bound % upper_bound;
+        while (low < threshold) {
+            m = (uint64_t) rng_u32() * upper_bound;
+            low = (uint32_t) m;
+        }
+    }
+    return (uint32_t) (m >> 32);
+}
+
+uint64_t rng_uniform64(uint64_t upper_bound) {
+    if (upper_bound <= UINT32_MAX) return rng_uniform((uint32_t) upper_bound);
+
+    unsigned __int128 m = (unsigned __int128) rng_u64() * upper_bound;
+    uint64_t low = (uint64_t) m;
+    if (low < upper_bound) {
+        uint64_t threshold = -upper_bound % upper_bound;
+        while (low < threshold) {
+            m = (unsigned __int128) rng_u64() * upper_bound;
+            low = (uint64_t) m;
+        }
+    }
+    return (uint64_t) (m >> 64);
+}
+
+/* Fill a packed bit vector of nbits uniformly random bits, unused high bits of the last word cleared */
+void rng_bits(uint64_t *words, size_t nbits) {
+    size_t nwords = (nbits + 63) / 64;
+    if (nwords == 0) return;
+
+    rng_bytes(words, nwords * sizeof(uint64_t));
+    if (nbits % 64) {
+        words[nwords - 1] &= (UINT64_C(1) << (nbits % 64)) - 1;
+    }
+}
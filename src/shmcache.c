@@ -0,0 +1,301 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <sodium.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include "shmcache.h"
+#include "hugemem.h"
+#include "memacct.h"
+
+#define SHM_MAGIC "SIGSHM1"
+#define SHM_WAIT_NS 1000000L
+#define SHM_WAIT_LIMIT 30000   /* ~30 s for a new segment to be sized */
+#define SHM_DIR "/dev/shm"
+#define SHM_DEFAULT_SEGMENTS 64 /* segments kept before the least recently used are unlinked */
+
+enum { SHM_FILLING = 0, SHM_READY = 1, SHM_INVALID = 2 };
+
+typedef struct {
+    char magic[8];
+    uint64_t rows, cols, words;
+    unsigned char seed_digest[crypto_hash_sha256_BYTES];
+    _Atomic uint32_t state;
+    _Atomic uint64_t last_used;     /* seconds since the epoch, set on every publish and attach */
+} shm_header;
+
+static size_t page_size(void) {
+    long p = sysconf(_SC_PAGESIZE);
+    return p > 0 ? (size_t) p : 4096;
+}
+
+static void shm_name(char *name, size_t len, const char *prefix, int n, int k, int d,
+                     const unsigned char *seed_digest) {
+    char hex[17];
+    sodium_bin2hex(hex, sizeof(hex), seed_digest, 8);
+    snprintf(name, len, "/sig_%s_%d_%d_%d_%s", prefix, n, k, d, hex);
+}
+
+static void expand_private(slong rows, slong cols, shmcache_expand_fn expand, void *ctx,
+                           shmcache_handle *handle) {
+    gf2_mat_init(&handle->M, rows, cols);
+    expand(ctx, &handle->M);
+    handle->shared = false;
+}
+
+// SIG_SHM_SEGMENTS overrides how many segments may exist at once
+static size_t max_segments(void) {
+    const char *env = getenv("SIG_SHM_SEGMENTS");
+    long n = env ? atol(env) : SHM_DEFAULT_SEGMENTS;
+    return n > 0 ? (size_t) n : 1;
+}
+
+typedef struct {
+    char name[NAME_MAX + 2];
+    uint64_t last_used;
+} shm_segment;
+
+static int cmp_last_used(const void *a, const void *b) {
+    uint64_t x = ((const shm_segment *) a)->last_used, y = ((const shm_segment *) b)->last_used;
+    return (x > y) - (x < y);
+}
+
+// Last use of a ready segment, false for one still filling or not ours
+static bool segment_last_used(const char *name, uint64_t *last_used) {
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) return false;
+    struct stat st;
+    bool ready = false;
+    if (fstat(fd, &st) == 0 && (size_t) st.st_size >= page_size()) {
+        shm_header *h = mmap(NULL, page_size(), PROT_READ, MAP_SHARED, fd, 0);
+        if (h != MAP_FAILED) {
+            ready = memcmp(h->magic, SHM_MAGIC, sizeof(h->magic)) == 0 &&
+                    atomic_load_explicit(&h->state, memory_order_acquire) == SHM_READY;
+            *last_used = atomic_load_explicit(&h->last_used, memory_order_relaxed);
+            munmap(h, page_size());
+        }
+    }
+    close(fd);
+    return ready;
+}
+
+/* Called with a new segment just created: while there are more segments than the
+   limit, unlinks the ready one used least recently. Every tenant key has its own H_A segment, so without
+   this /dev/shm would grow with the number of keys ever used. Processes that have an
+   evicted segment mapped keep their copy; the next one to need it publishes it again. */
+static void evict_segments(void) {
+    DIR *dir = opendir(SHM_DIR);
+    if (!dir) return;
+
+    shm_segment *ready = NULL;
+    size_t total = 0, count = 0, capacity = 0;
+    struct dirent *de;
+    while ((de = readdir(dir)) != NULL) {
+        if (strncmp(de->d_name, "sig_", 4) != 0) continue;
+        ++total;
+        if (count == capacity) {
+            size_t grown = capacity ? 2 * capacity : 64;
+            shm_segment *v = realloc(ready, grown * sizeof(shm_segment));
+            if (!v) break;
+            ready = v;
+            capacity = grown;
+        }
+        shm_segment *s = &ready[count];
+        snprintf(s->name, sizeof(s->name), "/%s", de->d_name);
+        if (segment_last_used(s->name, &s->last_used)) ++count;
+    }
+    closedir(dir);
+
+    size_t limit = max_segments();
+    if (total > limit) {
+        qsort(ready, count, sizeof(shm_segment), cmp_last_used);
+        for (size_t i = 0; i < count && i < total - limit; ++i) shm_unlink(ready[i].name);
+    }
+    free(ready);
+}
+
+static bool header_matches(const shm_header *h, slong rows, slong cols, const unsigned char *digest) {
+    return memcmp(h->magic, SHM_MAGIC, sizeof(h->magic)) == 0 &&
+           h->rows == (uint64_t) rows && h->cols == (uint64_t) cols &&
+           memcmp(h->seed_digest, digest, sizeof(h->seed_digest)) == 0;
+}
+
+/* Maps an existing segment, waiting for its publisher to finish; false if unusable.
+   The publisher holds an exclusive flock while it fills the segment, so a segment
+   still filling whose lock can be taken was abandoned by a publisher that died;
+   it is unlinked and *reaped set so the caller can publish it again. A live
+   publisher is waited for however long the expansion takes. */
+static bool attach(int fd, const char *name, slong rows, slong cols, const unsigned char *digest,
+                   shmcache_handle *handle, bool *reaped) {
+    size_t header_len = page_size();
+    size_t data_len = (size_t) (rows * GF2_WORDS(cols)) * sizeof(uint64_t);
+
+    // The publisher locks before sizing, so only a crash right after creating it leaves it unsized
+    struct stat st;
+    for (int i = 0; fstat(fd, &st) == 0 && (size_t) st.st_size < header_len + data_len; ++i) {
+        if (i == SHM_WAIT_LIMIT) {
+            shm_unlink(name);
+            *reaped = true;
+            return false;
+        }
+        nanosleep(&(struct timespec) {0, SHM_WAIT_NS}, NULL);
+    }
+
+    shm_header *h = mmap(NULL, header_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (h == MAP_FAILED) return false;
+
+    uint32_t state;
+    while ((state = atomic_load_explicit(&h->state, memory_order_acquire)) == SHM_FILLING) {
+        if (flock(fd, LOCK_SH | LOCK_NB) == 0) {
+            state = atomic_load_explicit(&h->state, memory_order_acquire);
+            flock(fd, LOCK_UN);
+            if (state == SHM_FILLING) {
+                shm_unlink(name);
+                *reaped = true;
+            }
+            break;
+        }
+        nanosleep(&(struct timespec) {0, SHM_WAIT_NS}, NULL);
+    }
+    if (state != SHM_READY || !header_matches(h, rows, cols, digest)) {
+        munmap(h, header_len);
+        return false;
+    }
+
+    void *data = data_len ? mmap(NULL, data_len, PROT_READ, MAP_SHARED, fd, header_len) : NULL;
+    if (data == MAP_FAILED) {
+        munmap(h, header_len);
+        return false;
+    }
+
+    if (data) hugemem_advise(data, data_len);
+    atomic_store_explicit(&h->last_used, (uint64_t) time(NULL), memory_order_relaxed);
+    handle->header_map = h;
+    handle->data_map = data;
+    handle->data_len = data_len;
+    handle->M = (gf2_mat_struct) {rows, cols, GF2_WORDS(cols), (uint64_t *) data};
+    handle->shared = true;
+    return true;
+}
+
+// Creates, fills and publishes a new segment; fd was created exclusively by this process
+static bool publish(int fd, slong rows, slong cols, const unsigned char *digest,
+                    shmcache_expand_fn expand, void *ctx, shmcache_handle *handle) {
+    size_t header_len = page_size();
+    size_t data_len = (size_t) (rows * GF2_WORDS(cols)) * sizeof(uint64_t);
+
+    // Held until fd is closed, after the segment is marked ready or abandoned
+    if (flock(fd, LOCK_EX) != 0 || ftruncate(fd, header_len + data_len) != 0) return false;
+
+    shm_header *h = mmap(NULL, header_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (h == MAP_FAILED) return false;
+    void *data = data_len ? mmap(NULL, data_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, header_len) : NULL;
+    if (data == MAP_FAILED) {
+        munmap(h, header_len);
+        return false;
+    }
+
+    memcpy(h->magic, SHM_MAGIC, sizeof(h->magic));
+    h->rows = rows;
+    h->cols = cols;
+    h->words = GF2_WORDS(cols);
+    memcpy(h->seed_digest, digest, sizeof(h->seed_digest));
+
+    if (data) hugemem_advise(data, data_len);
+    handle->M = (gf2_mat_struct) {rows, cols, GF2_WORDS(cols), (uint64_t *) data};
+    expand(ctx, &handle->M);
+    if (data) mprotect(data, data_len, PROT_READ);
+
+    atomic_store_explicit(&h->last_used, (uint64_t) time(NULL), memory_order_relaxed);
+    atomic_store_explicit(&h->state, SHM_READY, memory_order_release);
+
+    handle->header_map = h;
+    handle->data_map = data;
+    handle->data_len = data_len;
+    handle->shared = true;
+    return true;
+}
+
+/* Fills handle with the packed rows x cols matrix for (prefix, params, seed), mapping
+   a published segment when one exists. Always succeeds; handle->shared tells whether
+   the matrix lives in shared memory or was expanded privately. */
+bool shmcache_acquire(const char *prefix, int n, int k, int d, const unsigned char seed[SEED_SIZE],
+                      slong rows, slong cols, shmcache_expand_fn expand, void *ctx,
+                      shmcache_handle *handle) {
+    memset(handle, 0, sizeof(*handle));
+
+    unsigned char digest[crypto_hash_sha256_BYTES];
+    crypto_hash_sha256(digest, seed, SEED_SIZE);
+    char name[MAX_FILENAME_LENGTH];
+    shm_name(name, sizeof(name), prefix, n, k, d, digest);
+
+    // A mapped segment counts against the budget like the private copy it stands in for
+    size_t data_len = (size_t) (rows * GF2_WORDS(cols)) * sizeof(uint64_t);
+    if (!memacct_charge(MEM_MATRICES, data_len, "shared matrix mapping")) exit(EXIT_FAILURE);
+
+    // A second pass publishes in place of a segment whose publisher died
+    bool reaped = true;
+    for (int pass = 0; pass < 2 && reaped; ++pass) {
+        reaped = false;
+        int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (fd >= 0) {
+            evict_segments();
+            bool ok = publish(fd, rows, cols, digest, expand, ctx, handle);
+            if (!ok) shm_unlink(name);
+            close(fd);
+            if (ok) return true;
+            memset(handle, 0, sizeof(*handle));
+        } else if (errno == EEXIST && (fd = shm_open(name, O_RDWR, 0600)) >= 0) {
+            bool ok = attach(fd, name, rows, cols, digest, handle, &reaped);
+            close(fd);
+            if (ok) return true;
+            memset(handle, 0, sizeof(*handle));
+        }
+    }
+
+    // gf2_mat_init charges the private copy itself
+    memacct_release(MEM_MATRICES, data_len);
+    expand_private(rows, cols, expand, ctx, handle);
+    return true;
+}
+
+void shmcache_release(shmcache_handle *handle) {
+    if (handle->shared) {
+        if (handle->data_map) munmap(handle->data_map, handle->data_len);
+        munmap(handle->header_map, page_size());
+        memacct_release(MEM_MATRICES, handle->data_len);
+    } else if (handle->M.bits) {
+        gf2_mat_clear(&handle->M);
+    }
+    memset(handle, 0, sizeof(*handle));
+}
+
+// Marks the segment for (prefix, params, seed) invalid and removes its name
+void shmcache_invalidate(const char *prefix, int n, int k, int d, const unsigned char seed[SEED_SIZE]) {
+    unsigned char digest[crypto_hash_sha256_BYTES];
+    crypto_hash_sha256(digest, seed, SEED_SIZE);
+    char name[MAX_FILENAME_LENGTH];
+    shm_name(name, sizeof(name), prefix, n, k, d, digest);
+
+    int fd = shm_open(name, O_RDWR, 0600);
+    if (fd < 0) return;
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && (size_t) st.st_size >= page_size()) {
+        shm_header *h = mmap(NULL, page_size(), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (h != MAP_FAILED) {
+            atomic_store_explicit(&h->state, SHM_INVALID, memory_order_release);
+            munmap(h, page_size());
+        }
+    }
+    close(fd);
+    shm_unlink(name);
+}
@@ -6,90 +6,342 @@
 #include "utils.h"
 #include "matrix.h"
 #include "constants.h"
+#include "rng.h"
+#include "bitperm.h"
+#include "trace.h"
+#include "dump.h"
+#include "keygen.h"
+#include "memacct.h"
 
-void generate_signature(nmod_mat_t bin_hash, const unsigned char* message, size_t message_len,
-                  struct code C_A, struct code C1, struct code C2,
-                  nmod_mat_t H_A, nmod_mat_t G1, nmod_mat_t G2,
-                  nmod_mat_t F, nmod_mat_t signature, const unsigned int salt_len, 
-                  unsigned char* salt, FILE* output_file)
+static slong max_slong(slong a, slong b) { return a > b ? a : b; }
+
+static slong min_slong(slong a, slong b) { return a < b ? a : b; }
+
+void sign_workspace_init(sign_workspace *ws, const struct code *C_A,
+                         const struct code *C1, const struct code *C2)
 {
-    unsigned long *J = malloc(C1.n * sizeof(unsigned long));
-    generate_random_set(C_A.n, C1.n, J);
+    ws->C_A = *C_A;
+    ws->C1 = *C1;
+    ws->C2 = *C2;
+    ws->message_len = C1->k;
+    ws->attempts = 0;
+    ws->max_attempts = 0;
 
-    if (PRINT) {
-        fprintf(output_file, "\nRandom permutation: ");
-        for (int i = 0; i < C1.n; ++i) {
-            fprintf(output_file, "%lu ", J[i]);
+    if (!memacct_charge(MEM_SCRATCH, (C_A->n + C1->n) * sizeof(unsigned long), "signing positions") ||
+        !memacct_charge(MEM_MESSAGES, ws->message_len + SALT_LEN, "salted message")) {
+        exit(EXIT_FAILURE);
+    }
+    ws->perm = malloc(C_A->n * sizeof(unsigned long));
+    ws->J = malloc(C1->n * sizeof(unsigned long));
+    ws->salted_message = malloc(ws->message_len + SALT_LEN);
+    if (!ws->perm || !ws->J || !ws->salted_message) {
+        fprintf(stderr, "Memory allocation failed for signing workspace\n");
+        exit(EXIT_FAILURE);
+    }
+    for (unsigned long i = 0; i < C_A->n; ++i) ws->perm[i] = i;
+
+    gf2_mat_init(ws->J_mask, 1, C_A->n);
+    gf2_mat_init(ws->G_star, 0, C_A->n);        // sized on first use
+    gf2_mat_init(ws->hash, 1, ws->message_len);
+    gf2_mat_init(ws->F, C_A->n - C_A->k, C1->k);
+    gf2_mat_init(ws->signature, 1, C_A->n);
+    arena_init(ws->scratch, 0);
+
+    const struct code *codes[2] = {C1, C2};
+    ws->span[0] = C1->n;
+    ws->span[1] = C_A->n - C1->n;
+
+    for (int c = 0; c < 2; ++c) {
+        slong n = codes[c]->n, k = codes[c]->k;
+
+        gf2_mat_init(ws->gen[c], k, n);
+        ws->rows[c] = min_slong(C1->k, k);
+
+        // Both codes' buffers also hold n bits of the code itself, so the clamped tail fits
+        slong words = GF2_WORDS(max_slong(ws->span[c], n));
+        ws->codeword[c] = arena_calloc(ws->scratch, words, sizeof(uint64_t));
+        ws->hpart[c] = arena_calloc(ws->scratch, words, sizeof(uint64_t));
+    }
+}
+
+void sign_workspace_clear(sign_workspace *ws)
+{
+    memacct_release(MEM_SCRATCH, (ws->C_A.n + ws->C1.n) * sizeof(unsigned long));
+    memacct_release(MEM_MESSAGES, ws->message_len + SALT_LEN);
+    free(ws->perm);
+    free(ws->J);
+    free(ws->salted_message);
+    gf2_mat_clear(ws->J_mask);
+    gf2_mat_clear(ws->gen[0]);
+    gf2_mat_clear(ws->gen[1]);
+    gf2_mat_clear(ws->G_star);
+    gf2_mat_clear(ws->hash);
+    gf2_mat_clear(ws->F);
+    gf2_mat_clear(ws->signature);
+    arena_clear(ws->scratch);
+}
+
+/* Draws J, a uniformly random n1-subset of 0..n_A-1, by a partial Fisher-Yates
+   shuffle of ws->perm (which stays a permutation, so it needs no reset), then
+   sorts it by scanning the bit mask instead of calling qsort */
+static void choose_positions(sign_workspace *ws)
+{
+    unsigned long n = ws->C_A.n, size = ws->C1.n;
+
+    for (unsigned long i = 0; i < size; ++i) {
+        unsigned long j = i + rng_uniform64(n - i);
+        unsigned long temp = ws->perm[i];
+        ws->perm[i] = ws->perm[j];
+        ws->perm[j] = temp;
+    }
+
+    gf2_mat_zero(ws->J_mask);
+    uint64_t *mask = gf2_mat_row(ws->J_mask, 0);
+    for (unsigned long i = 0; i < size; ++i) mask[ws->perm[i] / 64] |= UINT64_C(1) << (ws->perm[i] % 64);
+
+    unsigned long count = 0;
+    for (slong w = 0; w < ws->J_mask->words; ++w) {
+        for (uint64_t bits = mask[w]; bits; bits &= bits - 1) {
+            ws->J[count++] = 64 * w + __builtin_ctzll(bits);
         }
-        fprintf(output_file, "\n");
     }
+}
+
+void sign_workspace_set_generators(sign_workspace *ws, const nmod_mat_t G1, const nmod_mat_t G2)
+{
+    gf2_mat_set_nmod(ws->gen[0], G1);
+    gf2_mat_set_nmod(ws->gen[1], G2);
+}
+
+void sign_workspace_expand_generators(sign_workspace *ws, const unsigned char *g1_seed,
+                                      const unsigned char *g2_seed)
+{
+    const unsigned char *seeds[2] = {g1_seed, g2_seed};
+    for (int c = 0; c < 2; ++c) {
+        gf2_mat_struct *G = ws->gen[c];
+        const gf2_mat_struct *G1 = ws->gen[0];
+        // G1 and G2 usually share (n, k) and the seed file, so the second is a copy
+        if (c == 1 && G1->r == G->r && G1->c == G->c && memcmp(g1_seed, g2_seed, SEED_SIZE) == 0) {
+            memcpy(G->bits, G1->bits, (size_t) (G->r * G->words) * sizeof(uint64_t));
+        } else {
+            create_generator_matrix_packed_from_seed(G->c, G->r, G, seeds[c]);
+        }
+    }
+}
+
+static size_t packed_bytes(slong r, slong c)
+{
+    return (size_t) r * GF2_WORDS(c) * sizeof(uint64_t);
+}
+
+size_t sign_memory_estimate(const struct code *C_A, const struct code *C1, const struct code *C2,
+                            bool packed_generators)
+{
+    slong n = C_A->n, r = C_A->n - C_A->k;
+    size_t bytes = packed_bytes(r, C1->k)                                   // F
+                 + packed_bytes(2, n) + packed_bytes(1, C1->k)              // J mask, signature, hash
+                 + packed_bytes(C1->k, C1->n) + packed_bytes(C2->k, C2->n)  // packed G1, G2
+                 + (n + C1->n) * sizeof(unsigned long) + C1->k + SALT_LEN;
+    // Codewords and split rows, each O(n) bits
+    bytes += 4 * packed_bytes(1, n);
+
+    if (C_A->quasi_cyclic || dump_enabled(DUMP_MATRICES)) bytes += packed_bytes(C1->k, n);     // G*
+    if (C_A->quasi_cyclic) bytes += packed_bytes((n + r - 1) / r, r);
+    else bytes += packed_bytes(r, n);
+
+    // The nmod G1 and G2 are released once packed, before H_A is attached, so they
+    // only count where they outweigh H_A
+    if (!packed_generators) {
+        size_t nmod = (size_t) C1->k * C1->n * sizeof(mp_limb_t);
+        if (C2->n != C1->n || C2->k != C1->k || C2->d != C1->d) nmod += (size_t) C2->k * C2->n * sizeof(mp_limb_t);
+        size_t h_a = C_A->quasi_cyclic ? packed_bytes((n + r - 1) / r, r) : packed_bytes(r, n);
+        if (nmod > h_a) bytes += nmod - h_a;
+    }
+    return bytes;
+}
+
+// Replicates bit n - 1 up to span, matching G*'s reuse of G2's last column once G2 runs out
+static void extend_last_bit(uint64_t *v, slong n, slong span)
+{
+    if (span <= n || !((v[(n - 1) / 64] >> ((n - 1) % 64)) & 1)) return;
+    for (slong c = n; c < span; ++c) v[c / 64] |= UINT64_C(1) << (c % 64);
+}
+
+// codeword[c] = (first rows[c] bits of hash) G, extended to span[c]: one row of G per set hash bit
+static void encode_hash(sign_workspace *ws, int c)
+{
+    const gf2_mat_struct *G = ws->gen[c];
+    slong rows = ws->rows[c];
+    slong words = GF2_WORDS(max_slong(ws->span[c], G->c));
+    const uint64_t *hash = gf2_mat_row(ws->hash, 0);
+    uint64_t *out = ws->codeword[c];
+
+    memset(out, 0, words * sizeof(uint64_t));
+    for (slong w = 0; 64 * w < rows; ++w) {
+        uint64_t bits = hash[w];
+        if (64 * w + 64 > rows) bits &= (UINT64_C(1) << (rows - 64 * w)) - 1;
+        for (; bits; bits &= bits - 1) {
+            const uint64_t *row = gf2_mat_row(G, 64 * w + __builtin_ctzll(bits));
+            for (slong i = 0; i < G->words; ++i) out[i] ^= row[i];
+        }
+    }
+    extend_last_bit(out, G->c, ws->span[c]);
+}
+
+// f_row ^= hpart[c] G^T on the first rows[c] columns
+static void correlate_row(sign_workspace *ws, int c, uint64_t *f_row)
+{
+    const gf2_mat_struct *G = ws->gen[c];
+    const uint64_t *v = ws->hpart[c];
+
+    for (slong j = 0; j < ws->rows[c]; ++j) {
+        if (gf2_dot(v, gf2_mat_row(G, j), G->words)) f_row[j / 64] ^= UINT64_C(1) << (j % 64);
+    }
+}
+
+/* Splits row of H_A by J. Positions of ~J past n2 all see G2's last column in G*,
+   so their bits are folded into column n2 - 1. */
+static void split_row(sign_workspace *ws, const uint64_t *h_row)
+{
+    for (int c = 0; c < 2; ++c) {
+        memset(ws->hpart[c], 0, GF2_WORDS(max_slong(ws->span[c], ws->gen[c]->c)) * sizeof(uint64_t));
+    }
+    bits_split(ws->hpart[0], ws->hpart[1], h_row, gf2_mat_row(ws->J_mask, 0), ws->C_A.n);
+
+    slong n2 = ws->gen[1]->c;
+    uint64_t *v = ws->hpart[1];
+    int fold = 0;
+    for (slong c = n2; c < ws->span[1]; ++c) {
+        fold ^= (v[c / 64] >> (c % 64)) & 1;
+        v[c / 64] &= ~(UINT64_C(1) << (c % 64));
+    }
+    if (fold) v[(n2 - 1) / 64] ^= UINT64_C(1) << ((n2 - 1) % 64);
+}
+
+// Row j of G*: G1's row j at J and G2's row j (zero past k2) elsewhere
+static void build_G_star(sign_workspace *ws)
+{
+    const gf2_mat_struct *G2 = ws->gen[1];
+    slong span = ws->span[1];
+    uint64_t *g2_row = ws->hpart[1];
+
+    for (slong j = 0; j < ws->G_star->r; ++j) {
+        memset(g2_row, 0, GF2_WORDS(max_slong(span, G2->c)) * sizeof(uint64_t));
+        if (j < G2->r) {
+            memcpy(g2_row, gf2_mat_row(G2, j), G2->words * sizeof(uint64_t));
+            extend_last_bit(g2_row, G2->c, span);
+        }
+        bits_merge(gf2_mat_row(ws->G_star, j), gf2_mat_row(ws->J_mask, 0),
+                   gf2_mat_row(ws->gen[0], j), g2_row, ws->C_A.n);
+    }
+}
 
-    nmod_mat_t G_star;
-    nmod_mat_init(G_star, C1.k, C_A.n, MOD);
+static slong packed_weight(const gf2_mat_t v)
+{
+    slong w = 0;
+    const uint64_t *row = gf2_mat_row(v, 0);
+    for (slong i = 0; i < v->words; ++i) w += __builtin_popcountll(row[i]);
+    return w;
+}
 
-    int G1_index = 0, G2_index = 0;
-    for (size_t i = 0; i < C_A.n; ++i) {
+bool generate_signature(sign_workspace *ws, const unsigned char *message, size_t message_len,
+                        const gf2_mat_struct *H_A, const qc_mat_struct *H_A_qc,
+                        unsigned char *salt, FILE *output_file)
+{
+    if (message_len != ws->message_len) {
+        fprintf(stderr, "Message length %zu does not match the signing workspace (%zu)\n",
+                message_len, ws->message_len);
+        return false;
+    }
+
+    const size_t salt_len = SALT_LEN;
+
+    trace_mark t = trace_begin();
+    choose_positions(ws);
+    trace_end("sign.choose_positions", t);
 
-        if (J[G1_index] == i) {
-            for (size_t col_index = 0; col_index < C1.k; ++col_index) {
-                int val = nmod_mat_get_entry(G1, col_index, G1_index);
-                nmod_mat_set_entry(G_star, col_index, i, val);
-            }
-            if (G1_index < C1.n - 1) {
-                ++G1_index;
-            }
+    if (dump_enabled(DUMP_SUMMARY)) {
+        fprintf(output_file, "\nRandom permutation: ");
+        for (int i = 0; i < ws->C1.n; ++i) {
+            fprintf(output_file, "%lu ", ws->J[i]);
         }
-        else {
-            for (size_t col_index = 0; col_index < C2.k; ++col_index) {
-                int val = nmod_mat_get_entry(G2, col_index, G2_index);
-                nmod_mat_set_entry(G_star, col_index, i, val);
-            }
-            if (G2_index < C2.n - 1) {
-                ++G2_index;
-            }
+        fprintf(output_file, "\n");
+    }
+
+    if (H_A_qc || dump_enabled(DUMP_MATRICES)) {
+        if (!ws->G_star->r) {
+            gf2_mat_clear(ws->G_star);
+            gf2_mat_init(ws->G_star, ws->C1.k, ws->C_A.n);
         }
+        t = trace_begin();
+        build_G_star(ws);
+        trace_end_bits("sign.G_star", t, (uint64_t) ws->G_star->r * ws->G_star->c);
     }
-    free(J); 
 
-    if (PRINT) {
+    if (dump_enabled(DUMP_MATRICES)) {
+        t = trace_begin();
         fprintf(output_file, "\nCombined matrix, G*:\n\n");
-        print_matrix(output_file, G_star);
+        gf2_mat_print(output_file, ws->G_star);
+        trace_end("sign.print", t);
     }
 
-    nmod_mat_t G_star_T;
-    nmod_mat_init(G_star_T, C_A.n, C1.k, MOD);
-    nmod_mat_transpose(G_star_T, G_star);
-
-    nmod_mat_mul(F, H_A, G_star_T);
+    // F = H_A G*^T
+    t = trace_begin();
+    if (H_A_qc) {
+        // Column i of F is the syndrome of row i of G*, one quasi-cyclic product each
+        qc_mat_mul_transpose_arena(ws->F, H_A_qc, ws->G_star, ws->scratch);
+    } else {
+        gf2_mat_zero(ws->F);
+        for (slong r = 0; r < ws->F->r; ++r) {
+            split_row(ws, gf2_mat_row(H_A, r));
+            correlate_row(ws, 0, gf2_mat_row(ws->F, r));
+            correlate_row(ws, 1, gf2_mat_row(ws->F, r));
+        }
+    }
+    trace_end_bits("sign.F", t, (uint64_t) ws->F->r * ws->C_A.n);
 
-    unsigned char salted_message[message_len + salt_len];
+    unsigned char *salted_message = ws->salted_message;
+    ws->attempts = 0;
+    trace_mark loop = trace_begin();
     do {
-        for (int i = 0; i < message_len; ++i)
-            salted_message[i] = message[i];
-        for (int i = message_len; i < message_len + salt_len; ++i)
-            salted_message[i] = randombytes_uniform(MOD); 
+        if (ws->max_attempts && ws->attempts == ws->max_attempts) {
+            fprintf(stderr, "No signature of weight >= %lu after %lu salts\n", ws->C_A.d, ws->attempts);
+            return false;
+        }
+        ++ws->attempts;
+
+        memcpy(salted_message, message, message_len);
+        for (size_t i = message_len; i < message_len + salt_len; ++i)
+            salted_message[i] = rng_uniform(MOD);
 
+        t = trace_begin();
         unsigned char hash[crypto_hash_sha256_BYTES];
         crypto_hash_sha256(hash, salted_message, message_len + salt_len);
         size_t hash_size = sizeof(hash);
-        
+
+        gf2_mat_zero(ws->hash);
         for (size_t i = 0; i < message_len; ++i) {
-            int val = hash[i % hash_size] % 2;
-            nmod_mat_set_entry(bin_hash, 0, i, val);
+            if (hash[i % hash_size] % 2) gf2_mat_set(ws->hash, 0, i, 1);
         }
+        trace_end_bits("sign.hash", t, 8 * (message_len + salt_len));
 
-        nmod_mat_mul(signature, bin_hash, G_star);
-    } while (weight(signature) < C_A.d);
+        // signature = hash G* = hash G1 at J, hash G2 elsewhere
+        t = trace_begin();
+        encode_hash(ws, 0);
+        encode_hash(ws, 1);
+        bits_merge(gf2_mat_row(ws->signature, 0), gf2_mat_row(ws->J_mask, 0),
+                   ws->codeword[0], ws->codeword[1], ws->C_A.n);
+        trace_end_bits("sign.encode", t, ws->C_A.n);
+    } while (packed_weight(ws->signature) < ws->C_A.d);
+    trace_end("sign.rejection_loop", loop);
+    trace_add("sign.attempts", ws->attempts);
 
-    for (int i = message_len; i < message_len + salt_len; ++i) {
-        salt[i - message_len] = salted_message[i]; 
-    }
+    memcpy(salt, salted_message + message_len, salt_len);
 
-    if (PRINT) {
+    if (dump_enabled(DUMP_SUMMARY)) {
         fprintf(output_file, "\nHash:\n\n");
-        print_matrix(output_file, bin_hash);
+        gf2_mat_print(output_file, ws->hash);
     }
-    
-    nmod_mat_clear(G_star);
-    nmod_mat_clear(G_star_T);
+
+    return true;
 }
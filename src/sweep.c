@@ -0,0 +1,404 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <signal.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include "sweep.h"
+#include "params.h"
+#include "constants.h"
+#include "rng.h"
+#include "utils.h"
+#include "gf2mat.h"
+#include "qcmat.h"
+#include "keygen.h"
+#include "signer.h"
+#include "verifier.h"
+#include "pubkey.h"
+#include "envelope.h"
+#include "dump.h"
+
+static const unsigned char sweep_seed[RNG_SEED_SIZE] = "signature-scheme-sweep-seed-0001";
+
+enum { SWEEP_OK, SWEEP_INVALID, SWEEP_REJECTED, SWEEP_UNVERIFIED, SWEEP_TIMEOUT, SWEEP_FAILED };
+
+static const char *status_names[] = {"ok", "invalid", "rejected", "unverified", "timeout", "failed"};
+
+typedef struct {
+    int m, t;
+    Params g, h;
+    int status;
+    double keygen_ms, sign_ms, verify_ms;       /* medians over reps, keygen once */
+    double attempts_mean;
+    unsigned long attempts_max;
+    long rss_keygen_kb, rss_sign_kb, rss_verify_kb;
+    size_t g_mem_bytes;     /* packed G1, expanded from its seed as sign does */
+    size_t h_mem_bytes;     /* expanded H_A: packed rows, or the circulant blocks */
+    size_t h_disk_bytes;    /* what keygen --use-seed / --quasi-cyclic keeps of H_A */
+    size_t pk_bytes;        /* public key file */
+    size_t sig_bytes;       /* signature envelope */
+} sweep_point;
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static long peak_rss_kb(void)
+{
+    struct rusage usage;
+    return getrusage(RUSAGE_SELF, &usage) == 0 ? usage.ru_maxrss : -1;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *) a, y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+static double median(double *v, int count)
+{
+    qsort(v, count, sizeof(double), cmp_double);
+    return count % 2 ? v[count / 2] : (v[count / 2 - 1] + v[count / 2]) / 2;
+}
+
+static size_t file_size(const char *path)
+{
+    struct stat st;
+    return stat(path, &st) == 0 ? (size_t) st.st_size : 0;
+}
+
+// Runs in the child: keygen, sign and verify for one grid point
+static void measure_point(const sweep_options *opts, sweep_point *p)
+{
+    rng_set_seed(sweep_seed);
+    dump_verbosity = DUMP_NONE;
+    FILE *devnull = fopen("/dev/null", "w");
+
+    struct code C_A = {p->h.n, p->h.k, p->h.d, opts->quasi_cyclic};
+    struct code C1 = {p->g.n, p->g.k, p->g.d, false};
+    slong rows = C_A.n - C_A.k;
+    unsigned char h_seed[SEED_SIZE], g_seed[SEED_SIZE];
+    rng_bytes(h_seed, SEED_SIZE);
+    rng_bytes(g_seed, SEED_SIZE);
+
+    sign_workspace ws;
+    sign_workspace_init(&ws, &C_A, &C1, &C1);
+    ws.max_attempts = opts->max_attempts;
+
+    // Key generation: G1 = G2 share the seed, as get_or_generate_seed gives for equal
+    // parameters, and are expanded packed the way sign does
+    double start = now_ms();
+    sign_workspace_expand_generators(&ws, g_seed, g_seed);
+    gf2_mat_t H;
+    qc_mat_t H_qc;
+    if (C_A.quasi_cyclic) {
+        qc_mat_init(H_qc, rows, C_A.n);
+        generate_parity_check_qc_from_seed(C_A.n, C_A.k, H_qc, h_seed);
+        p->h_mem_bytes = (size_t) H_qc->blocks * H_qc->h.words * sizeof(uint64_t);
+    } else {
+        gf2_mat_init(H, rows, C_A.n);
+        generate_parity_check_matrix_packed_from_seed(C_A.n, C_A.k, H, h_seed);
+        p->h_mem_bytes = (size_t) rows * H->words * sizeof(uint64_t);
+    }
+    p->keygen_ms = now_ms() - start;
+    p->rss_keygen_kb = peak_rss_kb();
+
+    // What keygen --use-seed / --quasi-cyclic keeps of H_A, as written
+    char path[MAX_FILENAME_LENGTH];
+    snprintf(path, sizeof(path), "%s/sweep_seed_%d.tmp", opts->out_dir, (int) getpid());
+    if (save_seed(path, h_seed)) p->h_disk_bytes = file_size(path);
+    remove(path);
+    p->g_mem_bytes = (size_t) ws.gen[0]->r * ws.gen[0]->words * sizeof(uint64_t);
+
+    unsigned char *message = malloc(C1.k);
+    for (unsigned long i = 0; i < C1.k; ++i) message[i] = 'a' + rng_uniform(26);
+    double *times = malloc(opts->reps * sizeof(double));
+    unsigned char salt[SALT_LEN];
+
+    unsigned long attempts = 0;
+    p->status = SWEEP_OK;
+    for (int i = 0; i < opts->reps; ++i) {
+        start = now_ms();
+        bool ok = generate_signature(&ws, message, C1.k, C_A.quasi_cyclic ? NULL : H,
+                                     C_A.quasi_cyclic ? H_qc : NULL, salt, devnull);
+        times[i] = now_ms() - start;
+        attempts += ws.attempts;
+        if (ws.attempts > p->attempts_max) p->attempts_max = ws.attempts;
+        if (!ok) {
+            p->status = SWEEP_REJECTED;
+            break;
+        }
+    }
+
+    if (p->status == SWEEP_OK) {
+        p->sign_ms = median(times, opts->reps);
+        p->attempts_mean = (double) attempts / opts->reps;
+        p->rss_sign_kb = peak_rss_kb();
+
+        // The public key and envelope as sign writes them
+        unsigned char key_id[PUBKEY_DIGEST_SIZE];
+        pubkey_digest(ws.F, key_id);
+        snprintf(path, sizeof(path), "%s/sweep_pk_%d.tmp", opts->out_dir, (int) getpid());
+        if (pubkey_write(path, ws.F)) p->pk_bytes = file_size(path);
+        remove(path);
+        snprintf(path, sizeof(path), "%s/sweep_sig_%d.tmp", opts->out_dir, (int) getpid());
+        if (envelope_write(path, ws.signature, C1.k, salt, SALT_LEN, key_id)) p->sig_bytes = file_size(path);
+        remove(path);
+
+        // Every repetition checks the last signature
+        verify_workspace vw;
+        verify_workspace_init(&vw, &C_A, &C1);
+        for (int i = 0; i < opts->reps; ++i) {
+            start = now_ms();
+            bool valid = C_A.quasi_cyclic
+                ? verify_signature_qc(&vw, message, C1.k, salt, SALT_LEN, ws.signature, ws.F, H_qc, false, devnull)
+                : verify_signature(&vw, message, C1.k, salt, SALT_LEN, ws.signature, ws.F, H, false, devnull);
+            times[i] = now_ms() - start;
+            if (!valid) p->status = SWEEP_UNVERIFIED;
+        }
+        p->verify_ms = median(times, opts->reps);
+        p->rss_verify_kb = peak_rss_kb();
+        verify_workspace_clear(&vw);
+    }
+
+    sign_workspace_clear(&ws);
+    free(times);
+    free(message);
+    if (C_A.quasi_cyclic) qc_mat_clear(H_qc);
+    else gf2_mat_clear(H);
+    fclose(devnull);
+}
+
+static void run_point(const sweep_options *opts, sweep_point *p)
+{
+    int fds[2];
+    if (pipe(fds) != 0) {
+        perror("pipe");
+        p->status = SWEEP_FAILED;
+        return;
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        close(fds[0]);
+        close(fds[1]);
+        p->status = SWEEP_FAILED;
+        return;
+    }
+
+    if (pid == 0) {
+        close(fds[0]);
+        if (opts->timeout) alarm(opts->timeout);
+        measure_point(opts, p);
+        ssize_t written = write(fds[1], p, sizeof(*p));
+        _exit(written == (ssize_t) sizeof(*p) ? 0 : 1);
+    }
+
+    close(fds[1]);
+    sweep_point result;
+    size_t got = 0;
+    while (got < sizeof(result)) {
+        ssize_t r = read(fds[0], (char *) &result + got, sizeof(result) - got);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) break;
+        got += r;
+    }
+    close(fds[0]);
+
+    int wstatus;
+    while (waitpid(pid, &wstatus, 0) < 0 && errno == EINTR) {}
+
+    if (got == sizeof(result) && WIFEXITED(wstatus) && WEXITSTATUS(wstatus) == 0) {
+        *p = result;
+    } else if (WIFSIGNALED(wstatus) && WTERMSIG(wstatus) == SIGALRM) {
+        p->status = SWEEP_TIMEOUT;
+    } else {
+        p->status = SWEEP_FAILED;
+    }
+}
+
+typedef struct {
+    double a, b, r2;
+    int points;
+} power_fit;
+
+// Least squares fit of ln T = ln a + b ln n_A over the measured points
+static power_fit fit_power_law(const sweep_point *points, int count, size_t offset)
+{
+    power_fit fit = {0, 0, 0, 0};
+    double sx = 0, sy = 0, sxx = 0, sxy = 0, syy = 0;
+    for (int i = 0; i < count; ++i) {
+        double T = *(const double *) ((const char *) &points[i] + offset);
+        if (points[i].status != SWEEP_OK || T <= 0) continue;
+        double x = log((double) points[i].h.n), y = log(T);
+        sx += x; sy += y; sxx += x * x; sxy += x * y; syy += y * y;
+        ++fit.points;
+    }
+    if (fit.points < 2) return fit;
+
+    double n = fit.points;
+    double var_x = sxx - sx * sx / n, var_y = syy - sy * sy / n, cov = sxy - sx * sy / n;
+    if (var_x <= 0) return fit;
+
+    fit.b = cov / var_x;
+    fit.a = exp((sy - fit.b * sx) / n);
+    double ss_res = var_y - fit.b * cov;
+    fit.r2 = var_y > 0 ? 1 - ss_res / var_y : 1;
+    return fit;
+}
+
+static void print_header(FILE *out)
+{
+    fprintf(out, "%3s %4s %6s %6s %4s %7s %7s %5s %10s %10s %10s %8s %9s %9s %9s %10s %10s %6s  %s\n",
+            "m", "t", "n", "k", "d", "n_A", "k_A", "d_A", "keygen_ms", "sign_ms", "verify_ms", "attempts",
+            "rss_kg_kb", "rss_sg_kb", "rss_vf_kb", "G_bytes", "pk_bytes", "sig_B", "status");
+}
+
+static void print_point(FILE *out, const sweep_point *p)
+{
+    fprintf(out, "%3d %4d %6u %6u %4u %7u %7u %5u %10.3f %10.3f %10.3f %8.2f %9ld %9ld %9ld %10zu %10zu %6zu  %s\n",
+            p->m, p->t, p->g.n, p->g.k, p->g.d, p->h.n, p->h.k, p->h.d, p->keygen_ms, p->sign_ms, p->verify_ms,
+            p->attempts_mean, p->rss_keygen_kb, p->rss_sign_kb, p->rss_verify_kb, p->g_mem_bytes,
+            p->pk_bytes, p->sig_bytes, status_names[p->status]);
+}
+
+static bool write_csv(const sweep_options *opts, const sweep_point *points, int count, int recommended)
+{
+    char path[MAX_FILENAME_LENGTH];
+    snprintf(path, sizeof(path), "%s/sweep.csv", opts->out_dir);
+    FILE *csv = fopen(path, "w");
+    if (!csv) {
+        fprintf(stderr, "Could not open %s for writing\n", path);
+        return false;
+    }
+    fprintf(csv, "m,t,n,k,d,n_A,k_A,d_A,quasi_cyclic,keygen_ms,sign_ms,verify_ms,attempts_mean,attempts_max,"
+                 "rss_keygen_kb,rss_sign_kb,rss_verify_kb,g_mem_bytes,h_mem_bytes,h_disk_bytes,pk_bytes,"
+                 "sig_bytes,status,recommended\n");
+    for (int i = 0; i < count; ++i) {
+        const sweep_point *p = &points[i];
+        fprintf(csv, "%d,%d,%u,%u,%u,%u,%u,%u,%d,%.4f,%.4f,%.4f,%.3f,%lu,%ld,%ld,%ld,%zu,%zu,%zu,%zu,%zu,%s,%d\n",
+                p->m, p->t, p->g.n, p->g.k, p->g.d, p->h.n, p->h.k, p->h.d, opts->quasi_cyclic,
+                p->keygen_ms, p->sign_ms, p->verify_ms, p->attempts_mean, p->attempts_max,
+                p->rss_keygen_kb, p->rss_sign_kb, p->rss_verify_kb, p->g_mem_bytes, p->h_mem_bytes,
+                p->h_disk_bytes, p->pk_bytes, p->sig_bytes, status_names[p->status], i == recommended);
+    }
+    fclose(csv);
+    return true;
+}
+
+static bool write_model(const sweep_options *opts, const char *names[], const power_fit fits[], int count)
+{
+    char path[MAX_FILENAME_LENGTH];
+    snprintf(path, sizeof(path), "%s/sweep_model.csv", opts->out_dir);
+    FILE *csv = fopen(path, "w");
+    if (!csv) {
+        fprintf(stderr, "Could not open %s for writing\n", path);
+        return false;
+    }
+    fprintf(csv, "phase,a_ms,b,r2,points\n");
+    for (int i = 0; i < count; ++i) {
+        fprintf(csv, "%s,%.6g,%.4f,%.4f,%d\n", names[i], fits[i].a, fits[i].b, fits[i].r2, fits[i].points);
+    }
+    fclose(csv);
+    return true;
+}
+
+void sweep_default_options(sweep_options *opts)
+{
+    opts->m_min = 5;
+    opts->m_max = 9;
+    opts->t_min = 1;
+    opts->t_max = 8;
+    opts->t_step = 1;
+    opts->reps = 5;
+    opts->timeout = 60;
+    opts->max_attempts = 10000;
+    opts->min_n = 0;
+    opts->min_d = 0;
+    opts->quasi_cyclic = false;
+    opts->out_dir = "timing";
+}
+
+int sweep_run(const sweep_options *opts)
+{
+    if (mkdir(opts->out_dir, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Could not create %s: %s\n", opts->out_dir, strerror(errno));
+        return 1;
+    }
+
+    int capacity = (opts->m_max - opts->m_min + 1) * ((opts->t_max - opts->t_min) / opts->t_step + 1);
+    sweep_point *points = calloc(capacity, sizeof(sweep_point));
+    if (!points) {
+        fprintf(stderr, "Memory allocation failed for sweep results\n");
+        return 1;
+    }
+
+    print_header(stdout);
+    int count = 0;
+    for (int m = opts->m_min; m <= opts->m_max; ++m) {
+        for (int t = opts->t_min; t <= opts->t_max; t += opts->t_step) {
+            sweep_point *p = &points[count++];
+            p->m = m;
+            p->t = t;
+            Params g2;
+            if (!bch_code_params(m, t, &p->g, &g2, &p->h)) {
+                p->status = SWEEP_INVALID;
+                continue;
+            }
+            run_point(opts, p);
+            print_point(stdout, p);
+        }
+    }
+
+    const char *names[] = {"keygen", "sign", "verify"};
+    power_fit fits[] = {
+        fit_power_law(points, count, offsetof(sweep_point, keygen_ms)),
+        fit_power_law(points, count, offsetof(sweep_point, sign_ms)),
+        fit_power_law(points, count, offsetof(sweep_point, verify_ms)),
+    };
+
+    printf("\nCost model, T(ms) = a * n_A^b:\n");
+    for (int i = 0; i < 3; ++i) {
+        if (fits[i].points < 2) {
+            printf("  %-7s not enough points of different length to fit\n", names[i]);
+        } else {
+            printf("  %-7s a = %.4g, b = %.3f, R^2 = %.3f over %d points\n",
+                   names[i], fits[i].a, fits[i].b, fits[i].r2, fits[i].points);
+        }
+    }
+
+    int best = -1;
+    for (int i = 0; i < count; ++i) {
+        const sweep_point *p = &points[i];
+        if (p->status != SWEEP_OK || p->h.n < opts->min_n || p->h.d < opts->min_d) continue;
+        if (best < 0 || p->sign_ms + p->verify_ms < points[best].sign_ms + points[best].verify_ms) best = i;
+    }
+
+    if (best < 0) {
+        printf("\nNo measured parameter set has n_A >= %u and d_A >= %u\n", opts->min_n, opts->min_d);
+    } else {
+        const sweep_point *p = &points[best];
+        printf("\nRecommended (fastest sign + verify with n_A >= %u, d_A >= %u): m = %d, t = %d\n",
+               opts->min_n, opts->min_d, p->m, p->t);
+        print_header(stdout);
+        print_point(stdout, p);
+    }
+
+    bool saved = write_csv(opts, points, count, best) && write_model(opts, names, fits, 3);
+    if (saved) printf("\nResults written to %s/sweep.csv and %s/sweep_model.csv\n", opts->out_dir, opts->out_dir);
+
+    free(points);
+    return saved && best >= 0 ? 0 : 1;
+}
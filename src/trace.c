@@ -0,0 +1,321 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "trace.h"
+
+#ifndef SIG_NO_TRACE
+
+_Atomic bool trace_enabled = false;
+
+typedef struct {
+    const char *name;
+    uint64_t start_ns, dur_ns;
+    int64_t value;      /* counter total after this update */
+    uint64_t bits;      /* operand bits the span processed, 0 if not given */
+    uint64_t perf[PERF_NUM_COUNTERS];
+    int tid;
+    char ph;            /* 'X' span, 'C' counter */
+} trace_event;
+
+typedef struct {
+    const char *name;
+    int64_t total;
+} trace_counter;
+
+// Running totals for one span name, updated as each span closes
+typedef struct {
+    const char *name;
+    uint64_t count, total_ns, min_ns, max_ns, bits;
+    uint64_t perf[PERF_NUM_COUNTERS];   /* PERF_UNAVAILABLE once any occurrence lacked it */
+} trace_span;
+
+#define TRACE_MAX_COUNTERS 32
+#define TRACE_MAX_SPANS 256             /* distinct span names */
+#define TRACE_SPAN_SLOTS 512            /* hash index over spans, a power of two */
+#define TRACE_MAX_EVENTS (1u << 18)     /* raw events kept for the JSON trace, the oldest are overwritten */
+
+static struct {
+    pthread_mutex_t lock;
+    char *path;
+    bool keep_events;                   /* only the JSON trace needs the raw events */
+    trace_event *events;                /* ring of the last TRACE_MAX_EVENTS events */
+    size_t count, capacity, head;
+    uint64_t overwritten;
+    trace_counter counters[TRACE_MAX_COUNTERS];
+    int num_counters;
+    trace_span spans[TRACE_MAX_SPANS];  /* in order of first appearance */
+    int num_spans;
+    uint64_t lost_spans;                /* spans past TRACE_MAX_SPANS names */
+    uint16_t span_slot[TRACE_SPAN_SLOTS];   /* index into spans + 1, 0 if empty */
+    uint64_t origin_ns;
+    bool perf;
+} trace = {PTHREAD_MUTEX_INITIALIZER};
+
+static _Thread_local int trace_tid = 0;
+static int next_tid = 0;
+
+uint64_t trace_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+/* Caller holds the lock. The buffer doubles up to TRACE_MAX_EVENTS and then
+   wraps, overwriting the oldest event. */
+static trace_event *push_event(void)
+{
+    if (!trace.keep_events) return NULL;
+    trace_event *e;
+    if (trace.count < trace.capacity) {
+        e = &trace.events[trace.count++];
+    } else if (trace.capacity < TRACE_MAX_EVENTS) {
+        size_t capacity = trace.capacity ? 2 * trace.capacity : 1024;
+        trace_event *events = realloc(trace.events, capacity * sizeof(trace_event));
+        if (!events) return NULL;
+        trace.events = events;
+        trace.capacity = capacity;
+        e = &trace.events[trace.count++];
+    } else {
+        e = &trace.events[trace.head];
+        trace.head = (trace.head + 1) % trace.capacity;
+        ++trace.overwritten;
+    }
+    if (!trace_tid) trace_tid = ++next_tid;
+    e->tid = trace_tid;
+    return e;
+}
+
+// FNV-1a over the name, since the same literal may have several addresses
+static unsigned name_hash(const char *name)
+{
+    uint32_t h = 2166136261u;
+    for (const unsigned char *p = (const unsigned char *) name; *p; ++p) h = (h ^ *p) * 16777619u;
+    return h & (TRACE_SPAN_SLOTS - 1);
+}
+
+// Caller holds the lock; NULL once TRACE_MAX_SPANS names are in use
+static trace_span *find_span(const char *name)
+{
+    unsigned h = name_hash(name);
+    for (; trace.span_slot[h]; h = (h + 1) & (TRACE_SPAN_SLOTS - 1)) {
+        trace_span *s = &trace.spans[trace.span_slot[h] - 1];
+        if (s->name == name || strcmp(s->name, name) == 0) return s;
+    }
+    if (trace.num_spans == TRACE_MAX_SPANS) return NULL;
+    trace_span *s = &trace.spans[trace.num_spans++];
+    trace.span_slot[h] = (uint16_t) trace.num_spans;
+    s->name = name;
+    s->min_ns = UINT64_MAX;
+    return s;
+}
+
+// Counters are read outside the clock readings so the read() is not timed
+trace_mark trace_start(void)
+{
+    trace_mark mark;
+    if (trace.perf) perf_read(mark.perf);
+    mark.ns = trace_now();
+    return mark;
+}
+
+void trace_stop(const char *name, const trace_mark *start, uint64_t bits)
+{
+    uint64_t end_ns = trace_now();
+    uint64_t perf[PERF_NUM_COUNTERS];
+    if (trace.perf) perf_read(perf);
+
+    uint64_t dur_ns = end_ns - start->ns;
+    for (int i = 0; i < PERF_NUM_COUNTERS; ++i) {
+        bool ok = trace.perf && start->perf[i] != PERF_UNAVAILABLE && perf[i] != PERF_UNAVAILABLE;
+        perf[i] = ok ? perf[i] - start->perf[i] : PERF_UNAVAILABLE;
+    }
+
+    pthread_mutex_lock(&trace.lock);
+    // A worker may close a span after the exit handler has written the file
+    if (!trace_enabled) {
+        pthread_mutex_unlock(&trace.lock);
+        return;
+    }
+    trace_span *s = find_span(name);
+    if (s) {
+        ++s->count;
+        s->total_ns += dur_ns;
+        s->bits += bits;
+        if (dur_ns < s->min_ns) s->min_ns = dur_ns;
+        if (dur_ns > s->max_ns) s->max_ns = dur_ns;
+        for (int i = 0; i < PERF_NUM_COUNTERS; ++i) {
+            if (perf[i] == PERF_UNAVAILABLE) s->perf[i] = PERF_UNAVAILABLE;
+            else if (s->perf[i] != PERF_UNAVAILABLE) s->perf[i] += perf[i];
+        }
+    } else {
+        ++trace.lost_spans;
+    }
+
+    trace_event *e = push_event();
+    if (e) {
+        e->name = name;
+        e->start_ns = start->ns;
+        e->dur_ns = dur_ns;
+        e->bits = bits;
+        e->ph = 'X';
+        memcpy(e->perf, perf, sizeof(perf));
+    }
+    pthread_mutex_unlock(&trace.lock);
+}
+
+void trace_count(const char *name, int64_t delta)
+{
+    pthread_mutex_lock(&trace.lock);
+    if (!trace_enabled) {
+        pthread_mutex_unlock(&trace.lock);
+        return;
+    }
+    trace_counter *c = NULL;
+    for (int i = 0; i < trace.num_counters && !c; ++i) {
+        if (trace.counters[i].name == name || strcmp(trace.counters[i].name, name) == 0) c = &trace.counters[i];
+    }
+    if (!c && trace.num_counters < TRACE_MAX_COUNTERS) {
+        c = &trace.counters[trace.num_counters++];
+        c->name = name;
+        c->total = 0;
+    }
+    if (c) {
+        c->total += delta;
+        trace_event *e = push_event();
+        if (e) {
+            e->name = c->name;
+            e->start_ns = trace_now();
+            e->dur_ns = 0;
+            e->bits = 0;
+            e->value = c->total;
+            e->ph = 'C';
+        }
+    }
+    pthread_mutex_unlock(&trace.lock);
+}
+
+static void write_chrome_json(FILE *out)
+{
+    int pid = (int) getpid();
+    fprintf(out, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    for (size_t i = 0; i < trace.count; ++i) {
+        const trace_event *e = &trace.events[(trace.head + i) % trace.count];
+        double ts = (e->start_ns - trace.origin_ns) / 1e3;
+        if (e->ph == 'X') {
+            fprintf(out, "  {\"name\": \"%s\", \"cat\": \"sig\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, "
+                         "\"pid\": %d, \"tid\": %d, \"args\": {",
+                    e->name, ts, e->dur_ns / 1e3, pid, e->tid);
+            const char *sep = "";
+            if (e->bits) {
+                fprintf(out, "\"bits\": %llu", (unsigned long long) e->bits);
+                sep = ", ";
+            }
+            for (int k = 0; k < PERF_NUM_COUNTERS; ++k) {
+                if (e->perf[k] == PERF_UNAVAILABLE) continue;
+                fprintf(out, "%s\"%s\": %llu", sep, perf_counter_names[k], (unsigned long long) e->perf[k]);
+                sep = ", ";
+            }
+            fprintf(out, "}}");
+        } else {
+            fprintf(out, "  {\"name\": \"%s\", \"ph\": \"C\", \"ts\": %.3f, \"pid\": %d, \"args\": {\"value\": %lld}}",
+                    e->name, ts, pid, (long long) e->value);
+        }
+        fprintf(out, "%s\n", i + 1 < trace.count ? "," : "");
+    }
+    fprintf(out, "]}\n");
+}
+
+static void print_ratio(FILE *out, uint64_t num, uint64_t den)
+{
+    if (num != PERF_UNAVAILABLE && den && den != PERF_UNAVAILABLE) fprintf(out, ",%.6g", (double) num / den);
+    else fprintf(out, ",");
+}
+
+/* One line per span name in order of first appearance, then the counter totals.
+   Hardware counts are summed over the span's occurrences and left empty where
+   any occurrence lacked them. */
+static void write_csv(FILE *out)
+{
+    fprintf(out, "kind,name,count,total_us,min_us,max_us,bits");
+    for (int k = 0; k < PERF_NUM_COUNTERS; ++k) fprintf(out, ",%s", perf_counter_names[k]);
+    fprintf(out, ",ipc,l1d_misses_per_bit,llc_misses_per_bit\n");
+    for (int i = 0; i < trace.num_spans; ++i) {
+        const trace_span *s = &trace.spans[i];
+        fprintf(out, "span,%s,%llu,%.3f,%.3f,%.3f,", s->name, (unsigned long long) s->count,
+                s->total_ns / 1e3, s->min_ns / 1e3, s->max_ns / 1e3);
+        if (s->bits) fprintf(out, "%llu", (unsigned long long) s->bits);
+        for (int k = 0; k < PERF_NUM_COUNTERS; ++k) {
+            if (s->perf[k] != PERF_UNAVAILABLE) fprintf(out, ",%llu", (unsigned long long) s->perf[k]);
+            else fprintf(out, ",");
+        }
+        print_ratio(out, s->perf[PERF_INSTRUCTIONS], s->perf[PERF_CYCLES]);
+        print_ratio(out, s->perf[PERF_L1D_MISSES], s->bits);
+        print_ratio(out, s->perf[PERF_LLC_MISSES], s->bits);
+        fprintf(out, "\n");
+    }
+    for (int i = 0; i < trace.num_counters; ++i) {
+        fprintf(out, "counter,%s,%lld,,,,", trace.counters[i].name, (long long) trace.counters[i].total);
+        for (int k = 0; k < PERF_NUM_COUNTERS + 3; ++k) fprintf(out, ",");
+        fprintf(out, "\n");
+    }
+}
+
+static void trace_finish(void)
+{
+    pthread_mutex_lock(&trace.lock);
+    trace_enabled = false;
+
+    FILE *out = fopen(trace.path, "w");
+    if (!out) {
+        fprintf(stderr, "Could not open trace file %s\n", trace.path);
+    } else {
+        if (trace.keep_events) write_chrome_json(out);
+        else write_csv(out);
+        fclose(out);
+        if (trace.overwritten) {
+            fprintf(stderr, "Trace %s keeps only the last %zu of %llu events\n", trace.path, trace.count,
+                    (unsigned long long) (trace.count + trace.overwritten));
+        }
+        if (trace.lost_spans) {
+            fprintf(stderr, "Trace %s dropped %llu spans past %d distinct names\n", trace.path,
+                    (unsigned long long) trace.lost_spans, TRACE_MAX_SPANS);
+        }
+    }
+
+    free(trace.events);
+    free(trace.path);
+    trace.events = NULL;
+    trace.count = trace.capacity = trace.head = 0;
+    pthread_mutex_unlock(&trace.lock);
+}
+
+void trace_init(void)
+{
+    const char *path = getenv("SIG_TRACE");
+    if (!path || !*path || trace_enabled) return;
+
+    trace.path = strdup(path);
+    if (!trace.path) return;
+    size_t len = strlen(path);
+    trace.keep_events = !(len >= 4 && strcmp(path + len - 4, ".csv") == 0);
+    trace.origin_ns = trace_now();
+    const char *perf = getenv("SIG_PERF");
+    trace.perf = perf && *perf && strcmp(perf, "0") != 0 && perf_open();
+    trace_enabled = true;
+    atexit(trace_finish);
+}
+
+#else
+
+void trace_init(void) {}
+uint64_t trace_now(void) { return 0; }
+trace_mark trace_start(void) { return (trace_mark) {0}; }
+void trace_stop(const char *name, const trace_mark *start, uint64_t bits) {}
+void trace_count(const char *name, int64_t delta) {}
+
+#endif
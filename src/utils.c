@@ -1,10 +1,17 @@
 #include <stdbool.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/file.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include "params.h"
 #include "utils.h"
+#include "rng.h"
 #include "constants.h"
+#include "trace.h"
 
 void ensure_matrix_cache() {
     struct stat st = {0};
@@ -49,15 +56,15 @@ double binary_entropy(double p) {
     return -p * log2(p) - (1 - p) * log2(1 - p);
 }
 
-// Fisher Yates shuffle
+// Fisher Yates shuffle, stopped after the first `size` positions are drawn
 void generate_random_set(unsigned long upper_bound, unsigned long size, unsigned long set[size]) {
     unsigned long *arr = malloc(upper_bound * sizeof(unsigned long));
     for (size_t i = 0; i < upper_bound; i++) {
         arr[i] = i;
     }
 
-    for (size_t i = upper_bound - 1; i > 0; i--) {
-        unsigned long j = randombytes_uniform(i + 1);
+    for (size_t i = 0; i < size; i++) {
+        unsigned long j = i + rng_uniform64(upper_bound - i);
         unsigned long temp = arr[i];
         arr[i] = arr[j];
         arr[j] = temp;
@@ -82,9 +89,103 @@ char* generate_matrix_filename(const char* prefix, int n, int k, int d) {
     return filename;
 }
 
+static mode_t creation_mode;
+static pthread_once_t creation_mode_once = PTHREAD_ONCE_INIT;
+
+// umask can only be read by setting it, so this is done once, before files are written
+static void read_umask(void) {
+    mode_t mask = umask(077);
+    umask(mask);
+    creation_mode = 0666 & ~mask;
+}
+
+/* Opens a temporary file next to filename; writes become visible under filename
+   only once commit_atomic_file renames it into place, so concurrent readers see
+   either the old contents or the complete new ones, never a partial file.
+   mkstemp creates the file 0600; it gets the mode fopen would give it instead,
+   so signatures and public keys stay readable by others under the usual umask. */
+FILE *open_atomic_file(const char *filename, const char *mode, char tmp_path[MAX_FILENAME_LENGTH]) {
+    if (snprintf(tmp_path, MAX_FILENAME_LENGTH, "%s.tmp.XXXXXX", filename) >= MAX_FILENAME_LENGTH) {
+        return NULL;
+    }
+
+    pthread_once(&creation_mode_once, read_umask);
+    int fd = mkstemp(tmp_path);
+    if (fd < 0) return NULL;
+    if (fchmod(fd, creation_mode) != 0) {
+        close(fd);
+        unlink(tmp_path);
+        return NULL;
+    }
+
+    FILE *file = fdopen(fd, mode);
+    if (!file) {
+        close(fd);
+        unlink(tmp_path);
+    }
+    return file;
+}
+
+// fsyncs the directory holding filename, so a rename into it survives a crash
+static bool sync_parent_dir(const char *filename) {
+    char dir[MAX_FILENAME_LENGTH];
+    const char *slash = strrchr(filename, '/');
+    if (!slash) snprintf(dir, sizeof(dir), ".");
+    else if (slash == filename) snprintf(dir, sizeof(dir), "/");
+    else snprintf(dir, sizeof(dir), "%.*s", (int) (slash - filename), filename);
+
+    int fd = open(dir, O_RDONLY | O_DIRECTORY);
+    if (fd < 0) return false;
+    bool ok = fsync(fd) == 0;
+    close(fd);
+    return ok;
+}
+
+/* Flushes and fsyncs the temporary file, atomically renames it over filename and
+   fsyncs the directory, so the new contents are durable once this returns true */
+bool commit_atomic_file(FILE *file, const char *tmp_path, const char *filename) {
+    bool ok = fflush(file) == 0 && fsync(fileno(file)) == 0;
+    ok = (fclose(file) == 0) && ok;
+    ok = ok && rename(tmp_path, filename) == 0;
+    if (!ok) unlink(tmp_path);
+    return ok && sync_parent_dir(filename);
+}
+
+void discard_atomic_file(FILE *file, const char *tmp_path) {
+    fclose(file);
+    unlink(tmp_path);
+}
+
+/* Takes an exclusive advisory lock on a cache entry (via filename.lock), blocking
+   until other processes generating the same entry are done. Returns the lock fd,
+   or -1 if locking is unavailable, in which case callers proceed unlocked. */
+int lock_cache_entry(const char *filename) {
+    char lock_path[MAX_FILENAME_LENGTH];
+    if (snprintf(lock_path, sizeof(lock_path), "%s.lock", filename) >= (int) sizeof(lock_path)) return -1;
+
+    int fd = open(lock_path, O_RDWR | O_CREAT, 0600);
+    if (fd < 0) return -1;
+
+    while (flock(fd, LOCK_EX) != 0) {
+        if (errno != EINTR) {
+            close(fd);
+            return -1;
+        }
+    }
+    return fd;
+}
+
+void unlock_cache_entry(int fd) {
+    if (fd < 0) return;
+    flock(fd, LOCK_UN);
+    close(fd);
+}
+
 // Function to save a matrix to a text file
 void save_matrix(const char* filename, const nmod_mat_t matrix) {
-    FILE* file = fopen(filename, "w");
+    char tmp_path[MAX_FILENAME_LENGTH];
+    trace_mark t = trace_begin();
+    FILE* file = open_atomic_file(filename, "w", tmp_path);
     if (file == NULL) {
         fprintf(stderr, "Error opening file for writing: %s\n", filename);
         return;
@@ -102,11 +203,18 @@ void save_matrix(const char* filename, const nmod_mat_t matrix) {
         fprintf(file, "\n");
     }
     
-    fclose(file);
+    long written = ftell(file);
+    if (!commit_atomic_file(file, tmp_path, filename)) {
+        fprintf(stderr, "Error writing file: %s\n", filename);
+    } else {
+        trace_add("io.bytes_written", written);
+    }
+    trace_end_bits("io.save_matrix", t, (uint64_t) rows * cols);
 }
 
 // Function to load a matrix from a text file
 int load_matrix(const char* filename, nmod_mat_t matrix) {
+    trace_mark t = trace_begin();
     FILE* file = fopen(filename, "r");
     if (file == NULL) {
         return 0;  // File doesn't exist or can't be opened
@@ -132,7 +240,9 @@ int load_matrix(const char* filename, nmod_mat_t matrix) {
         }
     }
     
+    trace_add("io.bytes_read", ftell(file));
     fclose(file);
+    trace_end_bits("io.load_matrix", t, (uint64_t) rows * cols);
     return 1;
 }
 
@@ -154,12 +264,17 @@ char* generate_seed_filename(const char* prefix, int n, int k, int d) {
 }
 
 bool save_seed(const char* filename, const unsigned char *seed) {
-    FILE *file = fopen(filename, "wb");
+    char tmp_path[MAX_FILENAME_LENGTH];
+    FILE *file = open_atomic_file(filename, "wb", tmp_path);
     if (!file) return false;
     
     size_t written = fwrite(seed, 1, SEED_SIZE, file);
-    fclose(file);
-    return written == SEED_SIZE;
+    if (written != SEED_SIZE) {
+        discard_atomic_file(file, tmp_path);
+        return false;
+    }
+    trace_add("io.bytes_written", SEED_SIZE);
+    return commit_atomic_file(file, tmp_path, filename);
 }
 
 bool load_seed(const char* filename, unsigned char *seed) {
@@ -168,6 +283,7 @@ bool load_seed(const char* filename, unsigned char *seed) {
     
     size_t read = fread(seed, 1, SEED_SIZE, file);
     fclose(file);
+    trace_add("io.bytes_read", read);
     return read == SEED_SIZE;
 }
 
@@ -208,6 +324,7 @@ char *read_file(const char *filename) {
 
     size_t read = fread(buffer, 1, length, fp);
     fclose(fp);
+    trace_add("io.bytes_read", read);
 
     buffer[read] = '\0';
     return buffer;
@@ -234,6 +351,7 @@ char *read_file_or_generate(const char *filename, int msg_len) {
 
             size_t read = fread(buffer, 1, length, fp);
             buffer[read] = '\0';
+            trace_add("io.bytes_read", read);
             fclose(fp);
             return buffer;
         }
@@ -272,10 +390,12 @@ bool load_params(struct code *C_A, struct code *C1, struct code *C2) {
 
     char key[16];
     unsigned long val;
+    C_A->quasi_cyclic = C1->quasi_cyclic = C2->quasi_cyclic = false;
     while (fscanf(file, "%15s %lu", key, &val) == 2) {
         if      (strcmp(key, "H_A_n") == 0) C_A->n = val;
         else if (strcmp(key, "H_A_k") == 0) C_A->k = val;
         else if (strcmp(key, "H_A_d") == 0) C_A->d = val;
+        else if (strcmp(key, "H_A_qc") == 0) C_A->quasi_cyclic = val != 0;
         else if (strcmp(key, "G1_n") == 0)  C1->n = val;
         else if (strcmp(key, "G1_k") == 0)  C1->k = val;
         else if (strcmp(key, "G1_d") == 0)  C1->d = val;
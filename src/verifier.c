@@ -1,64 +1,184 @@
 #include <stdio.h>
 #include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
 #include "verifier.h"
 #include "matrix.h"
 #include "utils.h"
 #include "constants.h"
+#include "trace.h"
+#include "dump.h"
+#include "memacct.h"
 
-void verify_signature(const unsigned char *message, size_t message_len,
-                      const unsigned char *salt, size_t salt_len,
-                      unsigned long sig_len, nmod_mat_t signature,
-                      nmod_mat_t F, struct code C_A,
-                      nmod_mat_t H_A, FILE *output_file)
+/* Checks F·hashᵀ = H_A·sigᵀ one row at a time on the augmented system [F | H_A]:
+   row r holds iff <F_r, hash> xor <H_A,r, sig> is zero, computed in a single pass
+   over both packed rows. With a quasi-cyclic H_A the right-hand side is computed
+   up front and passed as syndrome instead (H_A is then NULL). Returns the number
+   of failing rows; unless full_check is set it stops at the first one, so invalid
+   signatures are rejected after a few rows. When lhs/rhs are given, the two halves
+   of each checked row are recorded in them. */
+static slong check_augmented_rows(const gf2_mat_t F, const uint64_t *hash,
+                                  const gf2_mat_struct *H_A, const uint64_t *syndrome,
+                                  const uint64_t *sig, bool full_check, gf2_mat_t lhs, gf2_mat_t rhs)
+{
+    slong failures = 0;
+
+    for (slong r = 0; r < F->r; ++r) {
+        const uint64_t *f_row = gf2_mat_row(F, r);
+        const uint64_t *h_row = H_A ? gf2_mat_row(H_A, r) : NULL;
+
+        if (lhs) {
+            int left = gf2_dot(f_row, hash, F->words);
+            int right = H_A ? gf2_dot(h_row, sig, H_A->words) : (int) (syndrome[r / 64] >> (r % 64)) & 1;
+            gf2_mat_set(lhs, 0, r, left);
+            gf2_mat_set(rhs, 0, r, right);
+            if (left != right) ++failures;
+        } else {
+            uint64_t acc = 0;
+            for (slong w = 0; w < F->words; ++w) acc ^= f_row[w] & hash[w];
+            if (H_A) {
+                for (slong w = 0; w < H_A->words; ++w) acc ^= h_row[w] & sig[w];
+            } else {
+                acc ^= (syndrome[r / 64] >> (r % 64)) & 1;
+            }
+            if (__builtin_parityll(acc)) ++failures;
+        }
+
+        if (failures && !full_check) break;
+    }
+
+    return failures;
+}
+
+void verify_workspace_init(verify_workspace *ws, const struct code *C_A, const struct code *C1)
+{
+    slong rows = C_A->n - C_A->k;
+
+    ws->message_len = C1->k;
+    if (!memacct_charge(MEM_MESSAGES, ws->message_len + SALT_LEN, "salted message") ||
+        !memacct_charge(MEM_SCRATCH, GF2_WORDS(rows) * sizeof(uint64_t), "syndrome")) {
+        exit(EXIT_FAILURE);
+    }
+    ws->salted_message = malloc(ws->message_len + SALT_LEN);
+    ws->syndrome = calloc(GF2_WORDS(rows), sizeof(uint64_t));
+    if (!ws->salted_message || !ws->syndrome) {
+        fprintf(stderr, "Memory allocation failed for verification workspace\n");
+        exit(EXIT_FAILURE);
+    }
+    gf2_mat_init(ws->hash, 1, ws->message_len);
+    gf2_mat_init(ws->left, 1, rows);
+    gf2_mat_init(ws->right, 1, rows);
+    arena_init(ws->scratch, 0);
+}
+
+void verify_workspace_clear(verify_workspace *ws)
 {
+    memacct_release(MEM_MESSAGES, ws->message_len + SALT_LEN);
+    memacct_release(MEM_SCRATCH, GF2_WORDS(ws->left->c) * sizeof(uint64_t));    // left is 1 x rows
+    free(ws->salted_message);
+    free(ws->syndrome);
+    gf2_mat_clear(ws->hash);
+    gf2_mat_clear(ws->left);
+    gf2_mat_clear(ws->right);
+    arena_clear(ws->scratch);
+}
 
-    unsigned char salted_message[message_len + salt_len];
-    for (int i = 0; i < message_len; ++i)
-            salted_message[i] = message[i];
-    for (int i = message_len; i < message_len + salt_len; ++i)
-        salted_message[i] = salt[i - message_len];
+static bool verify_against(verify_workspace *ws, const unsigned char *message, size_t message_len,
+                           const unsigned char *salt, size_t salt_len,
+                           const gf2_mat_t signature, const gf2_mat_t F,
+                           const gf2_mat_struct *H_A, const uint64_t *syndrome,
+                           bool full_check, FILE *output_file)
+{
+    trace_mark t = trace_begin();
+    unsigned char *salted_message = ws->salted_message;
+    memcpy(salted_message, message, message_len);
+    memcpy(salted_message + message_len, salt, salt_len);
 
     unsigned char hash[crypto_hash_sha256_BYTES];
     crypto_hash_sha256(hash, salted_message, message_len + salt_len);
     size_t hash_size = sizeof(hash);
     
-    nmod_mat_t bin_hash;
-    nmod_mat_init(bin_hash, 1, message_len, MOD);
+    gf2_mat_struct *bin_hash = ws->hash;
+    gf2_mat_zero(bin_hash);
     for (size_t i = 0; i < message_len; ++i) {
-        int val = hash[i % hash_size] % 2;
-        nmod_mat_set_entry(bin_hash, 0, i, val);
+        if (hash[i % hash_size] % 2) gf2_mat_set(bin_hash, 0, i, 1);
     }
+    trace_end_bits("verify.hash", t, 8 * (message_len + salt_len));
 
-    nmod_mat_t hash_T;
-    nmod_mat_init(hash_T, message_len, 1, MOD);
-    nmod_mat_transpose(hash_T, bin_hash);
-
-    if (PRINT) {
+    if (dump_enabled(DUMP_SUMMARY)) {
         fprintf(output_file, "\nHash:\n\n");
-        print_matrix(output_file, bin_hash);
+        gf2_mat_print(output_file, bin_hash);
     }
 
-    nmod_mat_t left;
-    nmod_mat_init(left, F->r, 1, MOD);
-    nmod_mat_mul(left, F, hash_T);
-    fprintf(output_file, "\nLHS:\n\n");
-    print_matrix_transpose(output_file, left);
-
-    nmod_mat_t sig_T;
-    nmod_mat_init(sig_T, sig_len, 1, MOD);
-    nmod_mat_transpose(sig_T, signature);
-
-    nmod_mat_t right;
-    nmod_mat_init(right, C_A.n - C_A.k, 1, MOD);
-    nmod_mat_mul(right, H_A, sig_T);
-    fprintf(output_file, "\nRHS:\n\n");
-    print_matrix_transpose(output_file, right);
-    
-    fprintf(output_file, "\nVerified: %s", (nmod_mat_equal(left, right)) ? "True" : "False");
+    t = trace_begin();
+    slong failures;
+    if (full_check) {
+        gf2_mat_zero(ws->left);
+        gf2_mat_zero(ws->right);
+
+        failures = check_augmented_rows(F, gf2_mat_row(bin_hash, 0), H_A, syndrome,
+                                        gf2_mat_row(signature, 0), true, ws->left, ws->right);
+
+        fprintf(output_file, "\nLHS:\n\n");
+        gf2_mat_print(output_file, ws->left);
+        fprintf(output_file, "\nRHS:\n\n");
+        gf2_mat_print(output_file, ws->right);
+        fprintf(output_file, "\nMismatched rows: %ld of %ld\n", failures, F->r);
+    } else {
+        failures = check_augmented_rows(F, gf2_mat_row(bin_hash, 0), H_A, syndrome,
+                                        gf2_mat_row(signature, 0), false, NULL, NULL);
+    }
+
+    trace_end_bits("verify.check_rows", t,
+                   (uint64_t) F->r * (F->c + (H_A ? H_A->c : 0)));
+
+    fprintf(output_file, "\nVerified: %s", (failures == 0) ? "True" : "False");
+
+    return failures == 0;
+}
+
+// The workspace is sized for one message length and at most SALT_LEN bytes of salt
+static bool fits_workspace(const verify_workspace *ws, size_t message_len, size_t salt_len,
+                           const gf2_mat_t F, FILE *output_file)
+{
+    if (message_len != ws->message_len || salt_len > SALT_LEN || F->r != ws->left->c) {
+        fprintf(output_file, "\nVerified: False (dimension mismatch)");
+        return false;
+    }
+    return true;
+}
+
+bool verify_signature(verify_workspace *ws, const unsigned char *message, size_t message_len,
+                      const unsigned char *salt, size_t salt_len,
+                      const gf2_mat_t signature, const gf2_mat_t F,
+                      const gf2_mat_t H_A, bool full_check, FILE *output_file)
+{
+    if (F->r != H_A->r || F->c != (slong) message_len || signature->c != H_A->c) {
+        fprintf(output_file, "\nVerified: False (dimension mismatch)");
+        return false;
+    }
+    if (!fits_workspace(ws, message_len, salt_len, F, output_file)) return false;
+
+    return verify_against(ws, message, message_len, salt, salt_len, signature, F, H_A, NULL,
+                          full_check, output_file);
+}
+
+// Same check with a quasi-cyclic H_A, whose H_A·sigᵀ costs a few polynomial products
+bool verify_signature_qc(verify_workspace *ws, const unsigned char *message, size_t message_len,
+                         const unsigned char *salt, size_t salt_len,
+                         const gf2_mat_t signature, const gf2_mat_t F,
+                         const qc_mat_t H_A, bool full_check, FILE *output_file)
+{
+    if (F->r != H_A->r || F->c != (slong) message_len || signature->c != H_A->c) {
+        fprintf(output_file, "\nVerified: False (dimension mismatch)");
+        return false;
+    }
+    if (!fits_workspace(ws, message_len, salt_len, F, output_file)) return false;
+
+    trace_mark t = trace_begin();
+    qc_mat_syndrome_arena(ws->syndrome, H_A, gf2_mat_row(signature, 0), ws->scratch);
+    trace_end_bits("verify.syndrome", t, (uint64_t) H_A->r * H_A->c);
 
-    nmod_mat_clear(bin_hash);
-    nmod_mat_clear(hash_T);
-    nmod_mat_clear(left);
-    nmod_mat_clear(sig_T);
-    nmod_mat_clear(right);
+    return verify_against(ws, message, message_len, salt, salt_len, signature, F, NULL, ws->syndrome,
+                          full_check, output_file);
 }
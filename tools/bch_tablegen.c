@@ -0,0 +1,105 @@
+/* Generates src/bch_tables.c: for every m <= BCH_K_TABLE_MAX_M, one entry per t at
+   which the narrow-sense BCH code changes (2t - 1 is a new coset leader), with k,
+   and with g(x) packed into bch_gpoly_words for m <= BCH_G_TABLE_MAX_M.
+   Built against bch.c compiled with -DBCH_NO_TABLES. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <flint/nmod_mat.h>
+#include "bch.h"
+
+typedef struct {
+    bch_table_entry *entries;
+    uint32_t count;
+} table_build;
+
+// One pass over t = 1 .. (n - 1) / 2 for the given m, tracking covered exponents
+static void build_table(int m, table_build *tb, uint64_t **words, uint32_t *nwords, uint32_t *cap)
+{
+    uint32_t n = ((uint32_t)1 << m) - 1u;
+    uint64_t *covered = (uint64_t *) calloc(n / 64 + 1, sizeof(uint64_t));
+    tb->entries = (bch_table_entry *) malloc((n / 2 + 1) * sizeof(bch_table_entry));
+    tb->count = 0;
+    if (!covered || !tb->entries) {
+        fprintf(stderr, "bch_tablegen: out of memory for m=%d\n", m);
+        exit(EXIT_FAILURE);
+    }
+
+    uint32_t r = 0;
+    for (uint32_t t = 1; 2 * t < n; ++t) {
+        uint32_t a = 2 * t - 1;
+        if (covered[a / 64] & (1ull << (a % 64))) continue;
+
+        uint32_t cur = a;
+        do {
+            covered[cur / 64] |= 1ull << (cur % 64);
+            ++r;
+            cur = (uint32_t)(((uint64_t)cur * 2u) % n);
+        } while (cur != a);
+
+        bch_table_entry *e = &tb->entries[tb->count++];
+        e->t_start = t;
+        e->k = n - r;
+        e->goffset = 0;
+
+        if (m > BCH_G_TABLE_MAX_M) continue;
+
+        gf2x_t g;
+        gf2x_init(g);
+        if (bch_genpoly_gf2x(m, (int) t, g) != 0 || gf2x_degree(g) != (slong) r) {
+            fprintf(stderr, "bch_tablegen: g(x) mismatch for m=%d t=%u\n", m, t);
+            exit(EXIT_FAILURE);
+        }
+        if (*nwords + g->length > *cap) {
+            *cap = 2 * (*cap + g->length);
+            *words = (uint64_t *) realloc(*words, *cap * sizeof(uint64_t));
+            if (!*words) {
+                fprintf(stderr, "bch_tablegen: out of memory\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        e->goffset = *nwords;
+        for (slong i = 0; i < g->length; ++i) (*words)[(*nwords)++] = g->coeffs[i];
+        gf2x_clear(g);
+    }
+
+    free(covered);
+}
+
+int main(void)
+{
+    table_build tables[BCH_K_TABLE_MAX_M + 1] = {{0}};
+    uint64_t *words = NULL;
+    uint32_t nwords = 0, cap = 0;
+
+    for (int m = 2; m <= BCH_K_TABLE_MAX_M; ++m) build_table(m, &tables[m], &words, &nwords, &cap);
+
+    printf("/* Generated by tools/bch_tablegen - do not edit */\n");
+    printf("#include <stdint.h>\n#include <stddef.h>\n#include \"bch_tables.h\"\n\n");
+
+    printf("const uint64_t bch_gpoly_words[] = {\n");
+    for (uint32_t i = 0; i < nwords; ++i) {
+        printf("%s0x%016" PRIx64 "ULL,%s", i % 4 ? " " : "    ", words[i], i % 4 == 3 ? "\n" : "");
+    }
+    printf("%s    0\n};\n\n", nwords % 4 ? "\n" : "");
+
+    for (int m = 2; m <= BCH_K_TABLE_MAX_M; ++m) {
+        printf("static const bch_table_entry bch_entries_m%d[] = {\n", m);
+        for (uint32_t i = 0; i < tables[m].count; ++i) {
+            const bch_table_entry *e = &tables[m].entries[i];
+            printf("    {%u, %u, %u},\n", e->t_start, e->k, e->goffset);
+        }
+        printf("};\n\n");
+    }
+
+    printf("const bch_table bch_tables[BCH_K_TABLE_MAX_M + 1] = {\n    {NULL, 0},\n    {NULL, 0},\n");
+    for (int m = 2; m <= BCH_K_TABLE_MAX_M; ++m) {
+        printf("    {bch_entries_m%d, %u},\n", m, tables[m].count);
+        free(tables[m].entries);
+    }
+    printf("};\n");
+
+    free(words);
+    return 0;
+}
@@ -0,0 +1,874 @@
+/* Microbenchmarks for the kernels and phases of the scheme.
+   Every input is derived from a fixed seed, each case is warmed up and then
+   timed rep by rep with both the cycle counter and the monotonic clock, and
+   median/p99 are written as CSV and JSON. Where a packed or structured kernel
+   replaces an nmod_mat path, its output is compared against that reference and
+   the result recorded, so a fast but wrong variant shows up as FAIL. Where
+   perf events are available each rep's dTLB read misses are counted too. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <time.h>
+#include <math.h>
+#include <sys/stat.h>
+#include <flint/flint.h>
+#include <flint/nmod_mat.h>
+#include "constants.h"
+#include "utils.h"
+#include "rng.h"
+#include "gf2mat.h"
+#include "gf2x.h"
+#include "clmul.h"
+#include "bch.h"
+#include "bchenc.h"
+#include "qcmat.h"
+#include "keygen.h"
+#include "signer.h"
+#include "verifier.h"
+#include "hugemem.h"
+#include "perfctr.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+static inline uint64_t cycles(void) { return __rdtsc(); }
+#elif defined(__aarch64__)
+static inline uint64_t cycles(void) { uint64_t v; __asm__ volatile("mrs %0, cntvct_el0" : "=r"(v)); return v; }
+#else
+static inline uint64_t cycles(void) { return 0; }
+#endif
+
+#define BENCH_MAX_RESULTS 64
+
+static const unsigned char bench_seed[RNG_SEED_SIZE] = "signature-scheme-bench-seed-0001";
+
+typedef struct {
+    char name[48];
+    char params[64];
+    int reps;
+    double median_ns, p99_ns, min_ns, mean_ns;
+    uint64_t median_cycles, p99_cycles;
+    uint64_t median_dtlb;       /* PERF_UNAVAILABLE without perf events */
+    const char *check;          /* "ok", "FAIL" or "-" when there is no reference */
+} bench_result;
+
+typedef struct {
+    int m, t, reps, warmup;
+    int tlb_mib;                /* size of the huge page comparison matrix */
+    const char *out_dir;
+    const char *filter;
+    bench_result results[BENCH_MAX_RESULTS];
+    int count;
+    int failures;
+} bench_ctx;
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *) a, y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+    return (x > y) - (x < y);
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Nearest-rank percentile of a sorted array
+static size_t rank(int reps, double p)
+{
+    size_t r = (size_t) ceil(p * reps);
+    return r ? r - 1 : 0;
+}
+
+static bool selected(const bench_ctx *ctx, const char *name)
+{
+    return !ctx->filter || strstr(name, ctx->filter);
+}
+
+/* Times fn(arg) after ctx->warmup untimed calls. reps_scale lowers the count
+   for whole-phase cases that take milliseconds each. */
+static void bench_run(bench_ctx *ctx, const char *name, const char *params, int reps_scale,
+                      void (*fn)(void *), void *arg, const char *check)
+{
+    if (!selected(ctx, name) || ctx->count == BENCH_MAX_RESULTS) return;
+
+    int reps = ctx->reps / reps_scale;
+    if (reps < 5) reps = 5;
+    double *ns = malloc(reps * sizeof(double));
+    uint64_t *cyc = malloc(reps * sizeof(uint64_t));
+    uint64_t *dtlb = malloc(reps * sizeof(uint64_t));
+    if (!ns || !cyc || !dtlb) {
+        fprintf(stderr, "Memory allocation failed for benchmark samples\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 0; i < ctx->warmup; ++i) fn(arg);
+
+    double total = 0;
+    bool counted = perf_available();
+    for (int i = 0; i < reps; ++i) {
+        uint64_t before[PERF_NUM_COUNTERS], after[PERF_NUM_COUNTERS];
+        if (counted) perf_read(before);
+        double t0 = now_ns();
+        uint64_t c0 = cycles();
+        fn(arg);
+        cyc[i] = cycles() - c0;
+        ns[i] = now_ns() - t0;
+        if (counted) perf_read(after);
+        total += ns[i];
+
+        counted = counted && before[PERF_DTLB_MISSES] != PERF_UNAVAILABLE && after[PERF_DTLB_MISSES] != PERF_UNAVAILABLE;
+        if (counted) dtlb[i] = after[PERF_DTLB_MISSES] - before[PERF_DTLB_MISSES];
+    }
+    qsort(ns, reps, sizeof(double), cmp_double);
+    qsort(cyc, reps, sizeof(uint64_t), cmp_u64);
+    if (counted) qsort(dtlb, reps, sizeof(uint64_t), cmp_u64);
+
+    bench_result *r = &ctx->results[ctx->count++];
+    snprintf(r->name, sizeof(r->name), "%s", name);
+    snprintf(r->params, sizeof(r->params), "%s", params);
+    r->reps = reps;
+    r->median_ns = ns[rank(reps, 0.5)];
+    r->p99_ns = ns[rank(reps, 0.99)];
+    r->min_ns = ns[0];
+    r->mean_ns = total / reps;
+    r->median_cycles = cyc[rank(reps, 0.5)];
+    r->p99_cycles = cyc[rank(reps, 0.99)];
+    r->median_dtlb = counted ? dtlb[rank(reps, 0.5)] : PERF_UNAVAILABLE;
+    r->check = check;
+    if (strcmp(check, "FAIL") == 0) ++ctx->failures;
+
+    char dtlb_text[24] = "-";
+    if (counted) snprintf(dtlb_text, sizeof(dtlb_text), "%llu", (unsigned long long) r->median_dtlb);
+    printf("%-24s %-28s %12.0f %12.0f %14llu %12s  %s\n", r->name, r->params, r->median_ns, r->p99_ns,
+           (unsigned long long) r->median_cycles, dtlb_text, r->check);
+
+    free(ns);
+    free(cyc);
+    free(dtlb);
+}
+
+/* ---- inputs shared by the cases ---- */
+
+typedef struct {
+    struct code C_A, C1, C2;
+    unsigned char h_seed[SEED_SIZE], g1_seed[SEED_SIZE], g2_seed[SEED_SIZE];
+    nmod_mat_t G;               /* BCH generator, for the keygen and matrix file cases */
+    nmod_mat_t G1, G2;          /* seed-expanded as sign loads them, G2 shorter than G1 */
+    gf2_mat_t H;                /* dense H_A */
+    qc_mat_t H_qc;
+    unsigned char *message;
+    FILE *devnull;
+} bench_inputs;
+
+static void inputs_init(bench_inputs *in, int m, int t)
+{
+    uint32_t k, r;
+    bch_compute_k_from_mt(m, t, &k, &r);
+
+    // Same derivation as get_user_input for BCH parameters
+    unsigned long n = (1UL << m) - 1, d = 2 * t + 1;
+    in->C1 = (struct code) {n, k, d, false};
+    in->C_A.n = 2 * n;
+    in->C_A.d = 2 * (2 * d) + 1;
+    in->C_A.k = in->C_A.n * (1 - binary_entropy((double) in->C_A.d / in->C_A.n));
+    in->C_A.quasi_cyclic = false;
+
+    // G2 from the next smaller code, so n_A - n1 > n2 and k2 < k1: the signer folds the
+    // positions past n2 onto G2's last column and encodes only k2 hash bits with it
+    uint32_t k2, r2;
+    if (m > 3 && bch_compute_k_from_mt(m - 1, t, &k2, &r2) == 0 && k2 > 0) {
+        in->C2 = (struct code) {(1UL << (m - 1)) - 1, k2, d, false};
+    } else {
+        in->C2 = in->C1;
+    }
+
+    memcpy(in->h_seed, bench_seed, SEED_SIZE);
+    rng_bytes(in->g1_seed, SEED_SIZE);
+    rng_bytes(in->g2_seed, SEED_SIZE);
+    in->devnull = fopen("/dev/null", "w");
+
+    nmod_mat_init(in->G, 1, 1, MOD);
+    create_generator_matrix(n, k, d, in->G, in->devnull);
+    nmod_mat_init(in->G1, in->C1.k, in->C1.n, MOD);
+    create_generator_matrix_from_seed(in->C1.n, in->C1.k, in->C1.d, in->G1, in->g1_seed, in->devnull);
+    nmod_mat_init(in->G2, in->C2.k, in->C2.n, MOD);
+    create_generator_matrix_from_seed(in->C2.n, in->C2.k, in->C2.d, in->G2, in->g2_seed, in->devnull);
+
+    gf2_mat_init(in->H, in->C_A.n - in->C_A.k, in->C_A.n);
+    generate_parity_check_matrix_packed_from_seed(in->C_A.n, in->C_A.k, in->H, in->h_seed);
+    qc_mat_init(in->H_qc, in->C_A.n - in->C_A.k, in->C_A.n);
+    generate_parity_check_qc_from_seed(in->C_A.n, in->C_A.k, in->H_qc, in->h_seed);
+
+    in->message = malloc(k);
+    for (uint32_t i = 0; i < k; ++i) in->message[i] = 'a' + rng_uniform(26);
+}
+
+static void inputs_clear(bench_inputs *in)
+{
+    nmod_mat_clear(in->G);
+    nmod_mat_clear(in->G1);
+    nmod_mat_clear(in->G2);
+    gf2_mat_clear(in->H);
+    qc_mat_clear(in->H_qc);
+    free(in->message);
+    fclose(in->devnull);
+}
+
+/* ---- Hamming weight ---- */
+
+typedef struct { nmod_mat_t v; gf2_mat_t packed; long result; } weight_case;
+
+static void run_weight_nmod(void *arg) { weight_case *c = arg; c->result = weight(c->v); }
+
+static void run_weight_packed(void *arg)
+{
+    weight_case *c = arg;
+    long w = 0;
+    for (slong i = 0; i < c->packed->words; ++i) w += __builtin_popcountll(c->packed->bits[i]);
+    c->result = w;
+}
+
+static void bench_weight(bench_ctx *ctx, const bench_inputs *in, const char *params)
+{
+    weight_case c;
+    nmod_mat_init(c.v, 1, in->C_A.n, MOD);
+    gf2_mat_init(c.packed, 1, in->C_A.n);
+    for (slong j = 0; j < (slong) in->C_A.n; ++j) nmod_mat_set_entry(c.v, 0, j, rng_uniform(2));
+    gf2_mat_set_nmod(c.packed, c.v);
+
+    run_weight_nmod(&c);
+    long expected = c.result;
+    run_weight_packed(&c);
+    const char *check = c.result == expected ? "ok" : "FAIL";
+
+    bench_run(ctx, "weight_nmod", params, 1, run_weight_nmod, &c, "-");
+    bench_run(ctx, "weight_packed", params, 1, run_weight_packed, &c, check);
+
+    nmod_mat_clear(c.v);
+    gf2_mat_clear(c.packed);
+}
+
+/* ---- random position set ---- */
+
+typedef struct { unsigned long n, size, *set; } random_set_case;
+
+static void run_random_set(void *arg)
+{
+    random_set_case *c = arg;
+    generate_random_set(c->n, c->size, c->set);
+}
+
+static void bench_random_set(bench_ctx *ctx, const bench_inputs *in, const char *params)
+{
+    random_set_case c = {in->C_A.n, in->C1.n, malloc(in->C1.n * sizeof(unsigned long))};
+    bench_run(ctx, "generate_random_set", params, 1, run_random_set, &c, "-");
+    free(c.set);
+}
+
+/* ---- seed expansion of H_A ---- */
+
+typedef struct { const bench_inputs *in; nmod_mat_t H; gf2_mat_t packed; } expand_case;
+
+static void run_expand_nmod(void *arg)
+{
+    expand_case *c = arg;
+    generate_parity_check_matrix_from_seed(c->in->C_A.n, c->in->C_A.k, c->in->C_A.d, c->H,
+                                           c->in->h_seed, c->in->devnull);
+}
+
+static void run_expand_packed(void *arg)
+{
+    expand_case *c = arg;
+    generate_parity_check_matrix_packed_from_seed(c->in->C_A.n, c->in->C_A.k, c->packed, c->in->h_seed);
+}
+
+static void run_expand_qc(void *arg)
+{
+    expand_case *c = arg;
+    qc_mat_t H;
+    qc_mat_init(H, c->in->C_A.n - c->in->C_A.k, c->in->C_A.n);
+    generate_parity_check_qc_from_seed(c->in->C_A.n, c->in->C_A.k, H, c->in->h_seed);
+    qc_mat_clear(H);
+}
+
+static void bench_seed_expansion(bench_ctx *ctx, const bench_inputs *in, const char *params)
+{
+    expand_case c = {in};
+    nmod_mat_init(c.H, in->C_A.n - in->C_A.k, in->C_A.n, MOD);
+    gf2_mat_init(c.packed, in->C_A.n - in->C_A.k, in->C_A.n);
+
+    run_expand_nmod(&c);
+    run_expand_packed(&c);
+    gf2_mat_t reference;
+    gf2_mat_init(reference, c.packed->r, c.packed->c);
+    gf2_mat_set_nmod(reference, c.H);
+    const char *check = gf2_mat_equal(reference, c.packed) ? "ok" : "FAIL";
+    gf2_mat_clear(reference);
+
+    bench_run(ctx, "seed_expand_nmod", params, 10, run_expand_nmod, &c, "-");
+    bench_run(ctx, "seed_expand_packed", params, 10, run_expand_packed, &c, check);
+    bench_run(ctx, "seed_expand_qc", params, 10, run_expand_qc, &c, "-");
+
+    nmod_mat_clear(c.H);
+    gf2_mat_clear(c.packed);
+}
+
+/* ---- BCH construction ---- */
+
+typedef struct { int m, t; uint32_t n; gf2x_t g; gf2_mat_t G; } bch_case;
+
+static void run_genpoly_bytes(void *arg)
+{
+    bch_case *c = arg;
+    uint8_t *bytes;
+    uint32_t deg;
+    if (bch_genpoly(c->m, c->t, &bytes, &deg) == 0) free(bytes);
+}
+
+static void run_genpoly_gf2x(void *arg)
+{
+    bch_case *c = arg;
+    bch_genpoly_gf2x(c->m, c->t, c->g);
+}
+
+static void run_generator_matrix(void *arg)
+{
+    bch_case *c = arg;
+    bch_generator_matrix(c->G, c->g, c->n);
+}
+
+static void bench_bch(bench_ctx *ctx, const bench_inputs *in, const char *params)
+{
+    bch_case c = {ctx->m, ctx->t, in->C1.n};
+    gf2x_init(c.g);
+    gf2_mat_init(c.G, in->C1.k, in->C1.n);
+
+    // The byte form is a wrapper over the gf2x one; both must describe the same g(x)
+    uint8_t *bytes;
+    uint32_t deg;
+    const char *check = "FAIL";
+    if (bch_genpoly(c.m, c.t, &bytes, &deg) == 0) {
+        run_genpoly_gf2x(&c);
+        bool same = (slong) deg == gf2x_degree(c.g);
+        for (uint32_t i = 0; same && i <= deg; ++i) same = bytes[i] == gf2x_get_coeff(c.g, i);
+        check = same ? "ok" : "FAIL";
+        free(bytes);
+    }
+
+    // Row i of G must be g(x) shifted by i, reading columns from the right
+    run_generator_matrix(&c);
+    const char *matrix_check = "ok";
+    for (slong i = 0; i < c.G->r; ++i) {
+        for (slong j = 0; j < c.G->c; ++j) {
+            slong e = (slong) c.n - 1 - j - i;
+            int expected = e >= 0 && e <= gf2x_degree(c.g) ? gf2x_get_coeff(c.g, e) : 0;
+            if (gf2_mat_get(c.G, i, j) != expected) matrix_check = "FAIL";
+        }
+    }
+
+    bench_run(ctx, "bch_genpoly_bytes", params, 10, run_genpoly_bytes, &c, "-");
+    bench_run(ctx, "bch_genpoly_gf2x", params, 10, run_genpoly_gf2x, &c, check);
+    bench_run(ctx, "bch_generator_matrix", params, 10, run_generator_matrix, &c, matrix_check);
+
+    gf2x_clear(c.g);
+    gf2_mat_clear(c.G);
+}
+
+/* ---- systematic encoder against the generator matrix ---- */
+
+typedef struct { bch_encoder_t enc; uint64_t *msg, *cw; } encode_case;
+
+static void run_bch_encode(void *arg)
+{
+    encode_case *c = arg;
+    bch_encode(c->enc, c->msg, c->cw);
+}
+
+static void bench_bch_encode(bench_ctx *ctx, const char *params)
+{
+    encode_case c;
+    if (bch_encoder_init(c.enc, ctx->m, ctx->t) != 0) return;
+    c.msg = calloc(GF2_WORDS(c.enc->k), sizeof(uint64_t));
+    c.cw = calloc(GF2_WORDS(c.enc->n), sizeof(uint64_t));
+    rng_bits(c.msg, c.enc->k);
+
+    run_bch_encode(&c);
+    const char *check = bch_is_codeword(c.enc, c.cw) ? "ok" : "FAIL";
+    bench_run(ctx, "bch_encode", params, 1, run_bch_encode, &c, check);
+
+    free(c.msg);
+    free(c.cw);
+    bch_encoder_clear(c.enc);
+}
+
+/* ---- carry-less products ---- */
+
+typedef struct { slong words; uint64_t *a, *b, *r, *ref; } mul_case;
+
+static void run_gf2x_mul(void *arg)
+{
+    mul_case *c = arg;
+    gf2x_mul_words(c->r, c->a, c->words, c->b, c->words);
+}
+
+static void run_mul_schoolbook(void *arg)
+{
+    mul_case *c = arg;
+    memset(c->ref, 0, 2 * c->words * sizeof(uint64_t));
+    for (slong i = 0; i < c->words; ++i) {
+        for (slong j = 0; j < c->words; ++j) {
+            uint64_t hi, lo = clmul64(c->a[i], c->b[j], &hi);
+            c->ref[i + j] ^= lo;
+            c->ref[i + j + 1] ^= hi;
+        }
+    }
+}
+
+static void bench_gf2x_mul(bench_ctx *ctx, const bench_inputs *in)
+{
+    mul_case c;
+    c.words = GF2_WORDS(in->C_A.n);
+    c.a = malloc(c.words * sizeof(uint64_t));
+    c.b = malloc(c.words * sizeof(uint64_t));
+    c.r = malloc(2 * c.words * sizeof(uint64_t));
+    c.ref = malloc(2 * c.words * sizeof(uint64_t));
+    rng_bits(c.a, 64 * c.words);
+    rng_bits(c.b, 64 * c.words);
+
+    run_gf2x_mul(&c);
+    run_mul_schoolbook(&c);
+    const char *check = memcmp(c.r, c.ref, 2 * c.words * sizeof(uint64_t)) == 0 ? "ok" : "FAIL";
+
+    char params[64];
+    snprintf(params, sizeof(params), "words=%ld clmul_hw=%d", c.words, clmul_has_hw());
+    bench_run(ctx, "gf2x_mul_schoolbook", params, 1, run_mul_schoolbook, &c, "-");
+    bench_run(ctx, "gf2x_mul", params, 1, run_gf2x_mul, &c, check);
+
+    free(c.a); free(c.b); free(c.r); free(c.ref);
+}
+
+/* ---- matrix files ---- */
+
+typedef struct { char path[MAX_FILENAME_LENGTH]; const nmod_mat_struct *M; nmod_mat_t loaded; } file_case;
+
+static void run_save_matrix(void *arg)
+{
+    file_case *c = arg;
+    save_matrix(c->path, c->M);
+}
+
+static void run_load_matrix(void *arg)
+{
+    file_case *c = arg;
+    load_matrix(c->path, c->loaded);
+}
+
+static void bench_matrix_files(bench_ctx *ctx, const bench_inputs *in, const char *params)
+{
+    file_case c;
+    snprintf(c.path, sizeof(c.path), "%s/bench_matrix.tmp", ctx->out_dir);
+    c.M = in->G;
+    nmod_mat_init(c.loaded, in->G->r, in->G->c, MOD);
+
+    run_save_matrix(&c);
+    run_load_matrix(&c);
+    const char *check = nmod_mat_equal(c.loaded, in->G) ? "ok" : "FAIL";
+
+    bench_run(ctx, "save_matrix", params, 10, run_save_matrix, &c, "-");
+    bench_run(ctx, "load_matrix", params, 10, run_load_matrix, &c, check);
+
+    remove(c.path);
+    nmod_mat_clear(c.loaded);
+}
+
+/* ---- signing: structured path against the nmod_mat_mul reference ---- */
+
+typedef struct {
+    const bench_inputs *in;
+    sign_workspace ws;
+    unsigned char salt[SALT_LEN];
+    nmod_mat_t H, G_star, G_star_T, F, hash, signature;
+} sign_case;
+
+// G* from J exactly as the original signer built it, entry by entry
+static void build_reference_G_star(sign_case *c)
+{
+    const bench_inputs *in = c->in;
+    size_t G1_index = 0, G2_index = 0;
+    nmod_mat_zero(c->G_star);
+    for (size_t i = 0; i < in->C_A.n; ++i) {
+        if (G1_index < in->C1.n && c->ws.J[G1_index] == i) {
+            for (size_t row = 0; row < in->C1.k; ++row)
+                nmod_mat_set_entry(c->G_star, row, i, nmod_mat_get_entry(in->G1, row, G1_index));
+            ++G1_index;
+        } else {
+            for (size_t row = 0; row < in->C2.k; ++row)
+                nmod_mat_set_entry(c->G_star, row, i, nmod_mat_get_entry(in->G2, row, G2_index));
+            if (G2_index < in->C2.n - 1) ++G2_index;
+        }
+    }
+}
+
+static void run_F_nmod(void *arg)
+{
+    sign_case *c = arg;
+    nmod_mat_transpose(c->G_star_T, c->G_star);
+    nmod_mat_mul(c->F, c->H, c->G_star_T);
+}
+
+static void run_signature_nmod(void *arg)
+{
+    sign_case *c = arg;
+    nmod_mat_mul(c->signature, c->hash, c->G_star);
+}
+
+static void run_sign(void *arg)
+{
+    sign_case *c = arg;
+    generate_signature(&c->ws, c->in->message, c->in->C1.k, c->in->H, NULL, c->salt, c->in->devnull);
+}
+
+static void run_sign_qc(void *arg)
+{
+    sign_case *c = arg;
+    generate_signature(&c->ws, c->in->message, c->in->C1.k, NULL, c->in->H_qc, c->salt, c->in->devnull);
+}
+
+static bool packed_equals_nmod(const gf2_mat_t P, const nmod_mat_t A)
+{
+    gf2_mat_t Q;
+    gf2_mat_init(Q, A->r, A->c);
+    gf2_mat_set_nmod(Q, A);
+    bool same = gf2_mat_equal(P, Q);
+    gf2_mat_clear(Q);
+    return same;
+}
+
+static void bench_sign(bench_ctx *ctx, const bench_inputs *in, const char *params)
+{
+    sign_case c = {in};
+    slong rows = in->C_A.n - in->C_A.k;
+    sign_workspace_init(&c.ws, &in->C_A, &in->C1, &in->C2);
+    sign_workspace_set_generators(&c.ws, in->G1, in->G2);
+    nmod_mat_init(c.H, rows, in->C_A.n, MOD);
+    nmod_mat_init(c.G_star, in->C1.k, in->C_A.n, MOD);
+    nmod_mat_init(c.G_star_T, in->C_A.n, in->C1.k, MOD);
+    nmod_mat_init(c.F, rows, in->C1.k, MOD);
+    nmod_mat_init(c.hash, 1, in->C1.k, MOD);
+    nmod_mat_init(c.signature, 1, in->C_A.n, MOD);
+    gf2_mat_get_nmod(c.H, in->H);
+
+    // One signature, then recompute F and hash G* the reference way from the same J and hash
+    run_sign(&c);
+    build_reference_G_star(&c);
+    gf2_mat_get_nmod(c.hash, c.ws.hash);
+    run_F_nmod(&c);
+    run_signature_nmod(&c);
+    bool same = packed_equals_nmod(c.ws.F, c.F) && packed_equals_nmod(c.ws.signature, c.signature);
+
+    // --low-memory and keystore keys expand the same generators straight from the seeds
+    sign_workspace packed;
+    sign_workspace_init(&packed, &in->C_A, &in->C1, &in->C2);
+    sign_workspace_expand_generators(&packed, in->g1_seed, in->g2_seed);
+    same = same && gf2_mat_equal(packed.gen[0], c.ws.gen[0]) && gf2_mat_equal(packed.gen[1], c.ws.gen[1]);
+    sign_workspace_clear(&packed);
+    const char *check = same ? "ok" : "FAIL";
+
+    run_sign_qc(&c);
+    build_reference_G_star(&c);
+    gf2_mat_t reference_F, packed_G_star;
+    gf2_mat_init(reference_F, rows, in->C1.k);
+    gf2_mat_init(packed_G_star, in->C1.k, in->C_A.n);
+    gf2_mat_set_nmod(packed_G_star, c.G_star);
+    for (slong j = 0; j < packed_G_star->r; ++j) {
+        uint64_t *column = calloc(GF2_WORDS(rows), sizeof(uint64_t));
+        qc_mat_syndrome(column, in->H_qc, gf2_mat_row(packed_G_star, j));
+        for (slong i = 0; i < rows; ++i) gf2_mat_set(reference_F, i, j, (column[i / 64] >> (i % 64)) & 1);
+        free(column);
+    }
+    const char *qc_check = gf2_mat_equal(reference_F, c.ws.F) ? "ok" : "FAIL";
+    gf2_mat_clear(reference_F);
+    gf2_mat_clear(packed_G_star);
+
+    bench_run(ctx, "F_nmod_mat_mul", params, 10, run_F_nmod, &c, "-");
+    bench_run(ctx, "signature_nmod_mat_mul", params, 1, run_signature_nmod, &c, "-");
+    bench_run(ctx, "sign", params, 10, run_sign, &c, check);
+    bench_run(ctx, "sign_qc", params, 10, run_sign_qc, &c, qc_check);
+
+    sign_workspace_clear(&c.ws);
+    nmod_mat_clear(c.H); nmod_mat_clear(c.G_star); nmod_mat_clear(c.G_star_T);
+    nmod_mat_clear(c.F); nmod_mat_clear(c.hash); nmod_mat_clear(c.signature);
+}
+
+/* ---- verification ---- */
+
+typedef struct {
+    const bench_inputs *in;
+    verify_workspace ws;
+    gf2_mat_t F, F_qc, signature, signature_qc;
+    unsigned char salt[SALT_LEN], salt_qc[SALT_LEN];
+    bool valid;
+} verify_case;
+
+static void run_verify(void *arg)
+{
+    verify_case *c = arg;
+    c->valid = verify_signature(&c->ws, c->in->message, c->in->C1.k, c->salt, SALT_LEN,
+                                c->signature, c->F, c->in->H, false, c->in->devnull);
+}
+
+static void run_verify_qc(void *arg)
+{
+    verify_case *c = arg;
+    c->valid = verify_signature_qc(&c->ws, c->in->message, c->in->C1.k, c->salt_qc, SALT_LEN,
+                                   c->signature_qc, c->F_qc, c->in->H_qc, false, c->in->devnull);
+}
+
+static void bench_verify(bench_ctx *ctx, const bench_inputs *in, const char *params)
+{
+    verify_case c = {in};
+    slong rows = in->C_A.n - in->C_A.k;
+    gf2_mat_init(c.F, rows, in->C1.k);
+    gf2_mat_init(c.F_qc, rows, in->C1.k);
+    gf2_mat_init(c.signature, 1, in->C_A.n);
+    gf2_mat_init(c.signature_qc, 1, in->C_A.n);
+
+    sign_workspace ws;
+    sign_workspace_init(&ws, &in->C_A, &in->C1, &in->C2);
+    sign_workspace_set_generators(&ws, in->G1, in->G2);
+    generate_signature(&ws, in->message, in->C1.k, in->H, NULL, c.salt, in->devnull);
+    memcpy(c.F->bits, ws.F->bits, rows * ws.F->words * sizeof(uint64_t));
+    memcpy(c.signature->bits, ws.signature->bits, ws.signature->words * sizeof(uint64_t));
+    generate_signature(&ws, in->message, in->C1.k, NULL, in->H_qc, c.salt_qc, in->devnull);
+    memcpy(c.F_qc->bits, ws.F->bits, rows * ws.F->words * sizeof(uint64_t));
+    memcpy(c.signature_qc->bits, ws.signature->bits, ws.signature->words * sizeof(uint64_t));
+    sign_workspace_clear(&ws);
+
+    verify_workspace_init(&c.ws, &in->C_A, &in->C1);
+    run_verify(&c);
+    const char *check = c.valid ? "ok" : "FAIL";
+    run_verify_qc(&c);
+    const char *qc_check = c.valid ? "ok" : "FAIL";
+
+    bench_run(ctx, "verify", params, 1, run_verify, &c, check);
+    bench_run(ctx, "verify_qc", params, 1, run_verify_qc, &c, qc_check);
+
+    verify_workspace_clear(&c.ws);
+    gf2_mat_clear(c.F); gf2_mat_clear(c.F_qc);
+    gf2_mat_clear(c.signature); gf2_mat_clear(c.signature_qc);
+}
+
+/* ---- key generation, in memory (the cache files are covered by save/load_matrix) ---- */
+
+typedef struct { const bench_inputs *in; nmod_mat_t G; gf2_mat_t H; } keygen_case;
+
+static void run_keygen(void *arg)
+{
+    keygen_case *c = arg;
+    const bench_inputs *in = c->in;
+    create_generator_matrix(in->C1.n, in->C1.k, in->C1.d, c->G, in->devnull);
+    generate_parity_check_matrix_packed_from_seed(in->C_A.n, in->C_A.k, c->H, in->h_seed);
+}
+
+static void bench_keygen(bench_ctx *ctx, const bench_inputs *in, const char *params)
+{
+    keygen_case c = {in};
+    nmod_mat_init(c.G, 1, 1, MOD);
+    gf2_mat_init(c.H, in->C_A.n - in->C_A.k, in->C_A.n);
+    run_keygen(&c);
+    const char *check = nmod_mat_equal(c.G, in->G) && gf2_mat_equal(c.H, in->H) ? "ok" : "FAIL";
+    bench_run(ctx, "keygen", params, 10, run_keygen, &c, check);
+    nmod_mat_clear(c.G);
+    gf2_mat_clear(c.H);
+}
+
+/* ---- huge pages: the same row gather on 4 KiB and on huge pages ---- */
+
+#define TLB_ROW_BITS (4096 * 8)     // one row per 4 KiB page
+
+typedef struct { gf2_mat_t M; slong *order; uint64_t acc; } tlb_case;
+
+// One word from every row in a random order: each access is on a new 4 KiB page
+static void run_tlb_gather(void *arg)
+{
+    tlb_case *c = arg;
+    uint64_t acc = 0;
+    for (slong i = 0; i < c->M->r; ++i) acc ^= gf2_mat_row(c->M, c->order[i])[i % c->M->words];
+    c->acc = acc;
+}
+
+// Name of the backing the last hugemem_alloc got
+static const char *last_backing(const hugemem_stats *before)
+{
+    static const char *names[HUGEMEM_BACKINGS] = {"heap", "4k", "thp", "hugetlb"};
+    hugemem_stats after;
+    hugemem_get_stats(&after);
+    for (int i = HUGEMEM_BACKINGS - 1; i >= 0; --i) {
+        if (after.allocs[i] > before->allocs[i]) return names[i];
+    }
+    return "?";
+}
+
+static void bench_hugepages(bench_ctx *ctx)
+{
+    if (!selected(ctx, "tlb_gather")) return;
+
+    slong rows = (slong) ctx->tlb_mib * 256;
+    slong *order = malloc(rows * sizeof(slong));
+    for (slong i = 0; i < rows; ++i) order[i] = i;
+    for (slong i = rows - 1; i > 0; --i) {
+        slong j = rng_uniform64(i + 1), tmp = order[i];
+        order[i] = order[j];
+        order[j] = tmp;
+    }
+
+    static const struct { const char *name; hugemem_mode mode; } runs[] = {
+        {"tlb_gather_4k", HUGEMEM_OFF}, {"tlb_gather_huge", HUGEMEM_AUTO}
+    };
+    uint64_t expected = 0;
+    for (int k = 0; k < 2; ++k) {
+        tlb_case c = {.order = order};
+        hugemem_stats before;
+        hugemem_get_stats(&before);
+        hugemem_set_mode(runs[k].mode);
+        gf2_mat_init(c.M, rows, TLB_ROW_BITS);
+        char params[64];
+        snprintf(params, sizeof(params), "%d MiB, %s pages", ctx->tlb_mib, last_backing(&before));
+
+        // Same contents on both backings, and every page faulted in before timing
+        for (slong w = 0; w < rows * c.M->words; ++w) c.M->bits[w] = (uint64_t) w * 0x9e3779b97f4a7c15ull;
+        run_tlb_gather(&c);
+        if (k == 0) expected = c.acc;
+        bench_run(ctx, runs[k].name, params, 10, run_tlb_gather, &c, k == 0 ? "-" : c.acc == expected ? "ok" : "FAIL");
+        gf2_mat_clear(c.M);
+    }
+    hugemem_set_mode(HUGEMEM_AUTO);
+    free(order);
+}
+
+/* ---- output ---- */
+
+static bool write_results(const bench_ctx *ctx)
+{
+    char path[MAX_FILENAME_LENGTH];
+
+    snprintf(path, sizeof(path), "%s/bench.csv", ctx->out_dir);
+    FILE *csv = fopen(path, "w");
+    if (!csv) {
+        fprintf(stderr, "Could not open %s for writing\n", path);
+        return false;
+    }
+    fprintf(csv, "name,params,reps,median_ns,p99_ns,min_ns,mean_ns,median_cycles,p99_cycles,median_dtlb_misses,check\n");
+    for (int i = 0; i < ctx->count; ++i) {
+        const bench_result *r = &ctx->results[i];
+        fprintf(csv, "%s,\"%s\",%d,%.0f,%.0f,%.0f,%.1f,%llu,%llu,", r->name, r->params, r->reps,
+                r->median_ns, r->p99_ns, r->min_ns, r->mean_ns,
+                (unsigned long long) r->median_cycles, (unsigned long long) r->p99_cycles);
+        if (r->median_dtlb != PERF_UNAVAILABLE) fprintf(csv, "%llu", (unsigned long long) r->median_dtlb);
+        fprintf(csv, ",%s\n", r->check);
+    }
+    fclose(csv);
+
+    snprintf(path, sizeof(path), "%s/bench.json", ctx->out_dir);
+    FILE *json = fopen(path, "w");
+    if (!json) {
+        fprintf(stderr, "Could not open %s for writing\n", path);
+        return false;
+    }
+    fprintf(json, "{\n  \"m\": %d,\n  \"t\": %d,\n  \"warmup\": %d,\n  \"results\": [\n", ctx->m, ctx->t, ctx->warmup);
+    for (int i = 0; i < ctx->count; ++i) {
+        const bench_result *r = &ctx->results[i];
+        fprintf(json, "    {\"name\": \"%s\", \"params\": \"%s\", \"reps\": %d, \"median_ns\": %.0f, "
+                      "\"p99_ns\": %.0f, \"min_ns\": %.0f, \"mean_ns\": %.1f, \"median_cycles\": %llu, "
+                      "\"p99_cycles\": %llu, ",
+                r->name, r->params, r->reps, r->median_ns, r->p99_ns, r->min_ns, r->mean_ns,
+                (unsigned long long) r->median_cycles, (unsigned long long) r->p99_cycles);
+        if (r->median_dtlb != PERF_UNAVAILABLE) {
+            fprintf(json, "\"median_dtlb_misses\": %llu, ", (unsigned long long) r->median_dtlb);
+        }
+        fprintf(json, "\"check\": \"%s\"}%s\n", r->check, i + 1 < ctx->count ? "," : "");
+    }
+    fprintf(json, "  ]\n}\n");
+    fclose(json);
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    bench_ctx ctx = {.m = 7, .t = 5, .reps = 200, .warmup = 3, .tlb_mib = 64, .out_dir = "timing"};
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+            ctx.m = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            ctx.t = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            ctx.reps = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+            ctx.warmup = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-M") == 0 && i + 1 < argc) {
+            ctx.tlb_mib = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            ctx.out_dir = argv[++i];
+        } else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            ctx.filter = argv[++i];
+        } else {
+            fprintf(stderr, "Usage: %s [-m m] [-t t] [-r reps] [-w warmup] [-M MiB] [-o dir] [-f name-filter]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (ctx.m < 3 || ctx.m > 16 || ctx.t < 1 || ctx.reps < 1 || ctx.warmup < 0 || ctx.tlb_mib < 1) {
+        fprintf(stderr, "Invalid benchmark parameters\n");
+        return 1;
+    }
+    // The matrix file case and the results both go to out_dir
+    if (mkdir(ctx.out_dir, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Could not create %s: %s\n", ctx.out_dir, strerror(errno));
+        return 1;
+    }
+    if (sodium_init() < 0) {
+        fprintf(stderr, "Failed to initialize libsodium\n");
+        return 1;
+    }
+    rng_set_seed(bench_seed);
+    perf_open();
+
+    bench_inputs in;
+    inputs_init(&in, ctx.m, ctx.t);
+
+    char params[64];
+    snprintf(params, sizeof(params), "m=%d t=%d n_A=%lu k_A=%lu", ctx.m, ctx.t, in.C_A.n, in.C_A.k);
+    printf("%-24s %-28s %12s %12s %14s %12s  %s\n", "name", "params", "median_ns", "p99_ns", "median_cycles",
+           "dtlb_misses", "check");
+
+    bench_weight(&ctx, &in, params);
+    bench_random_set(&ctx, &in, params);
+    bench_seed_expansion(&ctx, &in, params);
+    bench_bch(&ctx, &in, params);
+    bench_bch_encode(&ctx, params);
+    bench_gf2x_mul(&ctx, &in);
+    bench_matrix_files(&ctx, &in, params);
+    // Sign and verify use G1 and G2 of different sizes
+    char sign_params[96];
+    snprintf(sign_params, sizeof(sign_params), "%s n2=%lu", params, in.C2.n);
+    bench_sign(&ctx, &in, sign_params);
+    bench_verify(&ctx, &in, sign_params);
+    bench_keygen(&ctx, &in, params);
+    bench_hugepages(&ctx);
+
+    inputs_clear(&in);
+
+    if (!write_results(&ctx)) return 1;
+    if (ctx.failures) fprintf(stderr, "%d equivalence check(s) failed\n", ctx.failures);
+    return ctx.failures ? 1 : 0;
+}